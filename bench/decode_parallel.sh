@@ -0,0 +1,57 @@
+#!/bin/sh
+# @file decode_parallel.sh
+# @brief Benchmark: parallel decoder (-j N) against the single-threaded path
+#
+# Usage: bench/decode_parallel.sh [MORSE_BINARY] [SIZE_BYTES] [THREADS...]
+#
+# Builds a Morse dump of about SIZE_BYTES (default 1 GB) by encoding
+# generated prose, then decodes it serially and with each thread count
+# (default: 2 4 8 and one per core). Prints MB/s and the speedup over -j 1
+# and appends the table to bench_output.txt.
+
+MORSE=${1:-./build/morse}
+SIZE=${2:-1073741824}
+shift 2 2>/dev/null
+THREADS=${*:-"2 4 8 0"}
+WORK_DIR=${TMPDIR:-/tmp}/morse_bench.$$
+OUTPUT=bench_output.txt
+
+if [ ! -x "$MORSE" ]; then
+  echo "Error: morse binary '$MORSE' not found" >&2
+  exit 1
+fi
+
+mkdir -p "$WORK_DIR" || exit 1
+trap 'rm -rf "$WORK_DIR"' EXIT INT TERM
+
+now_ns() { date +%s%N; }
+
+# Encoded prose is about 4x its input, and -o writes it without banner.
+# Input always comes through stdin, which morse prefers whenever it is not
+# a terminal.
+yes "The quick brown fox jumps over the lazy dog 0123456789, again." |
+  head -c $((SIZE / 4)) >"$WORK_DIR/input.txt"
+"$MORSE" -e -j 0 -o "$WORK_DIR/input.morse" <"$WORK_DIR/input.txt" || exit 1
+bytes=$(wc -c <"$WORK_DIR/input.morse")
+
+run() {
+  start=$(now_ns)
+  "$MORSE" -d -j "$1" -o "$WORK_DIR/output.txt" <"$WORK_DIR/input.morse" ||
+    exit 1
+  end=$(now_ns)
+  echo $((end - start))
+}
+
+printf "%8s %12s %10s %8s\n" "threads" "ms" "MB/s" "speedup" | tee -a "$OUTPUT"
+serial=$(run 1)
+for threads in 1 $THREADS; do
+  if [ "$threads" = 1 ]; then
+    elapsed=$serial
+  else
+    elapsed=$(run "$threads")
+  fi
+  awk -v t="$threads" -v b="$bytes" -v ns="$elapsed" -v base="$serial" 'BEGIN {
+    printf "%8s %12.2f %10.1f %7.2fx\n", (t == 0 ? "cores" : t), ns / 1e6,
+           (b / 1048576) / (ns / 1e9), base / ns
+  }' | tee -a "$OUTPUT"
+done
@@ -0,0 +1,47 @@
+#!/bin/sh
+# @file encode_scaling.sh
+# @brief Regression benchmark: encode time must grow linearly with input size
+#
+# Usage: bench/encode_scaling.sh [MORSE_BINARY] [MAX_SIZE_BYTES]
+#
+# Encodes generated prose from 1 KB up to MAX_SIZE_BYTES (default 1 GB) in
+# steps of 8x and prints the time per input byte. With a linear encoder the
+# ns/byte column stays flat; a quadratic encoder grows it by 8x per row.
+# Results are also appended to bench_output.txt.
+
+MORSE=${1:-./build/morse}
+MAX_SIZE=${2:-1073741824}
+WORK_DIR=${TMPDIR:-/tmp}/morse_bench.$$
+OUTPUT=bench_output.txt
+
+if [ ! -x "$MORSE" ]; then
+  echo "Error: morse binary '$MORSE' not found" >&2
+  exit 1
+fi
+
+mkdir -p "$WORK_DIR" || exit 1
+trap 'rm -rf "$WORK_DIR"' EXIT INT TERM
+
+now_ns() { date +%s%N; }
+
+printf "%12s %12s %10s %10s\n" "bytes" "ms" "ns/byte" "MB/s" | tee -a "$OUTPUT"
+
+size=1024
+while [ "$size" -le "$MAX_SIZE" ]; do
+  input="$WORK_DIR/input_$size.txt"
+  yes "The quick brown fox jumps over the lazy dog 0123456789, again." |
+    head -c "$size" >"$input"
+
+  start=$(now_ns)
+  "$MORSE" -e <"$input" >/dev/null || exit 1
+  end=$(now_ns)
+
+  elapsed=$((end - start))
+  awk -v b="$size" -v ns="$elapsed" 'BEGIN {
+    printf "%12d %12.2f %10.2f %10.1f\n", b, ns / 1e6, ns / b,
+           (b / 1048576) / (ns / 1e9)
+  }' | tee -a "$OUTPUT"
+
+  rm -f "$input"
+  size=$((size * 8))
+done
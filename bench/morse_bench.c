@@ -0,0 +1,458 @@
+/**
+ * @file morse_bench.c
+ * @brief Throughput and latency benchmark for the libmorse entry points
+ * @author Diego Rubio Carrera
+ *
+ * Usage: morse_bench [--max-size BYTES] [--corpus NAME] [--json FILE]
+ *
+ * Converts a matrix of generated corpora at sizes from 64 B up to
+ * --max-size (default 64 MB, at most 1 GB) in steps of 16x, through
+ * morseEncode() and morseDecode() - the calls behind the CLI's encodeText()
+ * and decodeText(). Every call is timed on its own, so the table shows the
+ * median throughput together with p50/p99 call latency; small messages are
+ * repeated until the percentiles are stable. --json writes the same
+ * results as a machine-readable report ("-" for stdout) that can be
+ * compared between releases.
+ *
+ * Inputs are generated with a fixed seed and are identical on every run.
+ * Decoding is measured on Morse code of the given size, produced by
+ * encoding the corpus. Large sizes need up to about eight times their size
+ * in memory.
+ */
+
+#define _POSIX_C_SOURCE 200809L // clock_gettime
+
+#include <morse/morse.h>
+#include <morse_codec.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+/* Smallest size and step of the size matrix */
+#define MIN_SIZE 64
+#define SIZE_STEP 16
+
+/* Largest size accepted for --max-size */
+#define MAX_SIZE_LIMIT (1024L * 1024 * 1024)
+
+/* Default --max-size, small enough for any development machine */
+#define DEFAULT_MAX_SIZE (64L * 1024 * 1024)
+
+/* Calls timed per measurement: at least MIN_CALLS, more until
+ * MIN_SECONDS have passed, never more than MAX_CALLS */
+#define MIN_CALLS 5
+#define MAX_CALLS 100000
+#define MIN_SECONDS 0.25
+
+/* Generates size bytes of one corpus into text */
+typedef void (*CorpusGenerator)(char *text, size_t size, uint64_t *seed);
+
+/* One row of the corpus matrix */
+typedef struct {
+  const char *name;
+  CorpusGenerator generate;
+  unsigned int encodeFlags; // also used to produce the decoder's input
+} Corpus;
+
+/* Timing of one corpus, operation and size */
+typedef struct {
+  const char *corpus;
+  const char *operation; // "encode" or "decode"
+  size_t bytes;          // input bytes per call
+  size_t calls;
+  double megabytesPerSecond; // from the median call
+  double nsPerChar;          // median call time per input byte
+  double p50Ns;
+  double p99Ns;
+} Measurement;
+
+static void generateProse(char *text, size_t size, uint64_t *seed);
+static void generateAlphanumeric(char *text, size_t size, uint64_t *seed);
+static void generatePunctuation(char *text, size_t size, uint64_t *seed);
+static void generateFallback(char *text, size_t size, uint64_t *seed);
+static void generateSpaces(char *text, size_t size, uint64_t *seed);
+static void generateCrlf(char *text, size_t size, uint64_t *seed);
+
+static const Corpus CORPORA[] = {
+    {"prose", generateProse, 0},
+    {"alphanumeric", generateAlphanumeric, 0},
+    {"punctuation", generatePunctuation, 0},
+    {"fallback", generateFallback, 0},
+    {"spaces", generateSpaces, 0},
+    {"slash", generateProse, MORSE_SLASH_WORDSPACER},
+    {"crlf", generateCrlf, 0},
+};
+
+#define CORPUS_COUNT (sizeof(CORPORA) / sizeof(CORPORA[0]))
+
+static bool parseArguments(int argc, char **argv, size_t *maxSize,
+                           const char **corpusName, const char **jsonPath);
+static bool measureCorpus(const Corpus *corpus, size_t size,
+                          Measurement *encode, Measurement *decode);
+static char *createMorse(const Corpus *corpus, size_t size);
+static void timeCalls(const char *input, size_t size, char *out,
+                      size_t capacity, bool decode, unsigned int flags,
+                      Measurement *measurement);
+static int compareDoubles(const void *a, const void *b);
+static double nowNs(void);
+static uint64_t nextRandom(uint64_t *seed);
+static void printMeasurement(const Measurement *measurement);
+static bool writeJson(const char *path, const Measurement *measurements,
+                      size_t count);
+static const char *kernelName(MorseKernel kernel);
+
+int main(int argc, char **argv) {
+  size_t maxSize = DEFAULT_MAX_SIZE;
+  const char *corpusName = NULL;
+  const char *jsonPath = NULL;
+  if (!parseArguments(argc, argv, &maxSize, &corpusName, &jsonPath)) {
+    fprintf(stderr, "Usage: %s [--max-size BYTES] [--corpus NAME] "
+                    "[--json FILE]\n",
+            argv[0]);
+    return 1;
+  }
+
+  size_t sizeCount = 0;
+  for (size_t size = MIN_SIZE; size <= maxSize; size *= SIZE_STEP) {
+    sizeCount++;
+  }
+  Measurement *measurements =
+      malloc(CORPUS_COUNT * sizeCount * 2 * sizeof(Measurement));
+  if (!measurements) {
+    fprintf(stderr, "Error: Memory allocation failed\n");
+    return 1;
+  }
+
+  printf("kernel: %s\n", kernelName(morseBestKernel()));
+  printf("%-13s %-7s %11s %9s %10s %9s %12s %12s\n", "corpus", "op",
+         "bytes", "calls", "MB/s", "ns/char", "p50 ns", "p99 ns");
+  size_t count = 0;
+  for (size_t c = 0; c < CORPUS_COUNT; c++) {
+    if (corpusName && strcmp(corpusName, CORPORA[c].name) != 0) {
+      continue;
+    }
+    for (size_t size = MIN_SIZE; size <= maxSize; size *= SIZE_STEP) {
+      if (!measureCorpus(&CORPORA[c], size, &measurements[count],
+                         &measurements[count + 1])) {
+        fprintf(stderr, "Error: Memory allocation failed at %zu bytes\n",
+                size);
+        free(measurements);
+        return 1;
+      }
+      printMeasurement(&measurements[count]);
+      printMeasurement(&measurements[count + 1]);
+      count += 2;
+    }
+  }
+
+  if (count == 0) {
+    fprintf(stderr, "Error: Unknown corpus '%s'\n", corpusName);
+    free(measurements);
+    return 1;
+  }
+  bool written = !jsonPath || writeJson(jsonPath, measurements, count);
+  free(measurements);
+  return written ? 0 : 1;
+}
+
+static bool parseArguments(int argc, char **argv, size_t *maxSize,
+                           const char **corpusName, const char **jsonPath) {
+  for (int i = 1; i < argc; i++) {
+    if (i + 1 >= argc) {
+      return false;
+    }
+    if (strcmp(argv[i], "--max-size") == 0) {
+      char *end;
+      unsigned long long value = strtoull(argv[++i], &end, 10);
+      if (*end != '\0' || value < MIN_SIZE || value > MAX_SIZE_LIMIT) {
+        return false;
+      }
+      *maxSize = (size_t)value;
+    } else if (strcmp(argv[i], "--corpus") == 0) {
+      *corpusName = argv[++i];
+    } else if (strcmp(argv[i], "--json") == 0) {
+      *jsonPath = argv[++i];
+    } else {
+      return false;
+    }
+  }
+  return true;
+}
+
+/* Time encoding size bytes of the corpus and decoding size bytes of its
+ * Morse code */
+static bool measureCorpus(const Corpus *corpus, size_t size,
+                          Measurement *encode, Measurement *decode) {
+  uint64_t seed = 0x9e3779b97f4a7c15u;
+  char *text = malloc(size);
+  char *morse = createMorse(corpus, size);
+  char *out = NULL;
+  size_t encodedSize = 0;
+  if (text) {
+    corpus->generate(text, size, &seed);
+    encodedSize = morseEncode(text, size, NULL, 0, corpus->encodeFlags);
+    // Decoded text is never longer than its code
+    out = malloc(encodedSize > size ? encodedSize : size);
+  }
+  bool ok = text && morse && out;
+
+  if (ok) {
+    // Exact capacities, as encodeText() and decodeText() pass them: the
+    // timings include the sizing pass
+    *encode = (Measurement){corpus->name, "encode", size, 0, 0, 0, 0, 0};
+    timeCalls(text, size, out, encodedSize, false, corpus->encodeFlags,
+              encode);
+    *decode = (Measurement){corpus->name, "decode", size, 0, 0, 0, 0, 0};
+    size_t decodedSize = morseDecode(morse, size, NULL, 0, 0);
+    timeCalls(morse, size, out, decodedSize, true, 0, decode);
+  }
+  free(text);
+  free(morse);
+  free(out);
+  return ok;
+}
+
+/* Encode ever longer prefixes of the corpus until there are size bytes of
+ * Morse code, and keep the first size bytes */
+static char *createMorse(const Corpus *corpus, size_t size) {
+  for (size_t textSize = size / 2 + MIN_SIZE;; textSize *= 2) {
+    uint64_t seed = 0x9e3779b97f4a7c15u;
+    char *text = malloc(textSize);
+    if (!text) {
+      return NULL;
+    }
+    corpus->generate(text, textSize, &seed);
+    size_t morseSize = morseEncode(text, textSize, NULL, 0,
+                                   corpus->encodeFlags);
+    char *morse = morseSize >= size ? malloc(morseSize) : NULL;
+    if (morse) {
+      morseEncode(text, textSize, morse, morseSize, corpus->encodeFlags);
+    }
+    free(text);
+    if (morse || morseSize >= size) {
+      return morse;
+    }
+  }
+}
+
+/* Call the codec until enough samples are collected, timing every call */
+static void timeCalls(const char *input, size_t size, char *out,
+                      size_t capacity, bool decode, unsigned int flags,
+                      Measurement *measurement) {
+  double *samples = malloc(MAX_CALLS * sizeof(double));
+  size_t calls = 0;
+  double elapsed = 0;
+  volatile size_t sink = 0; // keeps the calls from being optimized away
+
+  while (calls < MAX_CALLS &&
+         (calls < MIN_CALLS || elapsed < MIN_SECONDS * 1e9)) {
+    double start = nowNs();
+    sink += decode ? morseDecode(input, size, out, capacity, flags)
+                   : morseEncode(input, size, out, capacity, flags);
+    double duration = nowNs() - start;
+    if (samples) {
+      samples[calls] = duration;
+    }
+    elapsed += duration;
+    calls++;
+  }
+  (void)sink;
+
+  measurement->calls = calls;
+  if (!samples) {
+    measurement->p50Ns = measurement->p99Ns = elapsed / (double)calls;
+  } else {
+    qsort(samples, calls, sizeof(double), compareDoubles);
+    measurement->p50Ns = samples[calls / 2];
+    measurement->p99Ns = samples[calls * 99 / 100];
+    free(samples);
+  }
+  measurement->nsPerChar = measurement->p50Ns / (double)size;
+  measurement->megabytesPerSecond =
+      (double)size / 1048576.0 / (measurement->p50Ns / 1e9);
+}
+
+static int compareDoubles(const void *a, const void *b) {
+  double x = *(const double *)a;
+  double y = *(const double *)b;
+  return (x > y) - (x < y);
+}
+
+static double nowNs(void) {
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return (double)now.tv_sec * 1e9 + (double)now.tv_nsec;
+}
+
+/* xorshift64: fast, and identical on every platform */
+static uint64_t nextRandom(uint64_t *seed) {
+  *seed ^= *seed << 13;
+  *seed ^= *seed >> 7;
+  *seed ^= *seed << 17;
+  return *seed;
+}
+
+/* English-like words with sentence punctuation */
+static void generateProse(char *text, size_t size, uint64_t *seed) {
+  static const char *const words[] = {
+      "the",   "of",    "and",   "to",     "in",    "is",    "that",
+      "for",   "it",    "as",    "was",    "with",  "be",    "by",
+      "on",    "not",   "he",    "this",   "are",   "or",    "his",
+      "from",  "at",    "which", "but",    "have",  "an",    "had",
+      "they",  "you",   "were",  "their",  "one",   "all",   "we",
+      "can",   "her",   "has",   "there",  "been",  "if",    "more",
+      "when",  "will",  "would", "who",    "so",    "no",    "signal",
+      "morse", "radio", "ship",  "harbor", "night", "code",  "station"};
+  size_t wordCount = sizeof(words) / sizeof(words[0]);
+  size_t i = 0;
+  while (i < size) {
+    const char *word = words[nextRandom(seed) % wordCount];
+    for (size_t j = 0; word[j] && i < size; j++) {
+      text[i++] = word[j];
+    }
+    uint64_t r = nextRandom(seed) % 16;
+    if (r == 0 && i < size) {
+      text[i++] = '.';
+    } else if (r == 1 && i < size) {
+      text[i++] = ',';
+    }
+    if (i < size) {
+      text[i++] = ' ';
+    }
+  }
+}
+
+/* Random letters of both cases and digits in words of 1-12 bytes */
+static void generateAlphanumeric(char *text, size_t size, uint64_t *seed) {
+  static const char alphabet[] =
+      "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789";
+  size_t i = 0;
+  while (i < size) {
+    size_t wordLength = 1 + nextRandom(seed) % 12;
+    for (size_t j = 0; j < wordLength && i < size; j++) {
+      text[i++] = alphabet[nextRandom(seed) % (sizeof(alphabet) - 1)];
+    }
+    if (i < size) {
+      text[i++] = ' ';
+    }
+  }
+}
+
+/* Mostly punctuation, math and format symbols, the longest codes */
+static void generatePunctuation(char *text, size_t size, uint64_t *seed) {
+  static const char symbols[] = ".,:;?!=-+_()/@";
+  for (size_t i = 0; i < size; i++) {
+    uint64_t r = nextRandom(seed);
+    text[i] = r % 8 == 0   ? ' '
+              : r % 8 == 1 ? (char)('A' + r / 8 % 26)
+                           : symbols[r / 8 % (sizeof(symbols) - 1)];
+  }
+}
+
+/* Bytes without a code - '*' in the output - e.g. UTF-8 and brackets */
+static void generateFallback(char *text, size_t size, uint64_t *seed) {
+  static const char unsupported[] = "#$%&*<>[]{}~^|\"'`\\";
+  for (size_t i = 0; i < size; i++) {
+    uint64_t r = nextRandom(seed);
+    switch (r % 8) {
+    case 0:
+      text[i] = ' ';
+      break;
+    case 1:
+      text[i] = (char)('a' + r / 8 % 26);
+      break;
+    case 2:
+    case 3:
+      text[i] = (char)(0x80 + r / 8 % 0x80); // UTF-8 sequence bytes
+      break;
+    default:
+      text[i] = unsupported[r / 8 % (sizeof(unsupported) - 1)];
+    }
+  }
+}
+
+/* Short words between long runs of spaces */
+static void generateSpaces(char *text, size_t size, uint64_t *seed) {
+  size_t i = 0;
+  while (i < size) {
+    size_t spaces = 1 + nextRandom(seed) % 64;
+    for (size_t j = 0; j < spaces && i < size; j++) {
+      text[i++] = ' ';
+    }
+    size_t wordLength = 1 + nextRandom(seed) % 4;
+    for (size_t j = 0; j < wordLength && i < size; j++) {
+      text[i++] = (char)('A' + nextRandom(seed) % 26);
+    }
+  }
+}
+
+/* Prose in lines of about 60-80 bytes ending in CR/LF */
+static void generateCrlf(char *text, size_t size, uint64_t *seed) {
+  generateProse(text, size, seed);
+  size_t i = 60 + nextRandom(seed) % 20;
+  while (i + 1 < size) {
+    text[i] = '\r';
+    text[i + 1] = '\n';
+    i += 62 + nextRandom(seed) % 20;
+  }
+}
+
+static void printMeasurement(const Measurement *measurement) {
+  printf("%-13s %-7s %11zu %9zu %10.1f %9.3f %12.0f %12.0f\n",
+         measurement->corpus, measurement->operation, measurement->bytes,
+         measurement->calls, measurement->megabytesPerSecond,
+         measurement->nsPerChar, measurement->p50Ns, measurement->p99Ns);
+}
+
+/* Write the report as JSON, one object per measurement */
+static bool writeJson(const char *path, const Measurement *measurements,
+                      size_t count) {
+  bool toStdout = strcmp(path, "-") == 0;
+  FILE *file = toStdout ? stdout : fopen(path, "w");
+  if (!file) {
+    fprintf(stderr, "Error: Could not open file '%s' for writing\n", path);
+    return false;
+  }
+
+  fprintf(file, "{\n  \"benchmark\": \"morse_bench\",\n");
+  fprintf(file, "  \"kernel\": \"%s\",\n", kernelName(morseBestKernel()));
+  fprintf(file, "  \"results\": [\n");
+  for (size_t i = 0; i < count; i++) {
+    const Measurement *m = &measurements[i];
+    fprintf(file,
+            "    {\"corpus\": \"%s\", \"operation\": \"%s\", "
+            "\"bytes\": %zu, \"calls\": %zu, \"mb_per_s\": %.2f, "
+            "\"ns_per_char\": %.4f, \"p50_ns\": %.0f, \"p99_ns\": %.0f}%s\n",
+            m->corpus, m->operation, m->bytes, m->calls,
+            m->megabytesPerSecond, m->nsPerChar, m->p50Ns, m->p99Ns,
+            i + 1 < count ? "," : "");
+  }
+  fprintf(file, "  ]\n}\n");
+
+  bool ok = !ferror(file);
+  if (!toStdout && fclose(file) != 0) {
+    ok = false;
+  }
+  if (!ok) {
+    fprintf(stderr, "Error: Could not write complete content to file\n");
+  }
+  return ok;
+}
+
+static const char *kernelName(MorseKernel kernel) {
+  switch (kernel) {
+  case MORSE_KERNEL_SSE2:
+    return "sse2";
+  case MORSE_KERNEL_AVX2:
+    return "avx2";
+  case MORSE_KERNEL_AVX512:
+    return "avx512";
+  case MORSE_KERNEL_NEON:
+    return "neon";
+  default:
+    return "scalar";
+  }
+}
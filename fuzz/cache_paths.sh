@@ -0,0 +1,83 @@
+#!/bin/sh
+# @file cache_paths.sh
+# @brief Regression check: --cache entries are the same from every path
+#
+# Usage: fuzz/cache_paths.sh [MORSE_BINARY]
+#
+# A text given as an argument and the same text in a file share a cache
+# key, so each path must store what the other one writes. For every mode
+# the text is converted through one cache directory by argument, then by
+# file, then by argument again, and once more with the file first; every
+# output must equal the uncached conversion of the file. Arguments are
+# only read with stdin on a terminal, so those runs go through script(1)
+# of util-linux.
+
+MORSE=${1:-./build/morse}
+WORK_DIR=${TMPDIR:-/tmp}/morse_cache_paths.$$
+
+if [ ! -x "$MORSE" ]; then
+  echo "Error: morse binary '$MORSE' not found" >&2
+  exit 1
+fi
+# script(1) runs the argument conversions in a shell of its own
+case $MORSE in
+/*) ;;
+*) MORSE=$(pwd)/$MORSE ;;
+esac
+if ! script -qec true /dev/null </dev/null >/dev/null 2>&1; then
+  echo "Error: script(1) of util-linux is needed for argument input" >&2
+  exit 1
+fi
+
+mkdir -p "$WORK_DIR" || exit 1
+trap 'rm -rf "$WORK_DIR"' EXIT INT TERM
+failures=0
+
+# morse on a terminal, with the text as its last argument
+by_argument() {
+  script -qec "'$MORSE' $1 -o '$WORK_DIR/out' '$2'" /dev/null \
+    </dev/null >/dev/null 2>&1
+}
+
+# morse preferring stdin, as it does whenever stdin is not a terminal; a
+# regular file there is converted through the cache like a named one
+by_file() {
+  "$MORSE" $1 -o "$WORK_DIR/out" <"$WORK_DIR/in" >/dev/null 2>&1
+}
+
+# check NAME OPTIONS TEXT: both orders of the two paths on one cache
+check() {
+  printf '%s' "$3" >"$WORK_DIR/in"
+  by_file "$2" && mv "$WORK_DIR/out" "$WORK_DIR/expected" || {
+    echo "$1: uncached conversion failed" >&2
+    failures=$((failures + 1))
+    return
+  }
+  for first in by_argument by_file; do
+    rm -rf "$WORK_DIR/cache"
+    for run in $first by_argument by_file; do
+      rm -f "$WORK_DIR/out"
+      if ! $run "$2 --cache $WORK_DIR/cache" "$3" ||
+        ! cmp -s "$WORK_DIR/expected" "$WORK_DIR/out"; then
+        echo "$1: $run after $first differs from the uncached output" >&2
+        failures=$((failures + 1))
+      fi
+    done
+  done
+}
+
+check "encode" "-e" "HELLO WORLD"
+check "encode, slash" "-e --slash-wordspacer" "HELLO WORLD"
+check "encode, packed" "-e --format=packed" "HELLO WORLD"
+check "encode, packed, slash" "-e --format=packed --slash-wordspacer" \
+  "HELLO WORLD"
+check "decode" "-d" ".... . .-.. .-.. ---   .-- --- .-. .-.. -.."
+check "transcode, packed" "--transcode --format=packed" \
+  ".... . .-.. .-.. ---   .-- --- .-. .-.. -.."
+check "table" "--table extended" "HELLO <SK>"
+
+if [ "$failures" -gt 0 ]; then
+  echo "$failures cache path checks failed" >&2
+  exit 1
+fi
+echo "every cache path gives the uncached output"
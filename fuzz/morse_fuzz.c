@@ -0,0 +1,966 @@
+/**
+ * @file morse_fuzz.c
+ * @brief Fuzz target pinning every codec engine to a frozen reference
+ * @author Diego Rubio Carrera
+ *
+ * Usage: morse_fuzz [--iterations N] [--seed S] [--max-size BYTES]
+ *        morse_fuzz FILE...
+ *
+ * Every input is encoded and decoded by each engine - the one-call API,
+ * the streaming codec at random chunk splits with every kernel, the
+ * measuring passes, the parallel codec, the multi-channel decoder, the
+ * packed format and its transcoding to and from text, and the
+ * table-driven codec of --table on a table of the same alphabet - and
+ * each result must be byte-identical to encodeText() and decodeText() of
+ * the original single-file morse.c, kept below as the reference. Decoding
+ * also runs on the reference's encoding of the input, so valid Morse code
+ * is covered as well as noise, strict decoding must report the same
+ * offsets with every kernel and split, and the table-driven codec must
+ * count the symbols of --stats that the reference converts.
+ *
+ * The first input byte selects the word spacer and whether the rest is
+ * mapped onto the Morse alphabet first; the splits are derived from the
+ * input, so every run of one input is the same. A mismatch prints the
+ * engine and the first differing byte and aborts.
+ *
+ * Built with -DMORSE_FUZZ_LIBFUZZER this is a libFuzzer target. Otherwise
+ * main() checks the FILEs given, which makes it an AFL target
+ * (morse_fuzz @@) and replays crash files, or generates --iterations
+ * random inputs of up to --max-size bytes; a failing generated input is
+ * saved to morse_fuzz_failure.bin.
+ */
+
+#include <ctype.h>
+#include <morse/morse.h>
+#include <morse_alphabet.h>
+#include <morse_channels.h>
+#include <morse_codec.h>
+#include <morse_packed.h>
+#include <morse_parallel.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* Threads of the parallel codec; inputs above 64 KB are shared out */
+#define FUZZ_THREADS 4
+
+/* Most channels of the multi-channel decoder, a full tile and part of
+ * another, and most bytes of all channels together */
+#define MAX_CHANNELS 70
+#define CHANNEL_BUDGET (128 * 1024)
+
+/* Defaults of the standalone driver; large enough for the parallel codec
+ * to split some inputs */
+#define DEFAULT_ITERATIONS 10000
+#define DEFAULT_MAX_SIZE (256 * 1024)
+#define MAX_SIZE_LIMIT (64L * 1024 * 1024)
+
+/* Control byte: ' / ' between words when encoding */
+#define CONTROL_SLASH 0x1
+
+/* Control byte: map every other byte onto the Morse alphabet */
+#define CONTROL_MORSE 0x2
+
+/* Where the standalone driver saves a failing generated input */
+#define FAILURE_PATH "morse_fuzz_failure.bin"
+
+/* Offsets reported by a strict decoder */
+typedef struct {
+  size_t *offsets;
+  size_t count;
+  size_t capacity;
+} OffsetList;
+
+/* The input being checked, saved if an engine disagrees */
+static const char *currentInput;
+static size_t currentLength;
+static bool saveFailures;
+
+static MorseParallel *parallel;
+
+static char *referenceEncode(const char *text, bool useSlashWordspacer,
+                             size_t *length);
+static char *referenceDecode(const char *morse, size_t *length);
+static void checkInput(const uint8_t *data, size_t size);
+static void checkEncode(const char *text, size_t length, bool slash,
+                        uint64_t seed);
+static void checkDecode(const char *morse, size_t length, uint64_t seed);
+static void checkChannels(const char *morse, size_t length, uint64_t seed);
+static void checkAlphabet(const char *text, size_t length, bool slash,
+                          uint64_t seed);
+static void checkPacked(const char *text, size_t length, bool slash,
+                        uint64_t seed);
+static void collectOffset(void *context, size_t offset);
+static void expectBytes(const char *engine, const char *expected,
+                        size_t expectedLength, const char *actual,
+                        size_t actualLength);
+static void expectSize(const char *engine, size_t expected, size_t actual);
+static void fail(const char *engine);
+static size_t nextPiece(uint64_t *seed, size_t remaining);
+static uint64_t nextRandom(uint64_t *seed);
+static void *allocate(size_t size);
+
+/* ------------------------------------------------------------------ */
+/* Frozen reference: the alphabet, encodeText() and decodeText() of the
+ * original morse.c. Only the buffer handling differs - strcat() became an
+ * append at a tracked end, and the caller owns the buffer - which writes
+ * the same bytes in linear time. Never change what this code produces;
+ * the engines must match it. */
+
+typedef struct {
+  char character;
+  const char *code;
+} MorseMapping;
+
+static const MorseMapping MORSE_TABLE[] = {
+    {'A', ".-"},     {'B', "-..."},   {'C', "-.-."},   {'D', "-.."},
+    {'E', "."},      {'F', "..-."},   {'G', "--."},    {'H', "...."},
+    {'I', ".."},     {'J', ".---"},   {'K', "-.-"},    {'L', ".-.."},
+    {'M', "--"},     {'N', "-."},     {'O', "---"},    {'P', ".--."},
+    {'Q', "--.-"},   {'R', ".-."},    {'S', "..."},    {'T', "-"},
+    {'U', "..-"},    {'V', "...-"},   {'W', ".--"},    {'X', "-..-"},
+    {'Y', "-.--"},   {'Z', "--.."},   {'0', "-----"},  {'1', ".----"},
+    {'2', "..---"},  {'3', "...--"},  {'4', "....-"},  {'5', "....."},
+    {'6', "-...."},  {'7', "--..."},  {'8', "---.."},  {'9', "----."},
+    {'.', ".-.-.-"}, {',', "--..--"}, {':', "---..."}, {';', "-.-.-."},
+    {'?', "..--.."}, {'!', "-.-.--"}, {'=', "-...-"},  {'-', "-....-"},
+    {'+', ".-.-."},  {'_', "..--.-"}, {'(', "-.--."},  {')', "-.--.-"},
+    {'/', "-..-."},  {'@', ".--.-."}, {' ', "/"}};
+
+static const char *getCharacterCode(char c) {
+  const int tableSize = sizeof(MORSE_TABLE) / sizeof(MORSE_TABLE[0]);
+  c = (char)toupper((unsigned char)c);
+
+  for (int i = 0; i < tableSize; i++) {
+    if (MORSE_TABLE[i].character == c) {
+      return MORSE_TABLE[i].code;
+    }
+  }
+  return NULL; // Character not found
+}
+
+static char getCodeCharacter(const char *code) {
+  const int tableSize = sizeof(MORSE_TABLE) / sizeof(MORSE_TABLE[0]);
+
+  for (int i = 0; i < tableSize; i++) {
+    if (strcmp(MORSE_TABLE[i].code, code) == 0) {
+      return MORSE_TABLE[i].character;
+    }
+  }
+  return '\0'; // Code not found
+}
+
+/* Append a string at the tracked end of result */
+static void append(char *result, size_t *end, const char *string) {
+  size_t length = strlen(string);
+  memcpy(result + *end, string, length + 1);
+  *end += length;
+}
+
+/* text is NUL-terminated, like the original's input */
+static char *referenceEncode(const char *text, bool useSlashWordspacer,
+                             size_t *length) {
+  char *result = allocate(strlen(text) * 7 + 1);
+  size_t end = 0;
+  result[0] = '\0';
+
+  bool lastWasSpace = false;
+  bool firstChar = true;
+
+  for (size_t i = 0; text[i] != '\0'; i++) {
+    char currentChar = text[i];
+
+    // ReqFunc28: Skip newlines and carriage returns
+    if (currentChar == '\n' || currentChar == '\r') {
+      continue;
+    }
+
+    // Handle word separation
+    if (currentChar == ' ') {
+      if (!lastWasSpace && !firstChar) {
+        if (useSlashWordspacer) {
+          // ReqOptFunc02: Use " / " between words
+          append(result, &end, " / ");
+        } else {
+          // ReqFunc27: Use triple space between words
+          append(result, &end, "   ");
+        }
+      }
+      lastWasSpace = true;
+      continue;
+    }
+
+    // ReqFunc26: Add space between letters (except before first letter)
+    if (!firstChar && !lastWasSpace) {
+      append(result, &end, " ");
+    }
+
+    const char *code = getCharacterCode(currentChar);
+    if (code) {
+      append(result, &end, code);
+    } else {
+      // ReqFunc25: Output * for unsupported characters
+      append(result, &end, "*");
+    }
+
+    lastWasSpace = false;
+    if (firstChar) {
+      firstChar = false;
+    }
+  }
+
+  *length = end;
+  return result;
+}
+
+/* morse is NUL-terminated, like the original's input */
+static char *referenceDecode(const char *morse, size_t *length) {
+  char *result = allocate(strlen(morse) + 1);
+  result[0] = '\0';
+
+  char codeBuf[20] = {0};
+  size_t codeBufIndex = 0;
+  size_t resultIndex = 0;
+  int spaceCount = 0;
+
+  for (size_t i = 0; morse[i] != '\0'; i++) {
+    // ReqFunc28: Skip newlines and carriage returns
+    if (morse[i] == '\n' || morse[i] == '\r') {
+      continue;
+    }
+
+    if (morse[i] == ' ') {
+      spaceCount++;
+
+      if (spaceCount == 1 && codeBufIndex > 0) {
+        // End of a character (single space)
+        codeBuf[codeBufIndex] = '\0';
+        char c = getCodeCharacter(codeBuf);
+        if (c != '\0') {
+          result[resultIndex++] = c;
+          result[resultIndex] = '\0';
+        }
+        codeBufIndex = 0;
+      } else if (spaceCount == 3) {
+        // End of a word (triple space)
+        result[resultIndex++] = ' ';
+        result[resultIndex] = '\0';
+        spaceCount = 0;
+      }
+    } else if (morse[i] == '/') {
+      // Handle slash word separator
+      if (codeBufIndex > 0) {
+        codeBuf[codeBufIndex] = '\0';
+        char c = getCodeCharacter(codeBuf);
+        if (c != '\0') {
+          result[resultIndex++] = c;
+          result[resultIndex] = '\0';
+        }
+        codeBufIndex = 0;
+      }
+      result[resultIndex++] = ' ';
+      result[resultIndex] = '\0';
+      spaceCount = 0;
+    } else {
+      // Part of a morse character
+      spaceCount = 0;
+      if (codeBufIndex < sizeof(codeBuf) - 1) {
+        codeBuf[codeBufIndex++] = morse[i];
+      }
+    }
+  }
+
+  // Process the last code if there is one
+  if (codeBufIndex > 0) {
+    codeBuf[codeBufIndex] = '\0';
+    char c = getCodeCharacter(codeBuf);
+    if (c != '\0') {
+      result[resultIndex++] = c;
+      result[resultIndex] = '\0';
+    }
+  }
+
+  *length = resultIndex;
+  return result;
+}
+
+/* ------------------------------------------------------------------ */
+
+#ifdef MORSE_FUZZ_LIBFUZZER
+int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size);
+
+int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size) {
+  checkInput(data, size);
+  return 0;
+}
+#else
+static bool parseArguments(int argc, char **argv, unsigned long *iterations,
+                           uint64_t *seed, size_t *maxSize, int *firstFile);
+static bool checkFile(const char *path);
+static size_t generateInput(uint8_t *data, size_t maxSize, uint64_t *seed);
+
+int main(int argc, char **argv) {
+  unsigned long iterations = DEFAULT_ITERATIONS;
+  uint64_t seed = 0x9e3779b97f4a7c15u;
+  size_t maxSize = DEFAULT_MAX_SIZE;
+  int firstFile = argc;
+  if (!parseArguments(argc, argv, &iterations, &seed, &maxSize, &firstFile)) {
+    fprintf(stderr, "Usage: %s [--iterations N] [--seed S] "
+                    "[--max-size BYTES]\n"
+                    "       %s FILE...\n",
+            argv[0], argv[0]);
+    return 1;
+  }
+
+  if (firstFile < argc) {
+    for (int i = firstFile; i < argc; i++) {
+      if (!checkFile(argv[i])) {
+        return 1;
+      }
+    }
+    printf("%d files: every engine matches the reference\n", argc - firstFile);
+    morseParallelDestroy(parallel);
+    return 0;
+  }
+
+  uint8_t *data = allocate(maxSize);
+  size_t total = 0;
+  saveFailures = true;
+  for (unsigned long i = 0; i < iterations; i++) {
+    size_t size = generateInput(data, maxSize, &seed);
+    checkInput(data, size);
+    total += size;
+  }
+  printf("%lu inputs, %zu bytes: every engine matches the reference\n",
+         iterations, total);
+  free(data);
+  morseParallelDestroy(parallel);
+  return 0;
+}
+
+static bool parseArguments(int argc, char **argv, unsigned long *iterations,
+                           uint64_t *seed, size_t *maxSize, int *firstFile) {
+  for (int i = 1; i < argc; i++) {
+    if (strncmp(argv[i], "--", 2) != 0) {
+      *firstFile = i;
+      return true;
+    }
+    if (i + 1 >= argc) {
+      return false;
+    }
+    char *end;
+    unsigned long long value = strtoull(argv[++i], &end, 0);
+    if (*end != '\0') {
+      return false;
+    }
+    if (strcmp(argv[i - 1], "--iterations") == 0) {
+      *iterations = (unsigned long)value;
+    } else if (strcmp(argv[i - 1], "--seed") == 0 && value != 0) {
+      *seed = value; // xorshift never leaves 0
+    } else if (strcmp(argv[i - 1], "--max-size") == 0 && value > 0 &&
+               value <= MAX_SIZE_LIMIT) {
+      *maxSize = (size_t)value;
+    } else {
+      return false;
+    }
+  }
+  return true;
+}
+
+/* Check one saved input, e.g. a crash file or an AFL test case */
+static bool checkFile(const char *path) {
+  FILE *file = fopen(path, "rb");
+  if (!file) {
+    fprintf(stderr, "Error: Could not open file '%s'\n", path);
+    return false;
+  }
+  uint8_t *data = NULL;
+  size_t size = 0;
+  size_t capacity = 0;
+  for (;;) {
+    if (size == capacity) {
+      capacity = capacity ? capacity * 2 : 4096;
+      uint8_t *grown = realloc(data, capacity);
+      if (!grown) {
+        free(data);
+        fclose(file);
+        fprintf(stderr, "Error: Memory allocation failed\n");
+        return false;
+      }
+      data = grown;
+    }
+    size_t bytesRead = fread(data + size, 1, capacity - size, file);
+    if (bytesRead == 0) {
+      break;
+    }
+    size += bytesRead;
+  }
+  bool readFailed = ferror(file);
+  fclose(file);
+  if (readFailed) {
+    free(data);
+    fprintf(stderr, "Error: Could not read file '%s'\n", path);
+    return false;
+  }
+  checkInput(data, size);
+  free(data);
+  return true;
+}
+
+/* A random input: mostly short, sometimes large enough for the parallel
+ * codec, drawn from text, Morse code or raw bytes */
+static size_t generateInput(uint8_t *data, size_t maxSize, uint64_t *seed) {
+  static const char text[] = "EtAoiNshRdlu 019.,?!=+-_()/@;: *~\n\r  ";
+  static const char morse[] = ".-.-.-- -  / \n\r.-";
+  size_t size = (size_t)(nextRandom(seed) % maxSize) + 1;
+  if (nextRandom(seed) % 8 != 0) {
+    size = size % 512 + 1;
+  }
+
+  uint64_t kind = nextRandom(seed) % 3;
+  data[0] = (uint8_t)nextRandom(seed);
+  for (size_t i = 1; i < size; i++) {
+    uint64_t r = nextRandom(seed);
+    if (kind == 0) {
+      data[i] = (uint8_t)text[r % (sizeof(text) - 1)];
+    } else if (kind == 1) {
+      data[i] = (uint8_t)morse[r % (sizeof(morse) - 1)];
+    } else {
+      data[i] = (uint8_t)r;
+    }
+  }
+  return size;
+}
+#endif
+
+/* ------------------------------------------------------------------ */
+
+/* Check one fuzz input against the reference */
+static void checkInput(const uint8_t *data, size_t size) {
+  // The onto-Morse mapping favours dots, dashes and single spaces, so
+  // symbols of every length and all three gaps turn up
+  static const char MORSE_BYTES[16] = {'.', '-', '.',  '-',  ' ', '.',
+                                       '-', ' ', '/',  '.',  '-', ' ',
+                                       ' ', '\n', '\r', '*'};
+  if (size == 0) {
+    return;
+  }
+  unsigned int control = data[0];
+  size_t length = size - 1;
+
+  // The reference stops at a NUL byte, which the engines encode as '*';
+  // 0x01 is unsupported by both
+  char *input = allocate(length + 1);
+  for (size_t i = 0; i < length; i++) {
+    unsigned char byte = data[i + 1];
+    input[i] = (control & CONTROL_MORSE) ? MORSE_BYTES[byte % 16]
+               : byte == 0                ? '\x01'
+                                          : (char)byte;
+  }
+  input[length] = '\0';
+  currentInput = (const char *)data;
+  currentLength = size;
+
+  // FNV-1a of the input seeds the splits
+  uint64_t seed = 0xcbf29ce484222325u;
+  for (size_t i = 0; i < size; i++) {
+    seed = (seed ^ data[i]) * 0x100000001b3u;
+  }
+  seed |= 1;
+
+  bool slash = control & CONTROL_SLASH;
+  checkEncode(input, length, slash, seed);
+  checkDecode(input, length, seed);
+  checkChannels(input, length, seed);
+  checkPacked(input, length, slash, seed);
+  checkAlphabet(input, length, slash, seed);
+
+  // Valid Morse code for the decoders
+  size_t encodedLength;
+  char *encoded = referenceEncode(input, slash, &encodedLength);
+  checkDecode(encoded, encodedLength, seed);
+  checkChannels(encoded, encodedLength, seed);
+  checkAlphabet(encoded, encodedLength, slash, seed);
+  free(encoded);
+  free(input);
+}
+
+/* Encode with every engine; text is NUL-terminated */
+static void checkEncode(const char *text, size_t length, bool slash,
+                        uint64_t seed) {
+  size_t expectedLength;
+  char *expected = referenceEncode(text, slash, &expectedLength);
+  size_t capacity = MORSE_ENCODE_BOUND(length) + MORSE_FINISH_BOUND;
+  char *out = allocate(capacity);
+  unsigned int flags = slash ? MORSE_SLASH_WORDSPACER : 0;
+
+  expectSize("morseEncode size", expectedLength,
+             morseEncode(text, length, NULL, 0, flags));
+  size_t written = morseEncode(text, length, out, capacity, flags);
+  expectBytes("morseEncode", expected, expectedLength, out, written);
+
+  // Streaming at random splits, with every kernel
+  for (int kernel = MORSE_KERNEL_SCALAR; kernel <= MORSE_KERNEL_AVX512;
+       kernel++) {
+    MorseEncoder encoder;
+    morseEncoderInit(&encoder, slash);
+    written = 0;
+    for (size_t offset = 0; offset < length;) {
+      size_t piece = nextPiece(&seed, length - offset);
+      written += morseEncoderFeedKernel(&encoder, (MorseKernel)kernel,
+                                        text + offset, piece, out + written);
+      offset += piece;
+    }
+    written += morseEncoderFinish(&encoder, out + written);
+    expectBytes("morseEncoderFeedKernel", expected, expectedLength, out,
+                written);
+  }
+
+  MorseEncoder encoder;
+  morseEncoderInit(&encoder, slash);
+  size_t measured = 0;
+  for (size_t offset = 0; offset < length;) {
+    size_t piece = nextPiece(&seed, length - offset);
+    measured += morseEncoderMeasure(&encoder, text + offset, piece);
+    offset += piece;
+  }
+  expectSize("morseEncoderMeasure", expectedLength, measured);
+  morseEncoderInit(&encoder, slash);
+  expectSize("morseEncoderMeasureScalar", expectedLength,
+             morseEncoderMeasureScalar(&encoder, text, length));
+
+  // Parallel, in slices of random size
+  morseEncoderInit(&encoder, slash);
+  written = 0;
+  for (size_t offset = 0; offset < length;) {
+    size_t piece = nextPiece(&seed, length - offset);
+    size_t encodedLength;
+    const char *encoded = morseParallelEncode(parallel, &encoder, text + offset,
+                                              piece, &encodedLength);
+    if (!encoded) {
+      fail("morseParallelEncode: out of memory");
+    }
+    memcpy(out + written, encoded, encodedLength);
+    written += encodedLength;
+    offset += piece;
+  }
+  written += morseEncoderFinish(&encoder, out + written);
+  expectBytes("morseParallelEncode", expected, expectedLength, out, written);
+
+  free(out);
+  free(expected);
+}
+
+/* Decode with every engine; morse is NUL-terminated */
+static void checkDecode(const char *morse, size_t length, uint64_t seed) {
+  size_t expectedLength;
+  char *expected = referenceDecode(morse, &expectedLength);
+  size_t capacity = MORSE_DECODE_BOUND(length) + MORSE_FINISH_BOUND + 1;
+  char *out = allocate(capacity);
+
+  expectSize("morseDecode size", expectedLength,
+             morseDecode(morse, length, NULL, 0, 0));
+  size_t written = morseDecode(morse, length, out, capacity, 0);
+  expectBytes("morseDecode", expected, expectedLength, out, written);
+  expectSize("morseDecodedLength", expectedLength,
+             morseDecodedLength(morse, length));
+
+  // The scalar decoder in one piece sets the malformed offsets every
+  // kernel and split must report
+  OffsetList reference = {NULL, 0, 0};
+  MorseDecoder decoder;
+  morseDecoderInit(&decoder);
+  morseDecoderSetStrict(&decoder, collectOffset, &reference);
+  written = morseDecoderFeedScalar(&decoder, morse, length, out);
+  written += morseDecoderFinish(&decoder, out + written);
+  expectBytes("morseDecoderFeedScalar", expected, expectedLength, out,
+              written);
+
+  for (int kernel = MORSE_KERNEL_SCALAR; kernel <= MORSE_KERNEL_AVX512;
+       kernel++) {
+    OffsetList offsets = {NULL, 0, 0};
+    morseDecoderInit(&decoder);
+    morseDecoderSetStrict(&decoder, collectOffset, &offsets);
+    written = 0;
+    for (size_t offset = 0; offset < length;) {
+      size_t piece = nextPiece(&seed, length - offset);
+      written += morseDecoderFeedKernel(&decoder, (MorseKernel)kernel,
+                                        morse + offset, piece, out + written);
+      offset += piece;
+    }
+    written += morseDecoderFinish(&decoder, out + written);
+    expectBytes("morseDecoderFeedKernel", expected, expectedLength, out,
+                written);
+    expectBytes("strict offsets", (const char *)reference.offsets,
+                reference.count * sizeof(size_t), (const char *)offsets.offsets,
+                offsets.count * sizeof(size_t));
+    free(offsets.offsets);
+  }
+  free(reference.offsets);
+
+  morseDecoderInit(&decoder);
+  written = 0;
+  for (size_t offset = 0; offset < length;) {
+    size_t piece = nextPiece(&seed, length - offset);
+    size_t decodedLength;
+    const char *decoded = morseParallelDecode(parallel, &decoder,
+                                              morse + offset, piece,
+                                              &decodedLength);
+    if (!decoded) {
+      fail("morseParallelDecode: out of memory");
+    }
+    memcpy(out + written, decoded, decodedLength);
+    written += decodedLength;
+    offset += piece;
+  }
+  written += morseDecoderFinish(&decoder, out + written);
+  expectBytes("morseParallelDecode", expected, expectedLength, out, written);
+
+  free(out);
+  free(expected);
+}
+
+/* Decode up to MAX_CHANNELS rotations of morse side by side, channel c
+ * starting c / channelCount of the way in, in batches of random steps */
+static void checkChannels(const char *morse, size_t length, uint64_t seed) {
+  if (length == 0) {
+    return;
+  }
+  size_t most = CHANNEL_BUDGET / length;
+  most = most < 1 ? 1 : most > MAX_CHANNELS ? MAX_CHANNELS : most;
+  size_t channelCount = 1 + nextRandom(&seed) % most;
+  MorseChannels *channels = morseChannelsCreate(channelCount);
+  char *batch = allocate(length * channelCount);
+  char *out = allocate(MORSE_CHANNELS_STRIDE(length) * channelCount);
+  char *decoded[MAX_CHANNELS];
+  size_t written[MAX_CHANNELS];
+  if (!channels) {
+    fail("morseChannelsCreate: out of memory");
+  }
+  for (size_t c = 0; c < channelCount; c++) {
+    decoded[c] = allocate(MORSE_DECODER_FEED_BOUND(length) + 1);
+    written[c] = 0;
+  }
+
+  for (size_t offset = 0; offset < length;) {
+    size_t steps = nextPiece(&seed, length - offset);
+    // Odd strides on alternate batches, the minimum on the others
+    size_t stride = (offset & 1) ? MORSE_CHANNELS_STRIDE(steps)
+                                 : MORSE_CHANNELS_MIN_STRIDE(steps);
+    for (size_t s = 0; s < steps; s++) {
+      for (size_t c = 0; c < channelCount; c++) {
+        size_t start = length / channelCount * c;
+        batch[s * channelCount + c] = morse[(start + offset + s) % length];
+      }
+    }
+    morseChannelsDecode(channels, batch, steps, out, stride);
+    const size_t *lengths = morseChannelsLengths(channels);
+    for (size_t c = 0; c < channelCount; c++) {
+      memcpy(decoded[c] + written[c], out + c * stride, lengths[c]);
+      written[c] += lengths[c];
+    }
+    offset += steps;
+  }
+
+  char *rotated = allocate(length + 1);
+  for (size_t c = 0; c < channelCount; c++) {
+    written[c] += morseChannelsFinish(channels, c, decoded[c] + written[c]);
+    size_t start = length / channelCount * c;
+    memcpy(rotated, morse + start, length - start);
+    memcpy(rotated + length - start, morse, start);
+    rotated[length] = '\0';
+    size_t expectedLength;
+    char *expected = referenceDecode(rotated, &expectedLength);
+    expectBytes("morseChannelsDecode", expected, expectedLength, decoded[c],
+                written[c]);
+    free(expected);
+    free(decoded[c]);
+  }
+  free(rotated);
+  free(out);
+  free(batch);
+  morseChannelsDestroy(channels);
+}
+
+/* A table of the reference's alphabet must encode and decode as the
+ * reference does. Bytes above 0x7F are UTF-8 to the table's encoder but
+ * single unsupported bytes to the reference, so it encodes the input with
+ * those cleared to seven bits. */
+static void checkAlphabet(const char *text, size_t length, bool slash,
+                          uint64_t seed) {
+  static MorseAlphabet alphabet;
+  static char table[sizeof(MORSE_TABLE) / sizeof(MORSE_TABLE[0]) * 16];
+  static bool compiled;
+  if (!compiled) {
+    size_t tableLength = 0;
+    for (size_t i = 0; MORSE_TABLE[i].character != ' '; i++) {
+      tableLength += (size_t)sprintf(table + tableLength, "%c %s\n",
+                                     MORSE_TABLE[i].character,
+                                     MORSE_TABLE[i].code);
+    }
+    char error[MORSE_ALPHABET_ERROR_SIZE];
+    if (!morseAlphabetCompile(&alphabet, "reference", table, tableLength,
+                              error)) {
+      fprintf(stderr, "morseAlphabetCompile: %s\n", error);
+      fail("morseAlphabetCompile");
+    }
+    compiled = true;
+  }
+
+  size_t expectedLength;
+  char *expected = referenceDecode(text, &expectedLength);
+  char *out = allocate(MORSE_ALPHABET_ENCODE_BOUND(length) +
+                       MORSE_ALPHABET_FINISH_BOUND);
+  MorseAlphabetDecoder decoder;
+  morseAlphabetDecoderInit(&decoder, &alphabet);
+  size_t written = 0;
+  for (size_t offset = 0; offset < length;) {
+    size_t piece = nextPiece(&seed, length - offset);
+    written +=
+        morseAlphabetDecode(&decoder, text + offset, piece, out + written);
+    offset += piece;
+  }
+  written += morseAlphabetDecoderFinish(&decoder, out + written);
+  expectBytes("morseAlphabetDecode", expected, expectedLength, out, written);
+
+  // --stats: every character of the reference's text is a decoded symbol,
+  // and every other run of Morse symbol bytes a code without one
+  size_t symbols = 0;
+  for (size_t i = 0; i < expectedLength; i++) {
+    symbols += expected[i] != ' ';
+  }
+  size_t runs = 0;
+  bool inSymbol = false;
+  for (size_t i = 0; i < length; i++) {
+    if (text[i] != '\n' && text[i] != '\r') {
+      bool element = text[i] != ' ' && text[i] != '/';
+      runs += element && !inSymbol;
+      inSymbol = element;
+    }
+  }
+  expectSize("morseAlphabetDecoder symbols", symbols,
+             decoder.counts.symbols);
+  expectSize("morseAlphabetDecoder unknown codes", runs - symbols,
+             decoder.counts.unknown);
+  free(expected);
+
+  char *ascii = allocate(length + 1);
+  for (size_t i = 0; i < length; i++) {
+    ascii[i] = (char)(text[i] & 0x7F);
+    ascii[i] = ascii[i] == '\0' ? '\x01' : ascii[i];
+  }
+  ascii[length] = '\0';
+  expected = referenceEncode(ascii, slash, &expectedLength);
+  MorseAlphabetEncoder encoder;
+  morseAlphabetEncoderInit(&encoder, &alphabet, slash);
+  written = 0;
+  for (size_t offset = 0; offset < length;) {
+    size_t piece = nextPiece(&seed, length - offset);
+    written +=
+        morseAlphabetEncode(&encoder, ascii + offset, piece, out + written);
+    offset += piece;
+  }
+  written += morseAlphabetEncoderFinish(&encoder, out + written);
+  expectBytes("morseAlphabetEncode", expected, expectedLength, out, written);
+
+  // Each byte but space and CR/LF is a symbol, and each '*' one the table
+  // lacks
+  symbols = 0;
+  for (size_t i = 0; i < length; i++) {
+    symbols += ascii[i] != ' ' && ascii[i] != '\n' && ascii[i] != '\r';
+  }
+  size_t unsupported = 0;
+  for (size_t i = 0; i < expectedLength; i++) {
+    unsupported += expected[i] == '*';
+  }
+  expectSize("morseAlphabetEncoder symbols", symbols,
+             encoder.counts.symbols);
+  expectSize("morseAlphabetEncoder unsupported", unsupported,
+             encoder.counts.unknown);
+  free(expected);
+  free(ascii);
+  free(out);
+}
+
+/* The packed format must decode to what the text form decodes to */
+static void checkPacked(const char *text, size_t length, bool slash,
+                        uint64_t seed) {
+  size_t encodedLength;
+  char *encoded = referenceEncode(text, slash, &encodedLength);
+  size_t expectedLength;
+  char *expected = referenceDecode(encoded, &expectedLength);
+  size_t capacity = MORSE_ENCODE_BOUND(length);
+  char *packed = allocate(capacity);
+  char *out = allocate(length + 1);
+
+  MorseEncoder encoder;
+  morseEncoderInit(&encoder, slash);
+  size_t packedLength = 0;
+  for (size_t offset = 0; offset < length;) {
+    size_t piece = nextPiece(&seed, length - offset);
+    packedLength += morsePackedEncode(&encoder, text + offset, piece,
+                                      packed + packedLength);
+    offset += piece;
+  }
+  expectSize("morsePackedEncodedLength", packedLength,
+             morsePackedEncodedLength(text, length));
+  expectSize("morsePackedDecodedLength", expectedLength,
+             morsePackedDecodedLength(packed, packedLength));
+  size_t written = 0;
+  for (size_t offset = 0; offset < packedLength;) {
+    size_t piece = nextPiece(&seed, packedLength - offset);
+    written += morsePackedDecode(packed + offset, piece, out + written);
+    offset += piece;
+  }
+  expectBytes("morsePackedDecode", expected, expectedLength, out, written);
+
+  // Transcoding: the tokens are the reference's text, and its text goes to
+  // the same tokens and back byte for byte
+  char *transcoded = allocate(MORSE_PACKED_TEXT_BOUND(packedLength) + 1);
+  MorseTranscoder transcoder;
+  morseTranscoderInit(&transcoder, slash);
+  written = 0;
+  for (size_t offset = 0; offset < packedLength;) {
+    size_t piece = nextPiece(&seed, packedLength - offset);
+    written += morsePackedToText(&transcoder, packed + offset, piece,
+                                 transcoded + written);
+    offset += piece;
+  }
+  expectBytes("morsePackedToText", encoded, encodedLength, transcoded, written);
+
+  char *tokens = allocate(MORSE_PACKED_FEED_BOUND(encodedLength) +
+                          MORSE_PACKED_FINISH_BOUND);
+  morseTranscoderInit(&transcoder, slash);
+  size_t tokenCount = 0;
+  for (size_t offset = 0; offset < encodedLength;) {
+    size_t piece = nextPiece(&seed, encodedLength - offset);
+    tokenCount += morsePackedFromText(&transcoder, encoded + offset, piece,
+                                      tokens + tokenCount);
+    offset += piece;
+  }
+  tokenCount += morsePackedFromTextFinish(&transcoder, tokens + tokenCount);
+  if (transcoder.failed) {
+    fprintf(stderr, "morsePackedFromText: reference text refused at byte "
+                    "%zu\n",
+            transcoder.errorOffset);
+    fail("morsePackedFromText");
+  }
+  expectBytes("morsePackedFromText", packed, packedLength, tokens,
+              tokenCount);
+  morseTranscoderInit(&transcoder, slash);
+  written = morsePackedToText(&transcoder, tokens, tokenCount, transcoded);
+  expectBytes("morsePackedFromText round trip", encoded, encodedLength,
+              transcoded, written);
+  free(tokens);
+  free(transcoded);
+
+  // Through the API, header and detection included
+  unsigned int flags = MORSE_PACKED | (slash ? MORSE_SLASH_WORDSPACER : 0);
+  packedLength = morseEncode(text, length, packed, capacity, flags);
+  expectSize("morseEncode packed size", packedLength,
+             morseEncode(text, length, NULL, 0, flags));
+  written = morseDecode(packed, packedLength, out, length + 1, 0);
+  expectBytes("morseDecode packed", expected, expectedLength, out, written);
+
+  free(out);
+  free(packed);
+  free(expected);
+  free(encoded);
+}
+
+static void collectOffset(void *context, size_t offset) {
+  OffsetList *list = context;
+  if (list->count == list->capacity) {
+    list->capacity = list->capacity ? list->capacity * 2 : 16;
+    list->offsets = realloc(list->offsets, list->capacity * sizeof(size_t));
+    if (!list->offsets) {
+      fail("strict offsets: out of memory");
+    }
+  }
+  list->offsets[list->count++] = offset;
+}
+
+static void expectBytes(const char *engine, const char *expected,
+                        size_t expectedLength, const char *actual,
+                        size_t actualLength) {
+  size_t common = expectedLength < actualLength ? expectedLength : actualLength;
+  size_t i = 0;
+  while (i < common && expected[i] == actual[i]) {
+    i++;
+  }
+  if (i < common || expectedLength != actualLength) {
+    fprintf(stderr, "%s: %zu bytes where the reference has %zu, first "
+                    "difference at byte %zu\n",
+            engine, actualLength, expectedLength, i);
+    fail(engine);
+  }
+}
+
+static void expectSize(const char *engine, size_t expected, size_t actual) {
+  if (expected != actual) {
+    fprintf(stderr, "%s: %zu where the reference has %zu\n", engine, actual,
+            expected);
+    fail(engine);
+  }
+}
+
+/* Report the input that broke engine and abort, which the fuzzers record
+ * as a crash */
+static void fail(const char *engine) {
+  fprintf(stderr, "morse_fuzz: %s differs on an input of %zu bytes\n",
+          engine, currentLength);
+  if (saveFailures) {
+    FILE *file = fopen(FAILURE_PATH, "wb");
+    if (file && fwrite(currentInput, 1, currentLength, file) ==
+                    currentLength) {
+      fprintf(stderr, "morse_fuzz: input saved to %s\n", FAILURE_PATH);
+    }
+    if (file) {
+      fclose(file);
+    }
+  }
+  abort();
+}
+
+/* Length of the next piece of a random split: single bytes, short
+ * packets, SIMD-block multiples or everything that is left */
+static size_t nextPiece(uint64_t *seed, size_t remaining) {
+  uint64_t r = nextRandom(seed);
+  size_t piece;
+  switch (r % 4) {
+  case 0:
+    piece = 1 + (size_t)(r >> 8) % 8;
+    break;
+  case 1:
+    piece = 1 + (size_t)(r >> 8) % 200;
+    break;
+  case 2:
+    piece = 64 * (1 + (size_t)(r >> 8) % 4);
+    break;
+  default:
+    piece = remaining;
+    break;
+  }
+  return piece < remaining ? piece : remaining;
+}
+
+static uint64_t nextRandom(uint64_t *seed) {
+  *seed ^= *seed << 13;
+  *seed ^= *seed >> 7;
+  *seed ^= *seed << 17;
+  return *seed;
+}
+
+/* malloc() that fails the run, and starts the worker pool on first use */
+static void *allocate(size_t size) {
+  if (!parallel) {
+    parallel = morseParallelCreate(FUZZ_THREADS);
+  }
+  void *memory = malloc(size > 0 ? size : 1);
+  if (!memory || !parallel) {
+    fail("out of memory");
+  }
+  return memory;
+}
@@ -0,0 +1,179 @@
+/**
+ * @file morse_alphabet.h
+ * @brief Code tables other than the built-in alphabet, with UTF-8 text
+ * @author Diego Rubio Carrera
+ *
+ * An alphabet is compiled from a table of lines "SYMBOL CODE": a symbol
+ * is one UTF-8 character or a prosign such as <SK>, its code 1 to
+ * MORSE_ALPHABET_MAX_CODE_LENGTH dots and dashes. Compiling fills the
+ * same two direct-indexed tables the built-in codec uses: code point ->
+ * code for encoding, and a binary trie indexed by MORSE_DECODE_INDEX ->
+ * text for decoding. Every lookup is O(1), whichever table is loaded.
+ *
+ * The tables in tables/ are compiled by the build, with this same
+ * compiler, into constant MorseAlphabets in morse_tables.c; only a table
+ * loaded from a file is compiled at run time.
+ *
+ * The encoder reads text as UTF-8, one byte at a time, so a character may
+ * be split across calls like any other input. Letters encode in either
+ * case and decode as they are listed.
+ */
+
+// ReqNonFunc08: Include guard compatible with MinGW and GNU-C
+#ifndef MORSE_ALPHABET_H
+#define MORSE_ALPHABET_H
+
+#include <morse_codec.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+/** Longest code of a table */
+#define MORSE_ALPHABET_MAX_CODE_LENGTH 10
+
+/** Entries of the decode trie: one per code, plus the marker bit */
+#define MORSE_ALPHABET_DECODE_SIZE (1 << (MORSE_ALPHABET_MAX_CODE_LENGTH + 1))
+
+/** Code points a table may list: those of one- and two-byte UTF-8, which
+ * covers Latin, Greek, Cyrillic, Hebrew and Arabic letters */
+#define MORSE_ALPHABET_CODE_POINTS 0x800
+
+/** Longest prosign name, between '<' and '>' */
+#define MORSE_ALPHABET_MAX_PROSIGN 6
+
+/** Most prosigns of a table, and the slots they are hashed into */
+#define MORSE_ALPHABET_MAX_PROSIGNS 32
+#define MORSE_ALPHABET_PROSIGN_SLOTS 64
+
+/** Longest text a code decodes to: a prosign with its brackets */
+#define MORSE_ALPHABET_MAX_TEXT (MORSE_ALPHABET_MAX_PROSIGN + 2)
+
+/** Largest table text; strings are 16-bit offsets into it */
+#define MORSE_ALPHABET_MAX_TABLE_SIZE 65535
+
+/** Input bytes the encoder may hold back: a prosign up to its '>' */
+#define MORSE_ALPHABET_HELD (MORSE_ALPHABET_MAX_PROSIGN + 1)
+
+/** Output bytes morseAlphabetEncode() may write for length input bytes,
+ * held bytes included */
+#define MORSE_ALPHABET_ENCODE_BOUND(length)                                    \
+  (((length) + MORSE_ALPHABET_HELD) * (MORSE_ALPHABET_MAX_CODE_LENGTH + 1))
+
+/** Output bytes morseAlphabetDecode() may write for length input bytes */
+#define MORSE_ALPHABET_DECODE_BOUND(length)                                    \
+  (((length) + 1) * MORSE_ALPHABET_MAX_TEXT)
+
+/** Output bytes the finish calls may write */
+#define MORSE_ALPHABET_FINISH_BOUND MORSE_ALPHABET_ENCODE_BOUND(0)
+
+/** Size of the message morseAlphabetCompile() writes on failure */
+#define MORSE_ALPHABET_ERROR_SIZE 128
+
+/** Bytes of a table's text, length 0 = none */
+typedef struct {
+  unsigned short offset;
+  unsigned char length;
+} MorseAlphabetString;
+
+/** Hash slot of a prosign */
+typedef struct {
+  MorseAlphabetString name; ///< "<SK>", as listed
+  MorseAlphabetString code;
+} MorseProsign;
+
+/** Compiled table; every string points into the table's text */
+typedef struct {
+  const char *name;
+  const char *strings; ///< the table text
+  bool hasProsigns;    ///< '<' in text starts a prosign
+  MorseAlphabetString encode[MORSE_ALPHABET_CODE_POINTS]; ///< -> code
+  MorseAlphabetString decode[MORSE_ALPHABET_DECODE_SIZE]; ///< -> text
+  MorseProsign prosigns[MORSE_ALPHABET_PROSIGN_SLOTS];
+} MorseAlphabet;
+
+/** Symbols a codec has converted, for --stats; the caller may read and
+ * reset them, finishing keeps them. A symbol is a character or prosign of
+ * the text, however many bytes it has. */
+typedef struct {
+  size_t symbols; ///< encoded, '*' included, or decoded to text
+  size_t unknown; ///< encoded as '*', or codes the table has no text for
+} MorseAlphabetCounts;
+
+/** Encoder context; fields are private to morse_alphabet.c but counts */
+typedef struct {
+  const MorseAlphabet *alphabet;
+  MorseEncoder spacing; ///< word spacer and separator state
+  unsigned long codePoint; ///< of the UTF-8 sequence being read
+  unsigned char remaining; ///< continuation bytes it still needs
+  unsigned char sequenceLength;
+  char held[MORSE_ALPHABET_HELD]; ///< '<' and the name read so far
+  unsigned char heldLength;
+  MorseAlphabetCounts counts;
+} MorseAlphabetEncoder;
+
+/** Decoder context, as MorseDecoder; fields are private but counts */
+typedef struct {
+  const MorseAlphabet *alphabet;
+  unsigned int code;
+  unsigned int codeLength;
+  int spaceCount;
+  MorseAlphabetCounts counts;
+} MorseAlphabetDecoder;
+
+/** The tables compiled into the build, "itu" and "extended", NULL-ended
+ * (in the generated morse_tables.c) */
+extern const MorseAlphabet *const MORSE_BUILTIN_ALPHABETS[];
+
+/**
+ * Compile a table. Blank lines and lines starting with '#' are skipped. A
+ * symbol may be listed once; a code listed again encodes the new symbol
+ * but still decodes to the first one. A listed letter adds its other
+ * case unless that is listed too.
+ * @param text the table, which must outlive alphabet
+ * @param error receives MORSE_ALPHABET_ERROR_SIZE bytes on failure
+ * @return false if the table is malformed
+ */
+bool morseAlphabetCompile(MorseAlphabet *alphabet, const char *name,
+                          const char *text, size_t length, char *error);
+
+/** Start encoding a new text with alphabet - ReqOptFunc02 */
+void morseAlphabetEncoderInit(MorseAlphabetEncoder *encoder,
+                              const MorseAlphabet *alphabet,
+                              bool useSlashWordspacer);
+
+/**
+ * Encode the next length bytes of UTF-8 text. Separators are those of
+ * morseEncoderFeed(); a character the table lacks, and a malformed UTF-8
+ * sequence, encode as one '*'.
+ * @param out receives MORSE_ALPHABET_ENCODE_BOUND(length) bytes at most
+ * @return number of bytes written to out
+ */
+size_t morseAlphabetEncode(MorseAlphabetEncoder *encoder, const char *text,
+                           size_t length, char *out);
+
+/**
+ * Encode what is held back at the end of the text and start over.
+ * @param out receives MORSE_ALPHABET_FINISH_BOUND bytes at most
+ * @return number of bytes written to out
+ */
+size_t morseAlphabetEncoderFinish(MorseAlphabetEncoder *encoder, char *out);
+
+/** Start decoding a new Morse text with alphabet */
+void morseAlphabetDecoderInit(MorseAlphabetDecoder *decoder,
+                              const MorseAlphabet *alphabet);
+
+/**
+ * Decode the next length bytes of Morse code, as morseDecoderFeed() does.
+ * @param out receives MORSE_ALPHABET_DECODE_BOUND(length) bytes at most
+ * @return number of bytes written to out
+ */
+size_t morseAlphabetDecode(MorseAlphabetDecoder *decoder, const char *morse,
+                           size_t length, char *out);
+
+/**
+ * Flush the pending symbol and start over.
+ * @param out receives MORSE_ALPHABET_MAX_TEXT bytes at most
+ * @return number of bytes written to out
+ */
+size_t morseAlphabetDecoderFinish(MorseAlphabetDecoder *decoder, char *out);
+
+#endif // MORSE_ALPHABET_H
@@ -0,0 +1,75 @@
+/**
+ * @file morse_arena.h
+ * @brief Bump allocator for per-job memory
+ * @author Diego Rubio Carrera
+ *
+ * Everything a job allocates - options, results, error messages and
+ * conversion buffers - comes from one arena and is released together by
+ * rewinding it, in O(1) and without touching the heap. Blocks are kept
+ * after a rewind, so a batch of similar jobs reaches a steady state in
+ * which it does not call malloc() at all.
+ */
+
+// ReqNonFunc08: Include guard compatible with MinGW and GNU-C
+#ifndef MORSE_ARENA_H
+#define MORSE_ARENA_H
+
+#include <stdarg.h>
+#include <stddef.h>
+
+/** Default size of an arena block; larger allocations get their own */
+#define MORSE_ARENA_BLOCK_SIZE (64 * 1024)
+
+/** Memory block of an arena, followed by its data */
+typedef struct MorseArenaBlock {
+  struct MorseArenaBlock *next;
+  size_t capacity; ///< data bytes after the header
+  size_t used;     ///< data bytes handed out
+} MorseArenaBlock;
+
+/** Arena context; fields are private to morse_arena.c */
+typedef struct {
+  MorseArenaBlock *first;
+  MorseArenaBlock *current; ///< block allocations come from, NULL = none yet
+  size_t blockSize;
+} MorseArena;
+
+/** Position to rewind an arena to */
+typedef struct {
+  MorseArenaBlock *block;
+  size_t used;
+} MorseArenaMark;
+
+/** Start an empty arena; the first block is allocated on first use */
+void morseArenaInit(MorseArena *arena, size_t blockSize);
+
+/** Release all blocks */
+void morseArenaDestroy(MorseArena *arena);
+
+/**
+ * Allocate size bytes aligned for any type.
+ * @return the memory, or NULL if out of memory
+ */
+void *morseArenaAlloc(MorseArena *arena, size_t size);
+
+/** Copy a NUL-terminated string into the arena; NULL if out of memory */
+char *morseArenaStrdup(MorseArena *arena, const char *text);
+
+/** printf() into the arena; NULL if out of memory */
+char *morseArenaPrintf(MorseArena *arena, const char *format, ...)
+    __attribute__((format(printf, 2, 3)));
+
+/** vprintf() into the arena; NULL if out of memory */
+char *morseArenaVprintf(MorseArena *arena, const char *format,
+                        va_list arguments);
+
+/** Current position, for morseArenaRewind() */
+MorseArenaMark morseArenaMark(const MorseArena *arena);
+
+/** Release everything allocated since mark, in O(1) */
+void morseArenaRewind(MorseArena *arena, MorseArenaMark mark);
+
+/** Release everything allocated so far, in O(1) */
+void morseArenaReset(MorseArena *arena);
+
+#endif // MORSE_ARENA_H
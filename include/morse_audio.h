@@ -0,0 +1,110 @@
+/**
+ * @file morse_audio.h
+ * @brief Audio and keying output of encoded Morse code
+ * @author Diego Rubio Carrera
+ *
+ * The encoder's dots, dashes and gaps are played out with PARIS timing:
+ * a dot is one unit of 1.2 / WPM seconds, a dash three, and the gaps
+ * between elements, letters and words one, three and seven units.
+ *
+ * WAV output is 16-bit PCM with the same signal on every channel. A dot
+ * and a dash are synthesized once, as ramped tone bursts already
+ * interleaved for all channels, so the samples of a message are only
+ * copies of those two buffers and zeroed silence, never computed per
+ * sample. Keying output is the same timeline as text: one line
+ * "<microseconds> down" or "<microseconds> up" per key transition.
+ */
+
+// ReqNonFunc08: Include guard compatible with MinGW and GNU-C
+#ifndef MORSE_AUDIO_H
+#define MORSE_AUDIO_H
+
+#include <morse_output.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+/** Output bytes collected before they are handed to the writer; larger
+ * than its buffer, so every full block goes out by writev(2) uncopied */
+#define MORSE_AUDIO_BLOCK_SIZE (2 * MORSE_WRITER_BUFFER_SIZE)
+
+/** Size of the WAV header in front of the samples */
+#define MORSE_AUDIO_WAV_HEADER_SIZE 44
+
+/** Limits and defaults of MorseAudioConfig */
+#define MORSE_AUDIO_MIN_WPM 5
+#define MORSE_AUDIO_MAX_WPM 100
+#define MORSE_AUDIO_DEFAULT_WPM 20
+#define MORSE_AUDIO_MIN_TONE 100
+#define MORSE_AUDIO_DEFAULT_TONE 700
+#define MORSE_AUDIO_MIN_SAMPLE_RATE 8000
+#define MORSE_AUDIO_MAX_SAMPLE_RATE 192000
+#define MORSE_AUDIO_DEFAULT_SAMPLE_RATE 48000
+#define MORSE_AUDIO_MAX_CHANNELS 64
+
+/** What the timeline is written as */
+typedef enum {
+  MORSE_AUDIO_NONE,  ///< no audio, the Morse text itself
+  MORSE_AUDIO_WAV,   ///< 16-bit PCM WAV
+  MORSE_AUDIO_KEYING ///< key transitions, one per line
+} MorseAudioFormat;
+
+/** Timing and signal; keying output uses wpm only */
+typedef struct {
+  unsigned int wpm;        ///< PARIS words per minute
+  unsigned int tone;       ///< Hz, below half the sample rate
+  unsigned int sampleRate; ///< Hz
+  unsigned int channels;   ///< 1 to MORSE_AUDIO_MAX_CHANNELS
+} MorseAudioConfig;
+
+/** Output state; fields are private to morse_audio.c */
+typedef struct {
+  MorseAudioFormat format;
+  MorseAudioConfig config;
+  MorseWriter *writer;
+  char *dot;               ///< ramped tone of one unit, all channels
+  char *dash;              ///< ramped tone of three units
+  size_t unitBytes;        ///< bytes of one unit of samples
+  char *block;             ///< MORSE_AUDIO_BLOCK_SIZE bytes
+  size_t used;             ///< bytes in block
+  long long headerOffset;  ///< file offset of the WAV header, -1 if unknown
+  unsigned long long dataBytes; ///< samples written, in bytes
+  unsigned long long units;     ///< timeline position, in units
+  unsigned int gap;        ///< units of silence owed before the next tone
+  unsigned int spaces;     ///< spaces seen since the last symbol
+  bool inSymbol;           ///< the last element was a dot or a dash
+  bool started;            ///< a tone has been played
+} MorseAudio;
+
+/** Fill config with the defaults: 20 WPM, 700 Hz, 48 kHz, one channel */
+void morseAudioDefaults(MorseAudioConfig *config);
+
+/**
+ * Start an output on writer, with nothing written to it yet; WAV output
+ * writes its header now. A header written to a regular file gets its
+ * sizes when the output is finished, else they are left at their maximum,
+ * as in any streamed WAV.
+ * @return false with errno set if out of memory or the header could not
+ * be written
+ */
+bool morseAudioInit(MorseAudio *audio, MorseAudioFormat format,
+                    const MorseAudioConfig *config, MorseWriter *writer);
+
+/**
+ * Play out the next length bytes of encoded Morse code, text format. The
+ * timeline carries from one call to the next, so the code may be split
+ * anywhere.
+ * @return false with errno set on a write error
+ */
+bool morseAudioFeed(MorseAudio *audio, const char *morse, size_t length);
+
+/**
+ * End the timeline and hand everything to the writer, which stays open;
+ * a WAV header in a regular file is completed.
+ * @return false with errno set on a write error
+ */
+bool morseAudioFinish(MorseAudio *audio);
+
+/** Release the tone and block buffers */
+void morseAudioDestroy(MorseAudio *audio);
+
+#endif // MORSE_AUDIO_H
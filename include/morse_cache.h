@@ -0,0 +1,163 @@
+/**
+ * @file morse_cache.h
+ * @brief Content-addressed cache of converted results, for --cache
+ * @author Diego Rubio Carrera
+ *
+ * A result is found by a key: the XXH64 hash of the input, seeded with
+ * everything else the output depends on - the operation, the word spacer,
+ * the packed format and the code table. Equal inputs converted the same
+ * way share one entry, whichever file or request they came from.
+ *
+ * MorseCache keeps one file per key in a directory, shared by every run
+ * that uses it; a hit is copied to the output with sendfile(2) and never
+ * touches the codec. A hit refreshes the file's modification time, and
+ * when the directory grows past its limit the least recently used files
+ * are removed. MorseMemoryCache is the same for --serve, kept in memory
+ * as an LRU list. Both may be used by several threads at once.
+ */
+
+// ReqNonFunc08: Include guard compatible with MinGW and GNU-C
+#ifndef MORSE_CACHE_H
+#define MORSE_CACHE_H
+
+#include <morse_output.h>
+#include <morse_stats.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/** Limit of a cache without --cache-size */
+#define MORSE_CACHE_DEFAULT_SIZE (256 * 1024 * 1024)
+
+/** morseCacheKey() mode flags */
+#define MORSE_CACHE_DECODE 0x1
+#define MORSE_CACHE_SLASH 0x2  ///< --slash-wordspacer
+#define MORSE_CACHE_PACKED 0x4 ///< --format=packed
+#define MORSE_CACHE_TRANSCODE 0x8 ///< --transcode
+
+/** Longest path of a cache entry being written, see MorseCacheEntry */
+#define MORSE_CACHE_MAX_PATH 4096
+
+/** Cache directory; fields are private to morse_cache.c */
+typedef struct MorseCache MorseCache;
+
+/** Cache in memory; fields are private to morse_cache.c */
+typedef struct MorseMemoryCache MorseMemoryCache;
+
+/** A result being stored, written to a temporary file of the directory
+ * and renamed to its key once complete */
+typedef struct {
+  MorseCache *cache;
+  uint64_t key;
+  int fd;        ///< -1 once anything failed: nothing is stored
+  size_t length; ///< bytes written so far
+  char path[MORSE_CACHE_MAX_PATH];
+} MorseCacheEntry;
+
+/** XXH64 of length bytes at data */
+uint64_t morseHash64(const void *data, size_t length, uint64_t seed);
+
+/**
+ * Key of a conversion.
+ * @param mode MORSE_CACHE_DECODE, MORSE_CACHE_SLASH, MORSE_CACHE_PACKED and
+ * MORSE_CACHE_TRANSCODE
+ * @param table hash of the --table text, 0 for the built-in alphabet
+ */
+uint64_t morseCacheKey(const char *input, size_t length, unsigned int mode,
+                       uint64_t table);
+
+/**
+ * Use directory path, which is created if it does not exist, as a cache
+ * of at most limit bytes; if the files in it take more, the oldest are
+ * removed now.
+ * @return the cache, or NULL with errno set
+ */
+MorseCache *morseCacheOpen(const char *path, size_t limit);
+
+/** Stop using the cache; the directory stays */
+void morseCacheClose(MorseCache *cache);
+
+/**
+ * Look key up, counting a hit or a miss.
+ * @param size receives the length of the result on a hit
+ * @return a read-only descriptor of the result, or -1 on a miss
+ */
+int morseCacheLookup(MorseCache *cache, uint64_t key, size_t *size);
+
+/**
+ * Copy size bytes of a result to the output after what writer holds:
+ * sendfile(2) straight to its descriptor, or through the writer if that
+ * is not possible. Closes fd.
+ * @param direct the writer bypasses the page cache, see
+ *        MORSE_WRITER_DIRECT; its descriptor cannot be written directly
+ * @return false with errno set on a read or write error
+ */
+bool morseCacheSend(int fd, size_t size, MorseWriter *writer, bool direct);
+
+/**
+ * Map a result of morseCacheLookup() into memory and close fd.
+ * @return the mapping, size bytes long, or NULL if it cannot be mapped
+ */
+const char *morseCacheMap(int fd, size_t size);
+
+/** Unmap a result of morseCacheMap() */
+void morseCacheUnmap(const char *data, size_t size);
+
+/**
+ * Start storing the result of key; entry->fd is -1 if it cannot be
+ * stored, which makes the other entry calls do nothing.
+ */
+void morseCacheBegin(MorseCache *cache, uint64_t key, MorseCacheEntry *entry);
+
+/** Add the next length bytes of the result */
+void morseCacheAppend(MorseCacheEntry *entry, const char *data,
+                      size_t length);
+
+/**
+ * Complete the entry and make it visible to lookups, removing the least
+ * recently used entries if the cache is now over its limit. A result
+ * larger than the limit is not stored.
+ */
+void morseCacheCommit(MorseCacheEntry *entry);
+
+/** Drop the entry: the conversion failed */
+void morseCacheAbort(MorseCacheEntry *entry);
+
+/** Store a whole result held in memory */
+void morseCacheStore(MorseCache *cache, uint64_t key, const char *data,
+                     size_t length);
+
+/** Set the cache counters of stats: hits, misses, size and limit */
+void morseCacheReport(MorseCache *cache, MorseStats *stats);
+
+/**
+ * Start an empty cache of at most limit bytes of results.
+ * @return the cache, or NULL if out of memory
+ */
+MorseMemoryCache *morseMemoryCacheCreate(size_t limit);
+
+/** Release the cache and every result in it */
+void morseMemoryCacheDestroy(MorseMemoryCache *cache);
+
+/**
+ * Look key up. On a hit the result is copied to out if it fits in
+ * capacity bytes, and only then counted as a hit and made the most
+ * recently used.
+ * @param length receives the length of the result on a hit
+ * @return false on a miss, which is counted
+ */
+bool morseMemoryCacheGet(MorseMemoryCache *cache, uint64_t key, char *out,
+                         size_t capacity, size_t *length);
+
+/**
+ * Store a copy of a result, removing the least recently used ones while
+ * the cache is over its limit. A result larger than the limit, or one
+ * already stored, is left out.
+ */
+void morseMemoryCachePut(MorseMemoryCache *cache, uint64_t key,
+                         const char *data, size_t length);
+
+/** Set the cache counters of stats, see morseCacheReport() */
+void morseMemoryCacheReport(MorseMemoryCache *cache, MorseStats *stats);
+
+#endif // MORSE_CACHE_H
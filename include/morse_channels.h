@@ -0,0 +1,74 @@
+/**
+ * @file morse_channels.h
+ * @brief Batched decoding of many Morse code streams at once
+ * @author Diego Rubio Carrera
+ *
+ * A receiver monitoring thousands of streams hands over one interleaved
+ * batch: step s of channel c is byte s * channelCount + c. The decoder
+ * states are kept as arrays, one per field with an entry per channel:
+ * the pending symbol, the spaces after it and the output cursor, so one
+ * step of every channel reads a contiguous row of input and a contiguous
+ * run of each field. The state change of a row has no branches and is
+ * vectorized by the compiler; only the output of each channel goes to its
+ * own place. Channels are advanced in tiles as wide as a cache line of
+ * input, every step of a tile at a time, so each input line is read once
+ * and the tile's state and output stay in cache.
+ *
+ * Every channel decodes exactly as its own MorseDecoder would.
+ */
+
+// ReqNonFunc08: Include guard compatible with MinGW and GNU-C
+#ifndef MORSE_CHANNELS_H
+#define MORSE_CHANNELS_H
+
+#include <stddef.h>
+
+/** Bytes of output each channel needs for a batch of steps: a decoder's
+ * MORSE_DECODER_FEED_BOUND(steps), plus one the stores may run over */
+#define MORSE_CHANNELS_MIN_STRIDE(steps) ((steps) + 2)
+
+/** MORSE_CHANNELS_MIN_STRIDE(steps) rounded up to an odd number of 64-byte
+ * cache lines, so the outputs of neighbouring channels fall in different
+ * cache sets; a stride near a multiple of 4 KiB is several times slower */
+#define MORSE_CHANNELS_STRIDE(steps)                                           \
+  (((MORSE_CHANNELS_MIN_STRIDE(steps) + 63) & ~(size_t)63) | 64)
+
+/** Decoder states of a fixed number of channels */
+typedef struct MorseChannels MorseChannels;
+
+/**
+ * Start channelCount channels, each at the start of a text.
+ * @return the channels, or NULL if out of memory
+ */
+MorseChannels *morseChannelsCreate(size_t channelCount);
+
+/** Release the channels */
+void morseChannelsDestroy(MorseChannels *channels);
+
+/**
+ * Decode the next steps bytes of every channel. Each channel carries its
+ * state from one batch to the next, so its stream may be split anywhere.
+ * @param batch steps rows of one byte per channel
+ * @param out receives channel c's output at out + c * stride
+ * @param stride at least MORSE_CHANNELS_MIN_STRIDE(steps); best
+ *        MORSE_CHANNELS_STRIDE(steps)
+ */
+void morseChannelsDecode(MorseChannels *channels, const char *batch,
+                         size_t steps, char *out, size_t stride);
+
+/**
+ * Bytes each channel wrote in the last morseChannelsDecode(); valid until
+ * the next call.
+ */
+const size_t *morseChannelsLengths(const MorseChannels *channels);
+
+/**
+ * End the stream of one channel: flush its pending symbol and start it
+ * over, as morseDecoderFinish() does. The other channels go on.
+ * @param out receives 1 byte at most
+ * @return number of bytes written to out
+ */
+size_t morseChannelsFinish(MorseChannels *channels, size_t channel,
+                           char *out);
+
+#endif // MORSE_CHANNELS_H
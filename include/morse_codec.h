@@ -0,0 +1,166 @@
+/**
+ * @file morse_codec.h
+ * @brief Incremental Morse code encoder and decoder
+ * @author Diego Rubio Carrera
+ *
+ * The encoder and decoder keep all of their state in a small context, so
+ * input can be fed in pieces of any size (e.g. as network packets arrive)
+ * and the output is identical to converting the whole input at once.
+ */
+
+// ReqNonFunc08: Include guard compatible with MinGW and GNU-C
+#ifndef MORSE_CODEC_H
+#define MORSE_CODEC_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+/** Longest code in the table; longer symbols can never decode */
+#define MORSE_MAX_CODE_LENGTH 6
+
+/** Worst-case encoded bytes per input byte: separator plus longest code */
+#define MORSE_MAX_ENCODED_PER_CHAR (MORSE_MAX_CODE_LENGTH + 1)
+
+/** Output bytes morseEncoderFeed() may write for length input bytes */
+#define MORSE_ENCODER_FEED_BOUND(length)                                       \
+  ((length) * MORSE_MAX_ENCODED_PER_CHAR)
+
+/** Output bytes morseDecoderFeed() may write for length input bytes (a slash
+ * may complete a symbol fed earlier) */
+#define MORSE_DECODER_FEED_BOUND(length) ((length) + 1)
+
+/** Output bytes the finish calls may write */
+#define MORSE_FINISH_BOUND 1
+
+/** Encoder context - ReqFunc25-28, ReqOptFunc02 */
+typedef struct {
+  bool useSlashWordspacer; ///< " / " instead of triple space between words
+  bool lastWasSpace;       ///< last non-CR/LF byte was a space
+  bool firstChar;          ///< no symbol has been emitted yet
+} MorseEncoder;
+
+/**
+ * Told about a symbol the decoder drops: a byte other than a dot or dash,
+ * more than MORSE_MAX_CODE_LENGTH elements, or a code not in the table.
+ * @param offset of the symbol's first byte, counted from the last
+ * morseDecoderInit() or morseDecoderFinish()
+ */
+typedef void (*MorseMalformedHandler)(void *context, size_t offset);
+
+/** Decoder context - ReqFunc14-24, ReqFunc28 */
+typedef struct {
+  unsigned int code; ///< pending symbol, bit i set when element i is a dash
+  size_t codeLength; ///< elements in the pending symbol, 0 = none pending
+  int spaceCount;    ///< spaces since the last symbol element
+  size_t offset;      ///< bytes fed since the decoder was reset
+  size_t symbolStart; ///< offset of the pending symbol's first byte
+  MorseMalformedHandler malformed; ///< strict decoding, or NULL
+  void *malformedContext;
+} MorseDecoder;
+
+/** Reset an encoder to the start of a new text */
+void morseEncoderInit(MorseEncoder *encoder, bool useSlashWordspacer);
+
+/**
+ * Encode the next length bytes of text.
+ * @param out receives MORSE_ENCODER_FEED_BOUND(length) bytes at most
+ * @return number of bytes written to out (not NUL-terminated)
+ */
+size_t morseEncoderFeed(MorseEncoder *encoder, const char *text,
+                        size_t length, char *out);
+
+/**
+ * Advance the encoder over text exactly like morseEncoderFeed(), without
+ * writing any output.
+ * @return number of bytes morseEncoderFeed() would have written
+ */
+size_t morseEncoderMeasure(MorseEncoder *encoder, const char *text,
+                           size_t length);
+
+/** Byte-by-byte reference for morseEncoderMeasure() */
+size_t morseEncoderMeasureScalar(MorseEncoder *encoder, const char *text,
+                                 size_t length);
+
+/**
+ * Exact size of the encoding of a whole text, for sizing the output buffer
+ * of morseEncoderFeed(). Both word spacers are three bytes, so the size
+ * does not depend on the encoder's setting.
+ * @return number of bytes encoding text produces, excluding any NUL
+ */
+size_t morseEncodedLength(const char *text, size_t length);
+
+/**
+ * End the text and reset the encoder. The encoder never holds back output,
+ * so nothing is written today; callers should still provide
+ * MORSE_FINISH_BOUND bytes.
+ * @return number of bytes written to out
+ */
+size_t morseEncoderFinish(MorseEncoder *encoder, char *out);
+
+/** Instruction sets the decoder can classify input bytes with */
+typedef enum {
+  MORSE_KERNEL_SCALAR, ///< byte-by-byte reference decoder
+  MORSE_KERNEL_SSE2,   ///< 4 x 16 bytes per block (x86)
+  MORSE_KERNEL_AVX2,   ///< 2 x 32 bytes per block (x86)
+  MORSE_KERNEL_NEON,   ///< 4 x 16 bytes per block (AArch64)
+  MORSE_KERNEL_AVX512  ///< 1 x 64 bytes per block straight into masks (x86)
+} MorseKernel;
+
+/** Fastest kernel the running CPU supports, detected on the first call */
+MorseKernel morseBestKernel(void);
+
+/**
+ * morseEncoderFeed() with a chosen kernel; a kernel the CPU (or build) does
+ * not support runs as MORSE_KERNEL_SCALAR, the byte-by-byte encoder.
+ */
+size_t morseEncoderFeedKernel(MorseEncoder *encoder, MorseKernel kernel,
+                              const char *text, size_t length, char *out);
+
+/** Reset a decoder to the start of a new Morse text, decoding leniently:
+ * undecodable symbols are dropped without notice */
+void morseDecoderInit(MorseDecoder *decoder);
+
+/**
+ * Decode strictly: every undecodable symbol is still dropped, and reported
+ * to handler while it is being dropped, so validating costs nothing while
+ * the input is well-formed. Kept across morseDecoderFinish().
+ * @param handler NULL to decode leniently again
+ */
+void morseDecoderSetStrict(MorseDecoder *decoder,
+                           MorseMalformedHandler handler, void *context);
+
+/**
+ * Decode the next length bytes of Morse code.
+ * @param out receives MORSE_DECODER_FEED_BOUND(length) bytes at most
+ * @return number of bytes written to out (not NUL-terminated)
+ */
+size_t morseDecoderFeed(MorseDecoder *decoder, const char *morse,
+                        size_t length, char *out);
+
+/**
+ * morseDecoderFeed() with a chosen kernel; a kernel the CPU (or build) does
+ * not support runs as MORSE_KERNEL_SCALAR.
+ */
+size_t morseDecoderFeedKernel(MorseDecoder *decoder, MorseKernel kernel,
+                              const char *morse, size_t length, char *out);
+
+/** Byte-by-byte reference decoder, the fallback for every SIMD kernel */
+size_t morseDecoderFeedScalar(MorseDecoder *decoder, const char *morse,
+                              size_t length, char *out);
+
+/**
+ * Exact size of the decoding of a whole Morse text, including what
+ * morseDecoderFinish() flushes.
+ * @return number of bytes decoding morse produces, excluding any NUL
+ */
+size_t morseDecodedLength(const char *morse, size_t length);
+
+/**
+ * Flush the symbol still pending at the end of input and reset the decoder
+ * to a new text, keeping its strict handler.
+ * @param out receives MORSE_FINISH_BOUND bytes at most
+ * @return number of bytes written to out
+ */
+size_t morseDecoderFinish(MorseDecoder *decoder, char *out);
+
+#endif // MORSE_CODEC_H
@@ -0,0 +1,106 @@
+/**
+ * @file morse_output.h
+ * @brief Buffered output writer for converted text
+ * @author Diego Rubio Carrera
+ *
+ * Output is collected in one large page-aligned buffer and written with
+ * writev(2), so a banner, the payload and a trailing newline reach the
+ * file descriptor in one system call without being concatenated first.
+ * Pipes and terminals get every write at once, so downstream tools see
+ * output as soon as it is converted; regular files are written a full
+ * buffer at a time.
+ */
+
+// ReqNonFunc08: Include guard compatible with MinGW and GNU-C
+#ifndef MORSE_OUTPUT_H
+#define MORSE_OUTPUT_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+/** Size of the writer's buffer, a multiple of any O_DIRECT block size */
+#define MORSE_WRITER_BUFFER_SIZE (1024 * 1024)
+
+/** morseWriterOpenFile() flag: bypass the page cache (O_DIRECT) where the
+ * file system allows it, else drop written pages with posix_fadvise() */
+#define MORSE_WRITER_DIRECT 0x1
+
+/** One piece of a gathered write */
+typedef struct {
+  const char *data;
+  size_t length;
+} MorseSlice;
+
+/** Output state; fields are private to morse_output.c */
+typedef struct {
+  int fd;
+  char *buffer;      ///< MORSE_WRITER_BUFFER_SIZE bytes, page aligned
+  size_t used;       ///< bytes buffered but not written yet
+  bool eager;        ///< write through on every call (pipes and terminals)
+  bool direct;       ///< fd was opened with O_DIRECT
+  bool dropCache;    ///< posix_fadvise(POSIX_FADV_DONTNEED) written ranges
+  bool ownsFd;       ///< close fd in morseWriterClose()
+  long long written; ///< file offset of the buffer start
+} MorseWriter;
+
+/**
+ * Write to an already open descriptor, e.g. STDOUT_FILENO.
+ * @return false if out of memory
+ */
+bool morseWriterOpenFd(MorseWriter *writer, int fd);
+
+/**
+ * Create or truncate path and write to it.
+ * @param flags 0 or MORSE_WRITER_DIRECT
+ * @return false with errno set if the file cannot be opened
+ */
+bool morseWriterOpenFile(MorseWriter *writer, const char *path,
+                         unsigned int flags);
+
+/**
+ * Descriptor the writer writes to, for callers that write to it directly
+ * while nothing is buffered.
+ */
+int morseWriterFd(const MorseWriter *writer);
+
+/**
+ * Append the concatenation of count slices.
+ * @return false with errno set on a write error
+ */
+bool morseWriterWriteParts(MorseWriter *writer, const MorseSlice *parts,
+                           size_t count);
+
+/** Append length bytes, see morseWriterWriteParts() */
+bool morseWriterWrite(MorseWriter *writer, const char *data, size_t length);
+
+/**
+ * Write out everything buffered, so the descriptor can be written directly
+ * next. With MORSE_WRITER_DIRECT a tail short of the alignment stays
+ * buffered.
+ * @return false with errno set on a write error
+ */
+bool morseWriterFlush(MorseWriter *writer);
+
+/**
+ * Write out everything buffered and close the descriptor if the writer
+ * opened it, keeping the buffer for morseWriterReopen().
+ * @return false with errno set if any write failed
+ */
+bool morseWriterFinish(MorseWriter *writer);
+
+/**
+ * Continue a finished writer in a new file, reusing its buffer. If path
+ * cannot be opened the writer stays finished and may be reopened again.
+ * @param flags 0 or MORSE_WRITER_DIRECT
+ * @return false with errno set if the file cannot be opened
+ */
+bool morseWriterReopen(MorseWriter *writer, const char *path,
+                       unsigned int flags);
+
+/**
+ * Finish the writer and release its buffer.
+ * @return false with errno set if any write failed
+ */
+bool morseWriterClose(MorseWriter *writer);
+
+#endif // MORSE_OUTPUT_H
@@ -0,0 +1,152 @@
+/**
+ * @file morse_packed.h
+ * @brief Packed binary Morse format
+ * @author Diego Rubio Carrera
+ *
+ * A packed stream is a 4-byte header followed by one byte per token of the
+ * text format: a symbol's code as its decode index (1 << n) | dashes, the
+ * '*' of an unsupported byte, or a word gap. The separators between
+ * symbols are implied, so packed code is a little smaller than the text it
+ * encodes - about a quarter of the size of dots and dashes for English
+ * prose - and decoding it is a single table lookup per byte.
+ *
+ * The tokens correspond one to one with what the text encoder writes, and
+ * the header records the word spacer, so nothing of the text format is
+ * lost. Decoding packed code gives exactly the text that decoding its text
+ * form gives, and a MorseTranscoder converts between the two forms
+ * without decoding: text Morse code laid out as the encoder writes it
+ * becomes packed tokens and back, byte for byte.
+ */
+
+// ReqNonFunc08: Include guard compatible with MinGW and GNU-C
+#ifndef MORSE_PACKED_H
+#define MORSE_PACKED_H
+
+#include <morse_codec.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+/** Size of the header: "\0MP", then the version in the high nibble and
+ * MORSE_PACKED_SLASH in the low one */
+#define MORSE_PACKED_HEADER_SIZE 4
+
+/** Header flag: the text form separates words with " / " */
+#define MORSE_PACKED_SLASH 0x1
+
+/** Token of a word gap - ReqFunc27 */
+#define MORSE_PACKED_GAP 0x00
+
+/** Token of an unsupported byte, '*' in the text format - ReqFunc25 */
+#define MORSE_PACKED_UNSUPPORTED 0x01
+
+/** Output bytes morsePackedEncode() may write for length input bytes */
+#define MORSE_PACKED_FEED_BOUND(length) (length)
+
+/** Most elements of a symbol token: its decode index fills a byte */
+#define MORSE_PACKED_MAX_ELEMENTS 7
+
+/** Output bytes morsePackedToText() may write for length tokens: a
+ * separator and the longest symbol each */
+#define MORSE_PACKED_TEXT_BOUND(length)                                        \
+  ((length) * (MORSE_PACKED_MAX_ELEMENTS + 1))
+
+/** Output bytes the finish call may write: the pending symbol */
+#define MORSE_PACKED_FINISH_BOUND 1
+
+/** Format of Morse input, see morsePackedDetect() */
+typedef enum {
+  MORSE_FORMAT_UNDECIDED, ///< a prefix of the header; more input needed
+  MORSE_FORMAT_TEXT,      ///< dots, dashes, spaces and slashes
+  MORSE_FORMAT_PACKED     ///< starts with a packed header
+} MorseFormat;
+
+/** Transcoder context, for one direction at a time; fields are private to
+ * morse_packed.c */
+typedef struct {
+  bool useSlashWordspacer; ///< the text separates words with " / "
+  unsigned int code;       ///< text: pending symbol, bit i for element i
+  unsigned int codeLength; ///< its elements, 0 = none pending
+  bool unsupported;        ///< text: the pending symbol is a '*'
+  unsigned int spacing;    ///< text: separator bytes since the last symbol
+  bool afterSymbol;        ///< a symbol has been converted, and for packed
+                           ///< input no word gap since
+  size_t offset;           ///< text: bytes read since the start
+  bool failed;             ///< text: not laid out as the encoder writes it
+  size_t errorOffset;      ///< of the first byte that is not
+} MorseTranscoder;
+
+/**
+ * Write the header of a packed stream.
+ * @param out receives MORSE_PACKED_HEADER_SIZE bytes
+ * @return MORSE_PACKED_HEADER_SIZE
+ */
+size_t morsePackedHeader(bool useSlashWordspacer, char *out);
+
+/**
+ * Tell packed from text Morse code by the first bytes of the input. Text
+ * never starts with a NUL byte, so a single byte mostly decides.
+ * @param length start bytes available, at most MORSE_PACKED_HEADER_SIZE
+ * are looked at
+ */
+MorseFormat morsePackedDetect(const char *data, size_t length);
+
+/**
+ * Encode the next length bytes of text as packed tokens, advancing the
+ * encoder exactly as morseEncoderFeed() does. The header is not included.
+ * @param out receives MORSE_PACKED_FEED_BOUND(length) bytes at most
+ * @return number of bytes written to out
+ */
+size_t morsePackedEncode(MorseEncoder *encoder, const char *text,
+                         size_t length, char *out);
+
+/** Exact size of the packed tokens of a whole text, header excluded */
+size_t morsePackedEncodedLength(const char *text, size_t length);
+
+/**
+ * Decode packed tokens, the header already removed. Tokens carry no state
+ * between them, so the input may be split anywhere.
+ * @param out receives length bytes at most
+ * @return number of bytes written to out
+ */
+size_t morsePackedDecode(const char *packed, size_t length, char *out);
+
+/** Exact size of the decoding of packed tokens */
+size_t morsePackedDecodedLength(const char *packed, size_t length);
+
+/** Word spacer a complete header records */
+bool morsePackedHeaderSlash(const char *header);
+
+/** Start converting a new text; useSlashWordspacer is its word spacer */
+void morseTranscoderInit(MorseTranscoder *transcoder,
+                         bool useSlashWordspacer);
+
+/**
+ * Convert the next length bytes of text Morse code to packed tokens, the
+ * header not included. The text must be as morseEncoderFeed() writes it
+ * with the transcoder's word spacer, except that CR/LF are skipped and a
+ * symbol may have up to MORSE_PACKED_MAX_ELEMENTS elements; from the
+ * first byte that is not, nothing more is converted and failed is set.
+ * @param out receives MORSE_PACKED_FEED_BOUND(length) bytes at most
+ * @return number of bytes written to out
+ */
+size_t morsePackedFromText(MorseTranscoder *transcoder, const char *morse,
+                           size_t length, char *out);
+
+/**
+ * Convert the pending symbol at the end of the text; a text that ends
+ * inside a separator sets failed.
+ * @param out receives MORSE_PACKED_FINISH_BOUND bytes at most
+ * @return number of bytes written to out
+ */
+size_t morsePackedFromTextFinish(MorseTranscoder *transcoder, char *out);
+
+/**
+ * Convert packed tokens, the header already removed, to the text the
+ * encoder writes for them, with the transcoder's word spacer.
+ * @param out receives MORSE_PACKED_TEXT_BOUND(length) bytes at most
+ * @return number of bytes written to out
+ */
+size_t morsePackedToText(MorseTranscoder *transcoder, const char *packed,
+                         size_t length, char *out);
+
+#endif // MORSE_PACKED_H
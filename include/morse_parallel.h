@@ -0,0 +1,56 @@
+/**
+ * @file morse_parallel.h
+ * @brief Multi-threaded conversion of large inputs
+ * @author Diego Rubio Carrera
+ *
+ * Text is split into chunks at word boundaries. A first pass sizes every
+ * chunk's output and a prefix sum turns the sizes into offsets, so all
+ * chunks are then encoded straight into one exactly sized output buffer.
+ * Morse code is split where a symbol starts after a space or slash, the
+ * points at which the decoder state is known without decoding what came
+ * before. Both results are byte-identical to the serial codec.
+ */
+
+// ReqNonFunc08: Include guard compatible with MinGW and GNU-C
+#ifndef MORSE_PARALLEL_H
+#define MORSE_PARALLEL_H
+
+#include <morse_codec.h>
+#include <stddef.h>
+
+/** Worker pool with its reusable chunk and output buffers */
+typedef struct MorseParallel MorseParallel;
+
+/**
+ * Start a pool of threadCount threads; the calling thread is one of them.
+ * @return the pool, or NULL if out of memory
+ */
+MorseParallel *morseParallelCreate(unsigned int threadCount);
+
+/** Stop the workers and release the pool */
+void morseParallelDestroy(MorseParallel *parallel);
+
+/**
+ * Encode text on all threads. The encoder is advanced exactly as
+ * morseEncoderFeed() would advance it, so consecutive calls may carry a
+ * text across several blocks.
+ * @param encodedLength receives the number of encoded bytes
+ * @return encoded bytes, valid until the next call; NULL if out of memory
+ */
+const char *morseParallelEncode(MorseParallel *parallel, MorseEncoder *encoder,
+                                const char *text, size_t length,
+                                size_t *encodedLength);
+
+/**
+ * Decode Morse code on all threads. The decoder is advanced exactly as
+ * morseDecoderFeed() would advance it; call morseDecoderFinish() after the
+ * last block. A strict decoder's handler is called from every thread, not
+ * in offset order.
+ * @param decodedLength receives the number of decoded bytes
+ * @return decoded bytes, valid until the next call; NULL if out of memory
+ */
+const char *morseParallelDecode(MorseParallel *parallel, MorseDecoder *decoder,
+                                const char *morse, size_t length,
+                                size_t *decodedLength);
+
+#endif // MORSE_PARALLEL_H
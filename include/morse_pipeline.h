@@ -0,0 +1,62 @@
+/**
+ * @file morse_pipeline.h
+ * @brief Overlapped read, convert and write of one stream
+ * @author Diego Rubio Carrera
+ *
+ * Three chunks are in flight at once: the next one is read while the
+ * caller converts the current one and the converted previous one is
+ * written. Input and output are double-buffered, so a chunk's input can
+ * be reused once converted and its output once written. On Linux the
+ * transfers are queued on an io_uring, set up with raw system calls;
+ * where that is not available, one reader and one writer thread do them.
+ */
+
+// ReqNonFunc08: Include guard compatible with MinGW and GNU-C
+#ifndef MORSE_PIPELINE_H
+#define MORSE_PIPELINE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+/** Buffers and transfers of one stream; fields are private */
+typedef struct MorsePipeline MorsePipeline;
+
+/**
+ * Allocate the buffers and start reading the first chunk.
+ * Both descriptors are read and written at their current position, so
+ * pipes work as well as files.
+ * @param inputSize bytes read per chunk at most
+ * @param outputSize bytes of each output buffer
+ * @return the pipeline, or NULL with errno set
+ */
+MorsePipeline *morsePipelineCreate(int inputFd, int outputFd,
+                                   size_t inputSize, size_t outputSize);
+
+/**
+ * Wait for the next chunk and start reading the one after it.
+ * @param length receives its size, 0 at end of input
+ * @return the chunk, valid until the next call; NULL with errno set if
+ * reading failed
+ */
+const char *morsePipelineRead(MorsePipeline *pipeline, size_t *length);
+
+/** Output buffer of outputSize bytes for converting the current chunk */
+char *morsePipelineOutput(MorsePipeline *pipeline);
+
+/**
+ * Start writing the first length bytes of the morsePipelineOutput()
+ * buffer, after the previous write has completed.
+ * @return false with errno set if a write failed
+ */
+bool morsePipelineWrite(MorsePipeline *pipeline, size_t length);
+
+/**
+ * Wait for the last write.
+ * @return false with errno set if any write failed
+ */
+bool morsePipelineFinish(MorsePipeline *pipeline);
+
+/** Wait for transfers still in flight and release the pipeline */
+void morsePipelineDestroy(MorsePipeline *pipeline);
+
+#endif // MORSE_PIPELINE_H
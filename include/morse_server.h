@@ -0,0 +1,67 @@
+/**
+ * @file morse_server.h
+ * @brief Conversion server on a Unix domain socket, for --serve
+ * @author Diego Rubio Carrera
+ *
+ * A long-lived process answers conversion requests, so callers pay for a
+ * connection once instead of a fork and exec per conversion. Every
+ * request and response is an 8-byte header followed by a payload; a
+ * connection may send any number of requests, and they are answered in
+ * order.
+ *
+ * Request header: payload length (4 bytes, big-endian), operation
+ * (MORSE_REQUEST_ENCODE or MORSE_REQUEST_DECODE), the morseEncode() flags
+ * (MORSE_SLASH_WORDSPACER, MORSE_PACKED; 0 for decoding) and two zero
+ * bytes. The payload is the text or Morse code, which may be packed.
+ *
+ * Response header: payload length (4 bytes, big-endian), a
+ * MorseResponseStatus and three zero bytes. The payload is the converted
+ * result, empty unless the status is MORSE_RESPONSE_OK. After any other
+ * status the server closes the connection.
+ *
+ * With a cache, results are kept in memory by the key of morse_cache.h,
+ * and a request seen before is answered with a copy of its result.
+ */
+
+// ReqNonFunc08: Include guard compatible with MinGW and GNU-C
+#ifndef MORSE_SERVER_H
+#define MORSE_SERVER_H
+
+#include <morse_stats.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+/** Size of request and response headers */
+#define MORSE_SERVER_HEADER_SIZE 8
+
+/** Largest request payload accepted */
+#define MORSE_SERVER_MAX_REQUEST (16 * 1024 * 1024)
+
+/** Operation byte of an encode request */
+#define MORSE_REQUEST_ENCODE 'e'
+
+/** Operation byte of a decode request */
+#define MORSE_REQUEST_DECODE 'd'
+
+/** Status byte of a response */
+typedef enum {
+  MORSE_RESPONSE_OK,          ///< the payload is the result
+  MORSE_RESPONSE_BAD_REQUEST, ///< unknown operation, flags or reserved bytes
+  MORSE_RESPONSE_TOO_LARGE    ///< payload above MORSE_SERVER_MAX_REQUEST
+} MorseResponseStatus;
+
+/**
+ * Listen on path and answer requests until SIGINT or SIGTERM arrives.
+ * threadCount threads, the calling one included, wait on one epoll
+ * instance and each handles whichever connection becomes ready. A stale
+ * socket left at path is replaced; the socket is removed on return.
+ * @param cacheSize most bytes of results to keep in memory, 0 for none
+ * @param stats receives byte counts and the latency of every request, or
+ * NULL
+ * @return true after a signal; false with errno set if the server could
+ * not be started
+ */
+bool morseServe(const char *path, unsigned int threadCount,
+                size_t cacheSize, MorseStats *stats);
+
+#endif // MORSE_SERVER_H
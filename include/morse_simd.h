@@ -0,0 +1,54 @@
+/**
+ * @file morse_simd.h
+ * @brief Vectorized kernels behind the codec entry points
+ * @author Diego Rubio Carrera
+ */
+
+// ReqNonFunc08: Include guard compatible with MinGW and GNU-C
+#ifndef MORSE_SIMD_H
+#define MORSE_SIMD_H
+
+#include <morse_codec.h>
+#include <stdbool.h>
+
+/** Bytes classified per SIMD step */
+#define MORSE_SIMD_BLOCK 64
+
+/** Bytes case-folded and validated per SIMD encoder step */
+#define MORSE_SIMD_ENCODE_BLOCK 32
+
+/** Whether kernel is built in and the running CPU supports it */
+bool morseSimdSupported(MorseKernel kernel);
+
+/**
+ * Decode blocks * MORSE_SIMD_BLOCK bytes of Morse code with kernel, with
+ * the same state transitions as morseDecoderFeedScalar().
+ * @return number of bytes written to out
+ */
+size_t morseSimdDecode(MorseDecoder *decoder, MorseKernel kernel,
+                       const char *morse, size_t blocks, char *out);
+
+/**
+ * Encode the leading run of letters, digits and spaces of text with the
+ * same state transitions as morseEncoderFeed(). Stops at the first other
+ * byte or when fewer than MORSE_SIMD_ENCODE_BLOCK bytes remain; the
+ * encoder must already have emitted a symbol (firstChar false). Only the
+ * x86 kernels have a fast path; with AVX-512 VBMI2 it also emits with
+ * SIMD, see morse_simd.c.
+ * @param consumed receives the number of input bytes encoded
+ * @return number of bytes written to out, never more than
+ *         MORSE_ENCODER_FEED_BOUND(*consumed)
+ */
+size_t morseSimdEncode(MorseEncoder *encoder, MorseKernel kernel,
+                       const char *text, size_t length, char *out,
+                       size_t *consumed);
+
+/**
+ * Count the encoded size of blocks * MORSE_SIMD_BLOCK bytes of text with
+ * kernel, with the same state transitions as morseEncoderMeasureScalar().
+ * @return number of bytes morseEncoderFeed() would write
+ */
+size_t morseSimdMeasure(MorseEncoder *encoder, MorseKernel kernel,
+                        const char *text, size_t blocks);
+
+#endif // MORSE_SIMD_H
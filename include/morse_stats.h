@@ -0,0 +1,111 @@
+/**
+ * @file morse_stats.h
+ * @brief Counters and phase timings for --stats
+ * @author Diego Rubio Carrera
+ *
+ * The counters are taken over the data the CLI already holds - each input
+ * slice and each converted slice - rather than inside the codec, so a run
+ * without --stats executes exactly the same conversion code and pays one
+ * NULL check per slice.
+ */
+
+// ReqNonFunc08: Include guard compatible with MinGW and GNU-C
+#ifndef MORSE_STATS_H
+#define MORSE_STATS_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdio.h>
+
+/** Stages a run spends its time in */
+typedef enum {
+  MORSE_PHASE_INPUT,   ///< read(2), mmap(2)
+  MORSE_PHASE_CONVERT, ///< encoding or decoding
+  MORSE_PHASE_OUTPUT,  ///< handing converted bytes to the writer
+  MORSE_PHASE_TOTAL,   ///< the whole run
+  MORSE_PHASE_COUNT
+} MorseStatsPhase;
+
+/** Request latency buckets: bucket b counts requests answered in less
+ * than 2^(b+1) microseconds and, above bucket 0, at least 2^b */
+#define MORSE_LATENCY_BUCKETS 24
+
+/** Start of a timed phase */
+typedef struct {
+  double wall; ///< seconds, monotonic clock
+  double cpu;  ///< seconds of process CPU time
+} MorseStatsClock;
+
+/** Counters of one run */
+typedef struct {
+  long long bytesIn;
+  long long bytesOut;     ///< converted bytes, without banner, newline
+                          ///< and packed header
+  long long symbols;      ///< characters of the plain text, spaces excluded
+  long long words;        ///< runs of symbols between spaces
+  long long unsupported;  ///< encoded as '*' - ReqFunc25
+  long long morseSymbols; ///< symbols in decoder input, decodable or not
+  long long requests;     ///< --serve: requests answered
+  long long latency[MORSE_LATENCY_BUCKETS]; ///< --serve: requests by time
+  long long cacheHits;      ///< --cache: results sent from the cache
+  long long cacheMisses;    ///< --cache: results converted
+  long long cacheEvictions; ///< --cache: results removed to stay in limit
+  long long cacheBytes;     ///< --cache: bytes of results it holds
+  long long cacheLimit;     ///< --cache: most bytes, 0 = no cache
+  double wall[MORSE_PHASE_COUNT];
+  double cpu[MORSE_PHASE_COUNT];
+  bool inWord;        ///< text counter state: last counted byte was a symbol
+  bool inMorseSymbol; ///< Morse counter state: inside a symbol
+} MorseStats;
+
+/** Zero all counters */
+void morseStatsInit(MorseStats *stats);
+
+/** Reset the counter state at the start of a new input */
+void morseStatsBeginInput(MorseStats *stats);
+
+/** Current time, for morseStatsStop() */
+MorseStatsClock morseStatsStart(void);
+
+/** Add the time since start to phase */
+void morseStatsStop(MorseStats *stats, MorseStatsPhase phase,
+                    MorseStatsClock start);
+
+/**
+ * Count symbols and words of plain text: encoder input or decoder output.
+ * CR/LF are skipped as the encoder skips them.
+ * @param countUnsupported also count bytes without a Morse code
+ */
+void morseStatsCountText(MorseStats *stats, const char *text, size_t length,
+                         bool countUnsupported);
+
+/** Count the symbols of Morse code fed to the decoder */
+void morseStatsCountMorse(MorseStats *stats, const char *morse,
+                          size_t length);
+
+/** Count the symbols of packed tokens fed to the decoder, header removed */
+void morseStatsCountPacked(MorseStats *stats, const char *packed,
+                           size_t length);
+
+/** Count symbols, words and '*' of transcoded code by its packed tokens:
+ * the symbols are Morse symbols, not characters of a plain text */
+void morseStatsCountTokens(MorseStats *stats, const char *packed,
+                           size_t length);
+
+/** Count an answered --serve request that took seconds */
+void morseStatsCountRequest(MorseStats *stats, double seconds);
+
+/** Add the counters and times of from to into */
+void morseStatsMerge(MorseStats *into, const MorseStats *from);
+
+/**
+ * Print the statistics, as a table or in the JSON format of
+ * --programmer-info. A run that answered requests also gets the latency
+ * histogram, and one with a cache its counters.
+ * @param decode the run decoded: report unknown codes instead of '*' hits
+ * @param transcode the run transcoded: symbols are Morse symbols
+ */
+void morseStatsPrint(const MorseStats *stats, bool decode, bool transcode,
+                     bool json, FILE *file);
+
+#endif // MORSE_STATS_H
@@ -0,0 +1,75 @@
+/**
+ * @file morse_symbols.h
+ * @brief The Morse alphabet, defined once
+ * @author Diego Rubio Carrera
+ *
+ * MORSE_SYMBOLS(X) expands X(character, code) for every supported symbol.
+ * This list is the only place the alphabet is written down: at build time
+ * tools/morse_gentables.c expands it into the encode table, the decode
+ * table and the SIMD encoder's tokens and code costs, and checks that
+ * encoding and decoding are exact inverses. Letters are listed in upper
+ * case; their lower-case forms encode the same.
+ */
+
+// ReqNonFunc08: Include guard compatible with MinGW and GNU-C
+#ifndef MORSE_SYMBOLS_H
+#define MORSE_SYMBOLS_H
+
+#define MORSE_SYMBOLS(X)                                                       \
+  /* Letters A-Z, a-z - ReqFunc13-16 */                                        \
+  X('A', ".-")                                                                 \
+  X('B', "-...")                                                               \
+  X('C', "-.-.")                                                               \
+  X('D', "-..")                                                                \
+  X('E', ".")                                                                  \
+  X('F', "..-.")                                                               \
+  X('G', "--.")                                                                \
+  X('H', "....")                                                               \
+  X('I', "..")                                                                 \
+  X('J', ".---")                                                               \
+  X('K', "-.-")                                                                \
+  X('L', ".-..")                                                               \
+  X('M', "--")                                                                 \
+  X('N', "-.")                                                                 \
+  X('O', "---")                                                                \
+  X('P', ".--.")                                                               \
+  X('Q', "--.-")                                                               \
+  X('R', ".-.")                                                                \
+  X('S', "...")                                                                \
+  X('T', "-")                                                                  \
+  X('U', "..-")                                                                \
+  X('V', "...-")                                                               \
+  X('W', ".--")                                                                \
+  X('X', "-..-")                                                               \
+  X('Y', "-.--")                                                               \
+  X('Z', "--..")                                                               \
+  /* Numbers 0-9 - ReqFunc17-18 */                                             \
+  X('0', "-----")                                                              \
+  X('1', ".----")                                                              \
+  X('2', "..---")                                                              \
+  X('3', "...--")                                                              \
+  X('4', "....-")                                                              \
+  X('5', ".....")                                                              \
+  X('6', "-....")                                                              \
+  X('7', "--...")                                                              \
+  X('8', "---..")                                                              \
+  X('9', "----.")                                                              \
+  /* Punctuation - ReqFunc19-20 */                                             \
+  X('.', ".-.-.-")                                                             \
+  X(',', "--..--")                                                             \
+  X(':', "---...")                                                             \
+  X(';', "-.-.-.")                                                             \
+  X('?', "..--..")                                                             \
+  X('!', "-.-.--")                                                             \
+  /* Math symbols - ReqFunc21-22 */                                            \
+  X('=', "-...-")                                                              \
+  X('-', "-....-")                                                             \
+  X('+', ".-.-.")                                                              \
+  /* Format symbols - ReqFunc23-24 */                                          \
+  X('_', "..--.-")                                                             \
+  X('(', "-.--.")                                                              \
+  X(')', "-.--.-")                                                             \
+  X('/', "-..-.")                                                              \
+  X('@', ".--.-.")
+
+#endif // MORSE_SYMBOLS_H
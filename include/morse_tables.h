@@ -0,0 +1,78 @@
+/**
+ * @file morse_tables.h
+ * @brief Lookup tables shared by the scalar and SIMD codec kernels
+ * @author Diego Rubio Carrera
+ *
+ * The tables are constant data generated at build time from
+ * morse_symbols.h by tools/morse_gentables.c, so they need no
+ * initialization at run time.
+ */
+
+// ReqNonFunc08: Include guard compatible with MinGW and GNU-C
+#ifndef MORSE_TABLES_H
+#define MORSE_TABLES_H
+
+#include <morse_codec.h>
+
+/** Code of one input byte */
+typedef struct {
+  const char *code;
+  unsigned char length; ///< strlen(code), 0 = unsupported
+} MorseCode;
+
+/** Entries in MORSE_DECODE_TABLE: one per code of up to
+ * MORSE_MAX_CODE_LENGTH elements, plus the marker bit */
+#define MORSE_DECODE_TABLE_SIZE (1 << (MORSE_MAX_CODE_LENGTH + 1))
+
+/** Index of an n-element code: (1 << n) | dashes, bit i set for a dash */
+#define MORSE_DECODE_INDEX(code, codeLength) ((1u << (codeLength)) | (code))
+
+/** Token index of a SIMD fast-path byte: the case-folded byte, plus this
+ * bit when it follows a space */
+#define MORSE_TOKEN_AFTER_SPACE 0x80
+
+/** Longest fast-path token: separator plus a digit's code */
+#define MORSE_TOKEN_MAX_LENGTH 6
+
+/** Bytes per token, zero-padded so each is emitted with a single 8-byte
+ * copy; its nonzero bytes are exactly its output */
+#define MORSE_TOKEN_SIZE 8
+
+/** Input byte -> code, both letter cases */
+extern const MorseCode MORSE_ENCODE_TABLE[256];
+
+/** MORSE_DECODE_INDEX -> character, '\0' for unknown codes */
+extern const char MORSE_DECODE_TABLE[MORSE_DECODE_TABLE_SIZE];
+
+/** Encoded size of a byte's code alone: its code length, 1 for the '*' of
+ * an unsupported byte, 0 for spaces and CR/LF */
+extern const unsigned char MORSE_CODE_COSTS[256];
+
+/** Encoder output per token index, by [useSlashWordspacer][index]; a
+ * symbol's token starts with its separator unless it follows a space */
+extern const char MORSE_TOKEN_BYTES[2][256][MORSE_TOKEN_SIZE];
+
+/** Bytes of each MORSE_TOKEN_BYTES entry that belong to the output, 0 for
+ * bytes the fast path does not handle */
+extern const unsigned char MORSE_TOKEN_LENGTHS[2][256];
+
+/** MORSE_PACKED_TOKENS entry of CR and LF, which produce no token */
+#define MORSE_PACKED_SKIP 0xFF
+
+/** Input byte -> packed token, MORSE_PACKED_GAP for a space */
+extern const unsigned char MORSE_PACKED_TOKENS[256];
+
+/** Packed token -> decoded character, '\0' for tokens that decode to
+ * nothing */
+extern const char MORSE_PACKED_DECODE[256];
+
+/** Symbol index of the channel decoder: the marker bit above the elements,
+ * the first element highest, so each element shifts in at the bottom;
+ * 1 is no symbol and 0x80 and above more than MORSE_MAX_CODE_LENGTH */
+#define MORSE_CHANNEL_EMPTY 1
+#define MORSE_CHANNEL_INVALID 0x80
+
+/** Channel decoder symbol index -> character, '\0' for unknown codes */
+extern const char MORSE_CHANNEL_DECODE[256];
+
+#endif // MORSE_TABLES_H
@@ -0,0 +1,100 @@
+/**
+ * @file morse_timing.h
+ * @brief Decoder of key timing: mark and space durations to text
+ * @author Diego Rubio Carrera
+ *
+ * A receiver reports how long the key was down (a mark) and up (a space).
+ * Marks are told apart as dots and dashes, and spaces as element, letter
+ * and word gaps, by the nearest of two and three cluster centres. Every
+ * duration moves its own centre towards it, an online k-means, and pulls
+ * the others a little towards the PARIS ratios of 1:3 and 1:3:7, so no
+ * centre is left behind when the speed changes. The dots and dashes of a
+ * symbol are looked up in the codec's decode table.
+ *
+ * The whole state is a few centres and the symbol being keyed, with no
+ * allocation or history, so a process can keep one decoder per channel
+ * for thousands of channels.
+ */
+
+// ReqNonFunc08: Include guard compatible with MinGW and GNU-C
+#ifndef MORSE_TIMING_H
+#define MORSE_TIMING_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+/** Output bytes morseTimingFeed() may write: a letter and a word gap */
+#define MORSE_TIMING_FEED_BOUND 2
+
+/** Output bytes morseKeyingDecode() may write for length input bytes */
+#define MORSE_KEYING_FEED_BOUND(length) ((length) + 1)
+
+/** State of one channel */
+typedef struct {
+  float mark[2];  ///< centres of dot and dash durations, microseconds
+  float space[3]; ///< centres of element, letter and word gaps
+  unsigned char markCount[2];  ///< durations learned, up to a limit
+  unsigned char spaceCount[3];
+  unsigned char code;       ///< elements of the symbol, bit i set for a dash
+  unsigned char codeLength; ///< above MORSE_MAX_CODE_LENGTH: undecodable
+  bool inWord; ///< a character was written since the last word gap
+} MorseTimingDecoder;
+
+/** Keying timeline reader, see morseKeyingDecode(); fields are private */
+typedef struct {
+  MorseTimingDecoder timing;
+  unsigned long long previous; ///< time of the last transition
+  unsigned long long time;     ///< time of the line being read
+  char word[4];                ///< "down" or "up" of the line
+  unsigned char wordLength;
+  unsigned char state; ///< position in the line
+  bool keyDown;        ///< key state since the last transition
+  bool started;        ///< a transition has been read
+} MorseKeyingReader;
+
+/**
+ * Start a channel at wpm PARIS words per minute, where the centres begin;
+ * they follow the sender from the first durations on.
+ */
+void morseTimingInit(MorseTimingDecoder *decoder, unsigned int wpm);
+
+/**
+ * Decode the next duration of a channel.
+ * @param keyDown true for a mark, false for a space
+ * @param duration microseconds
+ * @param out receives MORSE_TIMING_FEED_BOUND bytes at most
+ * @return number of bytes written to out
+ */
+size_t morseTimingFeed(MorseTimingDecoder *decoder, bool keyDown,
+                       unsigned long duration, char *out);
+
+/**
+ * Write the symbol still being keyed at the end of the transmission and
+ * start over, keeping the learned centres.
+ * @param out receives 1 byte at most
+ * @return number of bytes written to out
+ */
+size_t morseTimingFinish(MorseTimingDecoder *decoder, char *out);
+
+/** Start reading a timeline at wpm, see morseTimingInit() */
+void morseKeyingInit(MorseKeyingReader *reader, unsigned int wpm);
+
+/**
+ * Decode the next length bytes of a keying timeline, as written by
+ * --format=keying: lines "<microseconds> down" or "<microseconds> up",
+ * with times rising. Other lines are skipped. The input may be split
+ * anywhere.
+ * @param out receives MORSE_KEYING_FEED_BOUND(length) bytes at most
+ * @return number of bytes written to out
+ */
+size_t morseKeyingDecode(MorseKeyingReader *reader, const char *text,
+                         size_t length, char *out);
+
+/**
+ * End the timeline; a mark without its "up" line is dropped.
+ * @param out receives 1 byte at most
+ * @return number of bytes written to out
+ */
+size_t morseKeyingFinish(MorseKeyingReader *reader, char *out);
+
+#endif // MORSE_TIMING_H
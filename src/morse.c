@@ -0,0 +1,2458 @@
+/**
+ * @file morse.c
+ * @brief Morse Code CLI Application
+ * @author Diego Rubio Carrera
+ *
+ * A functional implementation of a Morse code encoder/decoder
+ */
+
+#define _GNU_SOURCE // F_GETPIPE_SZ, F_SETPIPE_SZ
+
+#include <errno.h>
+#include <fcntl.h>
+#include <getopt.h> // ReqNonFunc05: Required for getopt_long
+#include <morse/morse.h>
+#include <morse_alphabet.h>
+#include <morse_arena.h>
+#include <morse_audio.h>
+#include <morse_cache.h>
+#include <morse_codec.h>
+#include <morse_output.h>
+#include <morse_packed.h>
+#include <morse_parallel.h>
+#include <morse_pipeline.h>
+#include <morse_server.h>
+#include <morse_stats.h>
+#include <morse_timing.h>
+#include <pthread.h>
+#include <stdarg.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#ifndef _WIN32
+#include <sys/mman.h> // mmap input path
+#endif
+
+/* Error handling types for functional approach */
+typedef enum {
+  MORSE_SUCCESS,
+  MORSE_INVALID_INPUT,
+  MORSE_FILE_NOT_FOUND,
+  MORSE_FILE_READ_ERROR,
+  MORSE_FILE_WRITE_ERROR,
+  MORSE_CONFLICTING_OPTIONS,
+  MORSE_MEMORY_ERROR,
+  MORSE_INVALID_OPTION,
+  MORSE_MALFORMED_INPUT // --strict: undecodable symbols, output complete
+} MorseError;
+
+/* Messages and data live in the arena of the job that created them */
+typedef struct {
+  bool hasError;
+  MorseError errorCode;
+  const char *errorMessage;
+  void *data;
+  size_t length; // bytes at data, for results that carry text
+} Result;
+
+/* Program configuration */
+typedef struct {
+  bool help;
+  bool programmerInfo;
+  bool decode;
+  bool encode;
+  bool slashWordspacer; // ReqOptFunc02
+  bool packed;          // --format=packed: encode to the packed format
+  bool transcode;       // --transcode: Morse code to the other format
+  const char *inputText; // argv strings, not copied
+  const char *inputFile;
+  const char *outputFile;
+  bool readFromPipe;
+  bool useMmap; // map the input file even below MMAP_MIN_SIZE
+  unsigned int threadCount; // conversion threads, 1 = serial
+  bool raw;          // no "Encoded: "/"Decoded: " banner on stdout
+  bool directOutput; // bypass the page cache for the output file
+  char **inputFiles; // batch mode: several INPUT_FILE arguments
+  size_t inputFileCount;
+  const char *batchList; // --batch: file listing input files, one per line
+  const char *outputDir; // --out-dir: one output file per input file
+  bool stats;            // --stats: counters and timings on stderr
+  bool statsJson;        // --stats=json
+  bool lines;            // --lines: every input line is one record
+  const char *servePath; // --serve: answer requests on this Unix socket
+  bool strict;           // --strict: report undecodable Morse symbols
+  MorseAudioFormat audio; // --format=wav|keying: play the code out
+  MorseAudioConfig audioConfig; // --wpm, --tone, --sample-rate, --channels
+  bool audioTiming;             // one of those was given
+  bool keyingInput; // -d --format=keying: decode a keying timeline
+  const MorseAlphabet *alphabet; // --table: code table, NULL = built-in
+  uint64_t tableHash;            // hash of the table's text, 0 = built-in
+  const char *cacheDir; // --cache: keep results in this directory
+  size_t cacheSize;     // --cache-size, 0 = not given
+  MorseCache *cache;    // opened by runCommand() for --cache
+} Options;
+
+/* Input bytes converted per streaming step */
+#define STREAM_CHUNK_SIZE (64 * 1024)
+
+/* Largest single read(2) of the serial stream; reads start at the pipe
+ * capacity or STREAM_CHUNK_SIZE and double while they come back full */
+#define STREAM_READ_MAX (1024 * 1024)
+
+/* Regular files at least this large are mapped instead of read(2) */
+#define MMAP_MIN_SIZE (1024 * 1024)
+
+/* Input bytes per thread handed to the parallel codec at once */
+#define PARALLEL_SLICE_PER_THREAD (4 * 1024 * 1024)
+
+/* Upper limit for -j, --threads */
+#define MAX_THREADS 1024
+
+/* Longest output path built for --out-dir */
+#define MAX_OUTPUT_PATH 4096
+
+/* --strict: where the undecodable symbols of one input were found */
+typedef struct {
+  const char *name; // batch file named in every report, or NULL
+  size_t base;      // stream offset the decoder's offsets start from
+  size_t count;
+} MalformedReport;
+
+/* Conversion state shared by the read(2) and mmap input paths; its buffers
+ * are reused for every input of a batch */
+typedef struct {
+  MorseArena *arena; // buffers and error messages
+  bool decode;
+  bool slashWordspacer;
+  bool useMmap;
+  bool packed; // encode to the packed format
+  bool transcode; // text Morse code to packed tokens, or the reverse
+  MorseTranscoder transcoder;
+  bool lines;  // convert line by line, see streamLines()
+  const char *recordBanner; // --lines: written before every record, or NULL
+  MorseFormat format; // decode: packed or text input, see detectFormat()
+  char header[MORSE_PACKED_HEADER_SIZE]; // header prefix held back
+  size_t headerLength;
+  MorseEncoder encoder;
+  MorseDecoder decoder;
+  bool strict; // decode with malformed reporting, see reportMalformed()
+  MalformedReport malformed;
+  bool keying;         // decode a keying timeline instead of Morse code
+  unsigned int keyingWpm; // speed the timeline decoder starts from
+  MorseKeyingReader keyingReader;
+  const MorseAlphabet *alphabet; // --table: convert with it, or NULL
+  MorseAlphabetEncoder alphabetEncoder;
+  MorseAlphabetDecoder alphabetDecoder;
+  MorseCache *cache;  // --cache: results are looked up and stored, or NULL
+  uint64_t tableHash; // of alphabet, for the cache key
+  bool directOutput;  // the writer bypasses the page cache
+  bool storing;       // writes are copied into cacheEntry as well
+  MorseCacheEntry cacheEntry;
+  MorseParallel *parallel; // NULL = convert on the calling thread
+  size_t sliceSize;        // input bytes per convertSlice() call
+  size_t inputSize;        // bytes at input, the largest read(2)
+  char *input;             // buffer read(2) fills
+  char *converted; // the encoder's bound for STREAM_CHUNK_SIZE bytes
+  MorseWriter *writer;
+  MorseAudio *audio; // --format=wav|keying: gets the code instead, or NULL
+  int pipelineFd;    // output fd for streamPipelined(), -1 = use writer
+  MorseStats *stats; // NULL = no --stats, nothing is counted or timed
+} StreamConverter;
+
+/* Files of a batch, handed out to the batch workers in order */
+typedef struct {
+  const Options *options;
+  char **files;
+  size_t fileCount;
+  size_t next; // index of the next file to convert
+  bool failed; // at least one file could not be converted
+  MorseStats *stats; // every worker's counters are added here, or NULL
+  pthread_mutex_t lock;
+} BatchQueue;
+
+/* Function prototypes */
+static Result createSuccess(void *data, size_t length);
+static Result createError(MorseArena *arena, MorseError errorCode,
+                          const char *format, ...)
+    __attribute__((format(printf, 3, 4)));
+
+static int runCommand(MorseArena *arena, int argc, char **argv);
+static int finishRun(const Options *options, MorseStats *stats,
+                     MorseStatsClock runStart, int status);
+static Result parseCommandLine(MorseArena *arena, int argc, char **argv);
+static void displayHelp(void);
+static void displayProgrammerInfo(void);
+
+static Result encodeText(MorseArena *arena, const char *text, size_t length,
+                         bool useSlashWordspacer, bool packed);
+static Result decodeText(MorseArena *arena, const char *morse,
+                         size_t length, MalformedReport *report);
+static Result decodeKeying(MorseArena *arena, const char *timeline,
+                           size_t length, unsigned int wpm);
+static Result convertWithTable(MorseArena *arena, const Options *options,
+                               const char *input, size_t length,
+                               MorseAlphabetCounts *counts);
+static Result transcodeText(MorseArena *arena, const Options *options,
+                            const char *morse, size_t length);
+static Result checkTranscoded(StreamConverter *converter);
+static Result loadTable(MorseArena *arena, const char *table,
+                        const MorseAlphabet **alphabet, uint64_t *hash);
+static unsigned int cacheMode(bool decode, bool slashWordspacer, bool packed,
+                              bool transcode);
+static void reportMalformed(void *context, size_t offset);
+static Result checkMalformed(MorseArena *arena,
+                             const MalformedReport *report);
+
+static Result openOutput(MorseArena *arena, const Options *options,
+                         MorseWriter *writer);
+static Result writeOutput(MorseArena *arena, const Options *options,
+                          const char *content, size_t length);
+static bool writeBanner(const Options *options, MorseWriter *writer,
+                        bool toStdout);
+static Result streamInput(MorseArena *arena, const Options *options,
+                          MorseStats *stats);
+static Result createConverter(MorseArena *arena, const Options *options,
+                              unsigned int threadCount,
+                              StreamConverter *converter);
+static void destroyConverter(StreamConverter *converter);
+static Result convertInput(StreamConverter *converter, int inputFd);
+static Result convertCached(StreamConverter *converter, int inputFd);
+static Result convertStream(StreamConverter *converter, int inputFd);
+static Result streamInputFd(StreamConverter *converter, int inputFd);
+static Result streamRead(int inputFd, StreamConverter *converter);
+static Result streamPipelined(int inputFd, StreamConverter *converter);
+static Result streamLines(int inputFd, StreamConverter *converter);
+static Result endRecord(StreamConverter *converter);
+static size_t firstReadSize(int inputFd, const StreamConverter *converter);
+static Result streamMapped(int inputFd, size_t size,
+                           StreamConverter *converter);
+static Result convertSlice(StreamConverter *converter, const char *data,
+                           size_t length);
+static Result finishConversion(StreamConverter *converter);
+static void detectFormat(StreamConverter *converter, const char **data,
+                         size_t *length);
+static bool readsPacked(const StreamConverter *converter);
+static void releaseHeader(StreamConverter *converter);
+static size_t convertSerial(StreamConverter *converter, const char *data,
+                            size_t length, char *out);
+static size_t finishSerial(StreamConverter *converter, char *out);
+static void countSlice(StreamConverter *converter, const char *input,
+                       size_t inputLength, const char *converted,
+                       size_t convertedLength);
+static Result writeConverted(StreamConverter *converter, const char *data,
+                             size_t length);
+static Result parseThreadCount(MorseArena *arena, const char *text,
+                               unsigned int *threadCount);
+static Result parseCacheSize(MorseArena *arena, const char *text,
+                             size_t *size);
+static Result parseAudioValue(MorseArena *arena, const char *option,
+                              const char *text, unsigned int minimum,
+                              unsigned int maximum, unsigned int *value);
+static Result writeAudio(MorseArena *arena, const Options *options,
+                         const char *morse, size_t length);
+static Result startAudio(MorseArena *arena, const Options *options,
+                         MorseWriter *writer, MorseAudio *audio);
+static Result convertBatch(MorseArena *arena, const Options *options,
+                           MorseStats *stats);
+static Result readBatchList(MorseArena *arena, const char *path,
+                            char ***files, size_t *count);
+static void *batchWorker(void *argument);
+static Result convertBatchFile(BatchQueue *queue, StreamConverter *converter,
+                               MorseWriter *writer, bool *writerOpen,
+                               const char *path);
+static const char *errorContext(MorseError errorCode);
+
+static bool isInputFromPipe(void);
+
+/* Result helper functions */
+static Result createSuccess(void *data, size_t length) {
+  Result result = {false, MORSE_SUCCESS, NULL, data, length};
+  return result;
+}
+
+/* The message is formatted into the arena; a NULL format means the error
+ * has been reported already */
+static Result createError(MorseArena *arena, MorseError errorCode,
+                          const char *format, ...) {
+  Result result = {true, errorCode, NULL, NULL, 0};
+  if (format) {
+    va_list arguments;
+    va_start(arguments, format);
+    result.errorMessage = morseArenaVprintf(arena, format, arguments);
+    va_end(arguments);
+    if (!result.errorMessage) {
+      result.errorMessage = "Memory allocation failed";
+    }
+  }
+  return result;
+}
+
+/* Main function */
+int main(int argc, char *argv[]) {
+  // Everything the run allocates is released at once
+  MorseArena arena;
+  morseArenaInit(&arena, MORSE_ARENA_BLOCK_SIZE);
+  int status = runCommand(&arena, argc, argv);
+  morseArenaDestroy(&arena);
+  return status;
+}
+
+/* Run the command line, allocating from arena; returns the exit status */
+static int runCommand(MorseArena *arena, int argc, char **argv) {
+  Result parseResult = parseCommandLine(arena, argc, argv);
+  if (parseResult.hasError) {
+    if (parseResult.errorMessage) {
+      fprintf(stderr, "Error: %s\n", parseResult.errorMessage);
+    }
+    return 1;
+  }
+
+  Options *options = (Options *)parseResult.data;
+
+  // Handle special options
+  if (options->help) {
+    displayHelp();
+    return 0;
+  }
+
+  if (options->programmerInfo) {
+    displayProgrammerInfo();
+    return 0;
+  }
+
+  // ReqOptFunc03: --slash-wordspacer only allowed with encode
+  if (options->decode && options->slashWordspacer) {
+    fprintf(stderr, "Warning: --slash-wordspacer can only be used with "
+                    "encode operation\n");
+    return 1;
+  }
+
+  if (options->decode && options->packed) {
+    fprintf(stderr, "Warning: --format=packed can only be used with encode "
+                    "operation; packed input is detected when decoding\n");
+    return 1;
+  }
+
+  if (options->decode && options->audio == MORSE_AUDIO_WAV) {
+    fprintf(stderr, "Warning: --format=wav can only be used with encode "
+                    "operation\n");
+    return 1;
+  }
+
+  if (options->encode && options->strict) {
+    fprintf(stderr, "Warning: --strict can only be used with decode "
+                    "operation; every byte of text can be encoded\n");
+    return 1;
+  }
+
+  // --stats: everything below adds to one set of counters
+  MorseStats runStats;
+  morseStatsInit(&runStats);
+  MorseStats *stats = options->stats ? &runStats : NULL;
+  MorseStatsClock runStart = morseStatsStart();
+
+  // --serve: one process answers requests until SIGINT or SIGTERM
+  if (options->servePath) {
+    if (!morseServe(options->servePath, options->threadCount,
+                    options->cacheSize, stats)) {
+      fprintf(stderr, "Error: Could not serve on '%s': %s\n",
+              options->servePath, strerror(errno));
+      return finishRun(options, stats, runStart, 1);
+    }
+    return finishRun(options, stats, runStart, 0);
+  }
+
+  if (options->cacheDir) {
+    options->cache = morseCacheOpen(options->cacheDir,
+                                    options->cacheSize
+                                        ? options->cacheSize
+                                        : MORSE_CACHE_DEFAULT_SIZE);
+    if (!options->cache) {
+      fprintf(stderr, "Error: Could not use cache '%s': %s\n",
+              options->cacheDir, strerror(errno));
+      return finishRun(options, stats, runStart, 1);
+    }
+  }
+
+  // Batch mode: many files in one process, sharing buffers and writer
+  if (options->inputFileCount > 0 || options->batchList != NULL) {
+    Result batchResult = convertBatch(arena, options, stats);
+    if (batchResult.hasError) {
+      if (batchResult.errorMessage) {
+        fprintf(stderr, "%s: %s\n", errorContext(batchResult.errorCode),
+                batchResult.errorMessage);
+      }
+      return finishRun(options, stats, runStart, 1);
+    }
+    return finishRun(options, stats, runStart, 0);
+  }
+
+  // ReqFunc10: Piped and file input is converted chunk by chunk, so memory
+  // use stays constant and output starts before the input has ended
+  if (options->readFromPipe || options->inputFile != NULL) {
+    Result streamResult = streamInput(arena, options, stats);
+    if (streamResult.hasError) {
+      if (streamResult.errorMessage) {
+        fprintf(stderr, "%s: %s\n", errorContext(streamResult.errorCode),
+                streamResult.errorMessage);
+      }
+      return finishRun(options, stats, runStart, 1);
+    }
+    return finishRun(options, stats, runStart, 0);
+  }
+
+  if (options->inputText == NULL) {
+    fprintf(stderr, "Error: No input text provided.\n");
+    displayHelp();
+    return finishRun(options, NULL, runStart, 1);
+  }
+
+  // Process the input
+  size_t inputLength = strlen(options->inputText);
+  MorseStatsClock convertStart = morseStatsStart();
+  Result processResult;
+  MalformedReport report = {NULL, 0, 0};
+  MorseAlphabetCounts tableCounts = {0, 0}; // symbols --table converted
+  uint64_t cacheKey = 0;
+  const char *cached = NULL; // --cache hit, mapped
+  size_t cachedLength = 0;
+  if (options->cache) {
+    cacheKey = morseCacheKey(
+        options->inputText, inputLength,
+        cacheMode(options->decode, options->slashWordspacer, options->packed,
+                  options->transcode),
+        options->tableHash);
+    int cachedFd = morseCacheLookup(options->cache, cacheKey, &cachedLength);
+    cached = cachedFd >= 0 ? morseCacheMap(cachedFd, cachedLength) : NULL;
+  }
+  if (cached) {
+    processResult = createSuccess((void *)cached, cachedLength);
+  } else if (options->transcode) {
+    processResult = transcodeText(arena, options, options->inputText,
+                                  inputLength);
+  } else if (options->keyingInput) {
+    processResult = decodeKeying(arena, options->inputText, inputLength,
+                                 options->audioConfig.wpm);
+  } else if (options->alphabet) {
+    processResult = convertWithTable(arena, options, options->inputText,
+                                     inputLength, &tableCounts);
+  } else if (options->decode) {
+    processResult = decodeText(arena, options->inputText, inputLength,
+                               options->strict ? &report : NULL);
+  } else {
+    processResult = encodeText(arena, options->inputText, inputLength,
+                               options->slashWordspacer, options->packed);
+  }
+
+  if (processResult.hasError) {
+    if (processResult.errorMessage) {
+      fprintf(stderr, "Processing Error: %s\n", processResult.errorMessage);
+    }
+    return finishRun(options, stats, runStart, 1);
+  }
+  if (options->cache && !cached) {
+    morseCacheStore(options->cache, cacheKey, processResult.data,
+                    processResult.length);
+  }
+  if (stats) {
+    morseStatsStop(stats, MORSE_PHASE_CONVERT, convertStart);
+    StreamConverter counter = {.decode = options->decode,
+                               .alphabet = options->alphabet,
+                               .packed = options->packed,
+                               .transcode = options->transcode,
+                               .alphabetEncoder.counts = tableCounts,
+                               .alphabetDecoder.counts = tableCounts,
+                               .stats = stats};
+    countSlice(&counter, options->inputText, inputLength, processResult.data,
+               processResult.length);
+  }
+
+  // Output the result to the output file or stdout
+  MorseStatsClock outputStart = morseStatsStart();
+  Result writeResult = writeOutput(arena, options, processResult.data,
+                                   processResult.length);
+  if (cached) {
+    morseCacheUnmap(cached, cachedLength);
+  }
+  if (writeResult.hasError) {
+    if (writeResult.errorMessage) {
+      fprintf(stderr, "Output Error: %s\n", writeResult.errorMessage);
+    }
+    return finishRun(options, stats, runStart, 1);
+  }
+  if (stats) {
+    morseStatsStop(stats, MORSE_PHASE_OUTPUT, outputStart);
+  }
+  Result strictResult = checkMalformed(arena, &report);
+  if (strictResult.hasError) {
+    fprintf(stderr, "%s: %s\n", errorContext(strictResult.errorCode),
+            strictResult.errorMessage);
+    return finishRun(options, stats, runStart, 1);
+  }
+  return finishRun(options, stats, runStart, 0);
+}
+
+/* Close the --cache, print the --stats report, if requested, and pass the
+ * exit status on */
+static int finishRun(const Options *options, MorseStats *stats,
+                     MorseStatsClock runStart, int status) {
+  if (options->cache) {
+    if (stats) {
+      morseCacheReport(options->cache, stats);
+    }
+    morseCacheClose(options->cache);
+  }
+  if (stats) {
+    morseStatsStop(stats, MORSE_PHASE_TOTAL, runStart);
+    morseStatsPrint(stats, options->decode, options->transcode,
+                    options->statsJson, stderr);
+  }
+  return status;
+}
+
+/* Parse command line arguments using getopt_long - ReqNonFunc05 */
+static Result parseCommandLine(MorseArena *arena, int argc, char **argv) {
+  Options *options = morseArenaAlloc(arena, sizeof(Options));
+  if (!options) {
+    return createError(arena, MORSE_MEMORY_ERROR, "Memory allocation failed");
+  }
+
+  // Initialize options
+  *options = (Options){.threadCount = 1};
+  morseAudioDefaults(&options->audioConfig);
+
+  // Define long options
+  static struct option long_options[] = {
+      {"help", no_argument, 0, 'h'},
+      {"programmer-info", no_argument, 0, 'p'},
+      {"encode", no_argument, 0, 'e'},
+      {"decode", no_argument, 0, 'd'},
+      {"out", required_argument, 0, 'o'},
+      {"slash-wordspacer", no_argument, 0, 's'}, // ReqOptFunc02
+      {"mmap", no_argument, 0, 'm'},
+      {"threads", required_argument, 0, 'j'},
+      {"raw", no_argument, 0, 'r'},
+      {"direct", no_argument, 0, 'D'},
+      {"batch", required_argument, 0, 'b'},
+      {"out-dir", required_argument, 0, 'O'},
+      {"stats", optional_argument, 0, 'S'},
+      {"format", required_argument, 0, 'F'},
+      {"lines", no_argument, 0, 'L'},
+      {"serve", required_argument, 0, 'V'},
+      {"strict", no_argument, 0, 'T'},
+      {"wpm", required_argument, 0, 'W'},
+      {"tone", required_argument, 0, 'Q'},
+      {"sample-rate", required_argument, 0, 'A'},
+      {"channels", required_argument, 0, 'C'},
+      {"table", required_argument, 0, 'X'},
+      {"cache", required_argument, 0, 'K'},
+      {"cache-size", required_argument, 0, 'Z'},
+      {"transcode", no_argument, 0, 'R'},
+      {0, 0, 0, 0}};
+
+  int option_index = 0;
+  int c;
+
+  while ((c = getopt_long(argc, argv, "hpedo:j:", long_options,
+                          &option_index)) != -1) {
+    switch (c) {
+    case 'h':
+      options->help = true;
+      return createSuccess(options, sizeof(Options));
+    case 'p':
+      options->programmerInfo = true;
+      return createSuccess(options, sizeof(Options));
+    case 'e':
+      options->encode = true;
+      break;
+    case 'd':
+      options->decode = true;
+      break;
+    case 'o':
+      options->outputFile = optarg;
+      break;
+    case 's':
+      options->slashWordspacer = true;
+      break;
+    case 'm':
+      options->useMmap = true;
+      break;
+    case 'r':
+      options->raw = true;
+      break;
+    case 'D':
+      options->directOutput = true;
+      break;
+    case 'b':
+      options->batchList = optarg;
+      break;
+    case 'O':
+      options->outputDir = optarg;
+      break;
+    case 'L':
+      options->lines = true;
+      break;
+    case 'V':
+      options->servePath = optarg;
+      break;
+    case 'T':
+      options->strict = true;
+      break;
+    case 'S':
+      options->stats = true;
+      if (optarg && strcmp(optarg, "json") == 0) {
+        options->statsJson = true;
+      } else if (optarg) {
+        return createError(arena, MORSE_INVALID_OPTION,
+                           "Invalid --stats format '%s' (only 'json')",
+                           optarg);
+      }
+      break;
+    case 'F':
+      options->packed = false;
+      options->audio = MORSE_AUDIO_NONE;
+      if (strcmp(optarg, "packed") == 0) {
+        options->packed = true;
+      } else if (strcmp(optarg, "wav") == 0) {
+        options->audio = MORSE_AUDIO_WAV;
+      } else if (strcmp(optarg, "keying") == 0) {
+        options->audio = MORSE_AUDIO_KEYING;
+      } else if (strcmp(optarg, "text") != 0) {
+        return createError(arena, MORSE_INVALID_OPTION,
+                           "Invalid --format '%s' (text, packed, wav or "
+                           "keying)",
+                           optarg);
+      }
+      break;
+    case 'W':
+    case 'Q':
+    case 'A':
+    case 'C': {
+      MorseAudioConfig *config = &options->audioConfig;
+      Result audioResult =
+          c == 'W'   ? parseAudioValue(arena, "--wpm", optarg,
+                                       MORSE_AUDIO_MIN_WPM, MORSE_AUDIO_MAX_WPM,
+                                       &config->wpm)
+          : c == 'Q' ? parseAudioValue(arena, "--tone", optarg,
+                                       MORSE_AUDIO_MIN_TONE,
+                                       MORSE_AUDIO_MAX_SAMPLE_RATE / 2,
+                                       &config->tone)
+          : c == 'A' ? parseAudioValue(arena, "--sample-rate", optarg,
+                                       MORSE_AUDIO_MIN_SAMPLE_RATE,
+                                       MORSE_AUDIO_MAX_SAMPLE_RATE,
+                                       &config->sampleRate)
+                     : parseAudioValue(arena, "--channels", optarg, 1,
+                                       MORSE_AUDIO_MAX_CHANNELS,
+                                       &config->channels);
+      if (audioResult.hasError) {
+        return audioResult;
+      }
+      options->audioTiming = true;
+      break;
+    }
+    case 'X': {
+      Result tableResult = loadTable(arena, optarg, &options->alphabet,
+                                     &options->tableHash);
+      if (tableResult.hasError) {
+        return tableResult;
+      }
+      break;
+    }
+    case 'K':
+      options->cacheDir = optarg;
+      break;
+    case 'R':
+      options->transcode = true;
+      break;
+    case 'Z': {
+      Result sizeResult = parseCacheSize(arena, optarg, &options->cacheSize);
+      if (sizeResult.hasError) {
+        return sizeResult;
+      }
+      break;
+    }
+    case 'j': {
+      Result threadResult =
+          parseThreadCount(arena, optarg, &options->threadCount);
+      if (threadResult.hasError) {
+        return threadResult;
+      }
+      break;
+    }
+    case '?':
+      return createError(arena, MORSE_INVALID_OPTION, "Invalid option");
+    default:
+      return createError(arena, MORSE_INVALID_OPTION, "Unknown option");
+    }
+  }
+
+  // ReqFunc07: Check for conflicting options
+  if (options->encode && options->decode) {
+    return createError(
+        arena, MORSE_CONFLICTING_OPTIONS,
+        "Cannot specify both encode (-e) and decode (-d) options");
+  }
+
+  // --transcode is an operation of its own: Morse code in and out
+  if (options->transcode && (options->encode || options->decode)) {
+    return createError(arena, MORSE_CONFLICTING_OPTIONS,
+                       "Cannot specify --transcode with encode (-e) or "
+                       "decode (-d)");
+  }
+
+  // ReqFunc05: Default is encode if neither specified
+  if (!options->decode && !options->encode && !options->transcode) {
+    options->encode = true;
+  }
+
+  // Packed code is binary: 0x0A is a symbol, not the end of a line
+  if (options->lines && options->packed) {
+    return createError(arena, MORSE_CONFLICTING_OPTIONS,
+                       "Cannot specify both --lines and --format=packed");
+  }
+
+  // Decoding, --format=keying reads the timeline it writes when encoding
+  if (options->decode && options->audio == MORSE_AUDIO_KEYING) {
+    options->audio = MORSE_AUDIO_NONE;
+    options->keyingInput = true;
+  }
+
+  // A timeline has no lines of text, and no offsets of Morse symbols
+  if (options->keyingInput && (options->lines || options->strict)) {
+    return createError(arena, MORSE_CONFLICTING_OPTIONS,
+                       "Cannot decode --format=keying with --lines or "
+                       "--strict");
+  }
+
+  // A table's codes have no packed tokens, a timeline is decoded with the
+  // built-in codes, and --strict reports what the built-in decoder drops
+  if (options->alphabet &&
+      (options->packed || options->keyingInput || options->strict)) {
+    return createError(arena, MORSE_CONFLICTING_OPTIONS,
+                       "Cannot specify --table with --format=packed, "
+                       "-d --format=keying or --strict");
+  }
+
+  // Packed tokens hold the encoder's code and layout, nothing else; packed
+  // input records its own word spacer
+  if (options->transcode &&
+      (options->lines || options->strict || options->alphabet ||
+       options->audio != MORSE_AUDIO_NONE)) {
+    return createError(arena, MORSE_CONFLICTING_OPTIONS,
+                       "Cannot specify --transcode with --lines, --strict, "
+                       "--table, --format=wav or --format=keying");
+  }
+
+  if (options->transcode && options->slashWordspacer && !options->packed) {
+    return createError(arena, MORSE_CONFLICTING_OPTIONS,
+                       "--slash-wordspacer with --transcode describes text "
+                       "input, for --format=packed; packed input records "
+                       "its word spacer");
+  }
+
+  // A cached result is the converted text alone, while records, audio and
+  // --strict reports are made during the conversion
+  if (options->cacheDir &&
+      (options->lines || options->strict ||
+       options->audio != MORSE_AUDIO_NONE || options->keyingInput)) {
+    return createError(arena, MORSE_CONFLICTING_OPTIONS,
+                       "Cannot specify --cache with --lines, --strict, "
+                       "--format=wav or --format=keying");
+  }
+
+  if (options->cacheSize && !options->cacheDir && !options->servePath) {
+    return createError(arena, MORSE_CONFLICTING_OPTIONS,
+                       "--cache-size needs --cache or --serve");
+  }
+
+  if (options->audioTiming && options->audio == MORSE_AUDIO_NONE &&
+      !options->keyingInput) {
+    return createError(arena, MORSE_CONFLICTING_OPTIONS,
+                       "--wpm, --tone, --sample-rate and --channels need "
+                       "--format=wav or --format=keying");
+  }
+
+  // The tone must be representable at the sample rate
+  if (options->audio == MORSE_AUDIO_WAV &&
+      options->audioConfig.tone >= options->audioConfig.sampleRate / 2) {
+    return createError(arena, MORSE_INVALID_OPTION,
+                       "--tone %u Hz needs a --sample-rate above %u Hz",
+                       options->audioConfig.tone,
+                       options->audioConfig.tone * 2);
+  }
+
+  // One timeline per output: the WAV header is rewritten in place once
+  // its length is known, and a record cannot end inside a tone
+  if (options->audio != MORSE_AUDIO_NONE &&
+      (options->lines || options->directOutput)) {
+    return createError(arena, MORSE_CONFLICTING_OPTIONS,
+                       "Cannot specify --format=wav or --format=keying with "
+                       "--lines or --direct");
+  }
+
+  if (options->outputDir && options->outputFile) {
+    return createError(arena, MORSE_CONFLICTING_OPTIONS,
+                       "Cannot specify both --out (-o) and --out-dir");
+  }
+
+  // Several arguments, --batch or --out-dir: every argument is a file
+  if (argc - optind > 1 || (optind < argc && (options->batchList ||
+                                              options->outputDir))) {
+    options->inputFiles = argv + optind;
+    options->inputFileCount = (size_t)(argc - optind);
+  } else if (optind < argc) {
+    // Handle remaining argument (input text or file)
+    // Check if it's a readable file or treat as input text
+    if (access(argv[optind], R_OK) == 0) {
+      options->inputFile = argv[optind];
+    } else {
+      options->inputText = argv[optind];
+    }
+  }
+
+  if (options->servePath && options->cacheDir) {
+    return createError(arena, MORSE_CONFLICTING_OPTIONS,
+                       "--serve caches in memory; give --cache-size instead "
+                       "of --cache");
+  }
+
+  if (options->servePath &&
+      (options->inputText || options->inputFile || options->inputFileCount ||
+       options->batchList || options->outputFile || options->outputDir ||
+       options->audio != MORSE_AUDIO_NONE || options->keyingInput ||
+       options->alphabet || options->transcode)) {
+    return createError(arena, MORSE_CONFLICTING_OPTIONS,
+                       "--serve takes no input or output options; every "
+                       "request carries its own");
+  }
+
+  if (options->audio != MORSE_AUDIO_NONE &&
+      (options->inputFileCount > 0 || options->batchList)) {
+    return createError(arena, MORSE_CONFLICTING_OPTIONS,
+                       "--format=wav and --format=keying convert one input "
+                       "at a time");
+  }
+
+  if (options->outputDir && options->inputFileCount == 0 &&
+      !options->batchList) {
+    return createError(
+        arena, MORSE_INVALID_INPUT,
+        "--out-dir needs input files (INPUT_FILE... or --batch)");
+  }
+
+  // ReqFunc10: Check if input is from pipe
+  options->readFromPipe = isInputFromPipe();
+
+  return createSuccess(options, sizeof(Options));
+}
+
+/* Display help information - ReqFunc01, ReqFunc02 */
+static void displayHelp(void) {
+  printf("Morse Code Converter - Help\n");
+  printf("============================\n\n");
+  printf("A functional CLI application to convert text to Morse code and vice "
+         "versa.\n\n");
+  printf("USAGE:\n");
+  printf("  morse [OPTIONS] [INPUT_TEXT|INPUT_FILE]\n\n");
+  printf("OPTIONS:\n");
+  printf("  -h, --help                 Display this help message\n");
+  printf("  -e, --encode               Encode text to Morse code (default if "
+         "not specified)\n");
+  printf("  -d, --decode               Decode Morse code to text\n");
+  printf("  -o, --out FILE             Write output to specified file instead "
+         "of stdout\n");
+  printf("  --slash-wordspacer         Use ' / ' between words (encode and "
+         "--transcode)\n");
+  printf("  -j, --threads N            Convert with N threads (0 = one per "
+         "CPU core)\n");
+  printf("  --mmap                     Map INPUT_FILE into memory instead of "
+         "reading it\n"
+         "                             (automatic for files of 1 MB and "
+         "more)\n");
+  printf("  --raw                      Print only the converted text to "
+         "stdout, without\n"
+         "                             the 'Encoded: '/'Decoded: ' banner\n");
+  printf("  --direct                   Write the output file past the page "
+         "cache (O_DIRECT)\n");
+  printf("  --batch LIST               Convert every file listed in LIST "
+         "(one path per line)\n");
+  printf("  --out-dir DIR              Write each input file's result to "
+         "DIR/<file name>\n"
+         "                             (with -j N, N files are converted at "
+         "once)\n");
+  printf("  --format FORMAT            Encode to 'text' Morse code (default) "
+         "or to 'packed',\n"
+         "                             one byte per symbol; decoding "
+         "detects packed input\n");
+  printf("  --format wav|keying        Play the encoded code out with PARIS "
+         "timing: as 16-bit\n"
+         "                             PCM WAV, or as one '<microseconds> "
+         "down|up' line per\n"
+         "                             key transition; -d --format=keying "
+         "decodes such a\n"
+         "                             timeline, adapting to the sender's "
+         "speed\n");
+  printf("  --wpm N                    Words per minute of wav and keying "
+         "output (default 20);\n"
+         "                             with -d --format=keying, the speed "
+         "decoding starts from\n");
+  printf("  --tone HZ                  Tone frequency of wav output (default "
+         "700)\n");
+  printf("  --sample-rate HZ           Sample rate of wav output (default "
+         "48000)\n");
+  printf("  --channels N               Channels of wav output, all with the "
+         "same signal\n"
+         "                             (default 1, at most 64)\n");
+  printf("  --table itu|extended|FILE  Convert with another code table: "
+         "ITU-R M.1677-1,\n"
+         "                             the built-in one with international "
+         "letters and\n"
+         "                             prosigns such as <SK>, or a file of "
+         "'SYMBOL CODE' lines\n"
+         "                             (UTF-8 text; serial only)\n");
+  printf("  --transcode                Convert Morse code between the text and "
+         "packed formats\n"
+         "                             without decoding it: text to "
+         "--format=packed, packed\n"
+         "                             to text (text laid out as the "
+         "encoder writes it)\n");
+  printf("  --lines                    Convert every input line on its own and "
+         "write its result\n"
+         "                             as soon as the line is complete (for "
+         "log streams)\n");
+  printf("  --strict                   Report the offset of every undecodable "
+         "Morse symbol\n"
+         "                             and exit with status 1 (decode only)\n");
+  printf("  --serve SOCKET             Answer encode/decode requests on a Unix "
+         "socket until\n"
+         "                             SIGINT/SIGTERM (with -j N, on N "
+         "threads)\n");
+  printf("  --cache DIR                Keep results in DIR, by a hash of the "
+         "input and options,\n"
+         "                             and copy repeated ones from there "
+         "(files and arguments;\n"
+         "                             piped input is always converted)\n");
+  printf("  --cache-size BYTES[K|M|G]  Limit of the cache (default 256M); "
+         "with --serve, keep\n"
+         "                             that much of the results in memory\n");
+  printf("  --stats[=json]             Print byte, symbol and word counts and "
+         "per-phase\n"
+         "                             wall/CPU times to stderr\n");
+  printf("  --programmer-info          Display information about the "
+         "programmer\n\n");
+  printf("NOTES:\n");
+  printf("  - If both INPUT_TEXT and INPUT_FILE are not provided, input is "
+         "read from stdin\n");
+  printf("  - Piped and file input is converted as a stream, so memory use "
+         "stays constant\n");
+  printf("  - Several INPUT_FILEs are converted in one run; without --out-dir "
+         "each file's\n"
+         "    result becomes one line of output\n");
+  printf("  - Cannot specify both encode (-e) and decode (-d) options\n");
+  printf("  - Input and output files can be specified with relative or "
+         "absolute paths\n");
+  printf("  - Newlines and carriage returns are ignored in input, except "
+         "that with --lines\n"
+         "    every newline ends a record\n");
+  printf(
+      "  - Letters are separated by single spaces, words by triple spaces\n");
+  printf("  - Unsupported characters are represented as '*' in Morse code "
+         "output\n\n");
+  printf("EXAMPLES:\n");
+  printf("  morse -e \"HELLO WORLD\"                        Encode 'HELLO "
+         "WORLD' to Morse code\n");
+  printf("  morse \"HELLO WORLD\"                           Same as above "
+         "(encode is default)\n");
+  printf("  morse -d \".... . .-.. .-.. --- / .-- --- .-. .-.. -..\"    Decode "
+         "Morse code\n");
+  printf("  cat file.txt | morse -e                        Encode content from "
+         "pipe\n");
+  printf("  morse -e input.txt                             Encode content of "
+         "input.txt\n");
+  printf("  morse -d input.morse -o output.txt             Decode and write to "
+         "output.txt\n");
+  printf("  morse -e --batch list.txt --out-dir out        Encode every file "
+         "in list.txt\n");
+  printf("  morse -e --slash-wordspacer \"HELLO WORLD\"     Use slash word "
+         "separator\n\n");
+  printf("SUPPORTED CHARACTERS:\n");
+  printf("  - Letters: A-Z (case insensitive)\n");
+  printf("  - Numbers: 0-9\n");
+  printf("  - Symbols: Space, ., ,, :, ;, ?, !, =, -, +, _, (, ), /, @\n");
+  printf("  - Other letters and prosigns with --table; tables/ has the table "
+         "format\n\n");
+}
+
+/* Display programmer information in JSON format - ReqFunc03 */
+static void displayProgrammerInfo(void) {
+  printf("{\n");
+  printf("  \"name\": \"Diego Rubio Carrera\",\n");
+  printf("  \"program\": \"TIK\",\n");
+  printf("  \"email\": \"diegorubiocarrera@gmail.com\"\n");
+  printf("}\n");
+}
+
+/* Check if input is coming from a pipe */
+static bool isInputFromPipe(void) { return !isatty(STDIN_FILENO); }
+
+/* Open the output file, or stdout if none is given - ReqFunc11,
+ * ReqFunc12 */
+static Result openOutput(MorseArena *arena, const Options *options,
+                         MorseWriter *writer) {
+  if (options->outputFile == NULL) {
+    if (!morseWriterOpenFd(writer, STDOUT_FILENO)) {
+      return createError(arena, MORSE_MEMORY_ERROR,
+                         "Memory allocation failed");
+    }
+    return createSuccess(NULL, 0);
+  }
+
+  unsigned int flags = options->directOutput ? MORSE_WRITER_DIRECT : 0;
+  if (!morseWriterOpenFile(writer, options->outputFile, flags)) {
+    return createError(arena,
+                       errno == ENOMEM ? MORSE_MEMORY_ERROR
+                                       : MORSE_FILE_WRITE_ERROR,
+                       "Could not open file '%s' for writing",
+                       options->outputFile);
+  }
+  return createSuccess(NULL, 0);
+}
+
+/* Write a converted text; on stdout it goes out in one writev(2) with its
+ * banner and newline */
+static Result writeOutput(MorseArena *arena, const Options *options,
+                          const char *content, size_t length) {
+  if (options->audio != MORSE_AUDIO_NONE) {
+    return writeAudio(arena, options, content, length);
+  }
+
+  MorseWriter writer;
+  Result result = openOutput(arena, options, &writer);
+  if (result.hasError) {
+    return result;
+  }
+
+  // Packed code is binary; its header goes first, as writeBanner() writes
+  // it for streams, so results and cache entries never hold it
+  char header[MORSE_PACKED_HEADER_SIZE];
+  MorseSlice parts[3] = {{"", 0}, {content, length}, {"", 0}};
+  if (options->packed) {
+    size_t headerLength = morsePackedHeader(options->slashWordspacer, header);
+    parts[0] = (MorseSlice){header, headerLength};
+  } else if (options->outputFile == NULL) {
+    if (!options->raw && !options->transcode) {
+      parts[0] = (MorseSlice){options->decode ? "Decoded: " : "Encoded: ", 9};
+    }
+    parts[2] = (MorseSlice){"\n", 1};
+  }
+
+  bool written = morseWriterWriteParts(&writer, parts, 3);
+  if (!morseWriterClose(&writer) || !written) {
+    return createError(arena, MORSE_FILE_WRITE_ERROR,
+                       "Could not write complete content to file");
+  }
+  return createSuccess(NULL, 0);
+}
+
+/* --format=wav|keying: play an encoded text out to the output */
+static Result writeAudio(MorseArena *arena, const Options *options,
+                         const char *morse, size_t length) {
+  MorseWriter writer;
+  Result result = openOutput(arena, options, &writer);
+  if (result.hasError) {
+    return result;
+  }
+
+  MorseAudio audio;
+  result = startAudio(arena, options, &writer, &audio);
+  if (result.hasError) {
+    morseWriterClose(&writer);
+    return result;
+  }
+  bool written =
+      morseAudioFeed(&audio, morse, length) && morseAudioFinish(&audio);
+  morseAudioDestroy(&audio);
+  if (!morseWriterClose(&writer) || !written) {
+    return createError(arena, MORSE_FILE_WRITE_ERROR,
+                       "Could not write complete content to file");
+  }
+  return createSuccess(NULL, 0);
+}
+
+/* Synthesize the tones and write the WAV header to a new output */
+static Result startAudio(MorseArena *arena, const Options *options,
+                         MorseWriter *writer, MorseAudio *audio) {
+  if (morseAudioInit(audio, options->audio, &options->audioConfig, writer)) {
+    return createSuccess(NULL, 0);
+  }
+  bool outOfMemory = errno == ENOMEM;
+  morseAudioDestroy(audio);
+  return outOfMemory ? createError(arena, MORSE_MEMORY_ERROR,
+                                   "Memory allocation failed")
+                     : createError(arena, MORSE_FILE_WRITE_ERROR,
+                                   "Could not write complete content to file");
+}
+
+/* Start an output with the packed header, or on stdout with the banner
+ * unless --raw is given */
+static bool writeBanner(const Options *options, MorseWriter *writer,
+                        bool toStdout) {
+  if (options->packed) {
+    char header[MORSE_PACKED_HEADER_SIZE];
+    size_t length = morsePackedHeader(options->slashWordspacer, header);
+    return morseWriterWrite(writer, header, length);
+  }
+  if (!toStdout || options->raw || options->transcode) {
+    return true;
+  }
+  return morseWriterWrite(writer, options->decode ? "Decoded: " : "Encoded: ",
+                          9);
+}
+
+/* Stream piped or file input to stdout or the output file - ReqFunc08-12,
+ * ReqOptFunc01 */
+static Result streamInput(MorseArena *arena, const Options *options,
+                          MorseStats *stats) {
+  int inputFd = STDIN_FILENO;
+  if (!options->readFromPipe) {
+    inputFd = open(options->inputFile, O_RDONLY);
+    if (inputFd < 0) {
+      return createError(arena, MORSE_FILE_NOT_FOUND,
+                         "Could not open file '%s'", options->inputFile);
+    }
+  }
+
+  MorseWriter writer;
+  Result openResult = openOutput(arena, options, &writer);
+  if (openResult.hasError) {
+    if (inputFd != STDIN_FILENO) {
+      close(inputFd);
+    }
+    return openResult;
+  }
+
+  // Audio starts with its own header where the text would have a banner
+  MorseAudio audio;
+  bool playing = options->audio != MORSE_AUDIO_NONE;
+  if (playing) {
+    Result audioResult = startAudio(arena, options, &writer, &audio);
+    if (audioResult.hasError) {
+      morseWriterClose(&writer);
+      if (inputFd != STDIN_FILENO) {
+        close(inputFd);
+      }
+      return audioResult;
+    }
+  } else if (!options->lines &&
+             !writeBanner(options, &writer, options->outputFile == NULL)) {
+    morseWriterClose(&writer);
+    if (inputFd != STDIN_FILENO) {
+      close(inputFd);
+    }
+    return createError(arena, MORSE_FILE_WRITE_ERROR,
+                       "Could not write complete content to file");
+  }
+
+  StreamConverter converter;
+  Result result =
+      createConverter(arena, options, options->threadCount, &converter);
+  converter.writer = &writer;
+  converter.audio = playing ? &audio : NULL;
+  converter.stats = stats;
+  // Once the packed header is out, nothing is buffered for an output file,
+  // so a serial conversion can write its descriptor directly while the next
+  // input is being read
+  if (options->outputFile != NULL && !options->directOutput && !playing &&
+      !converter.parallel && morseWriterFlush(&writer)) {
+    converter.pipelineFd = morseWriterFd(&writer);
+  }
+  if (!result.hasError) {
+    result = convertInput(&converter, inputFd);
+  }
+  destroyConverter(&converter);
+
+  if (inputFd != STDIN_FILENO) {
+    close(inputFd);
+  }
+  if (playing) {
+    if (!result.hasError && !morseAudioFinish(&audio)) {
+      result = createError(arena, MORSE_FILE_WRITE_ERROR,
+                           "Could not write complete content to file");
+    }
+    morseAudioDestroy(&audio);
+  } else if (options->outputFile == NULL && !options->packed &&
+             !options->lines &&
+             (!result.hasError || result.errorCode == MORSE_MALFORMED_INPUT)) {
+    Result newlineResult = writeConverted(&converter, "\n", 1);
+    result = newlineResult.hasError ? newlineResult : result;
+  }
+  MorseStatsClock closeStart = morseStatsStart();
+  bool closed = morseWriterClose(&writer);
+  if (stats) {
+    morseStatsStop(stats, MORSE_PHASE_OUTPUT, closeStart);
+  }
+  if (!closed && !result.hasError) {
+    return createError(arena, MORSE_FILE_WRITE_ERROR,
+                       "Could not write complete content to file");
+  }
+  return result;
+}
+
+/* Allocate the buffers from arena, and with threadCount > 1 the worker
+ * pool, that convertInput() reuses for every input */
+static Result createConverter(MorseArena *arena, const Options *options,
+                              unsigned int threadCount,
+                              StreamConverter *converter) {
+  converter->arena = arena;
+  converter->decode = options->decode;
+  converter->slashWordspacer = options->slashWordspacer;
+  converter->useMmap = options->useMmap;
+  converter->packed = options->packed;
+  converter->transcode = options->transcode;
+  converter->lines = options->lines;
+  converter->strict = options->strict;
+  converter->malformed = (MalformedReport){NULL, 0, 0};
+  converter->keying = options->keyingInput;
+  converter->keyingWpm = options->audioConfig.wpm;
+  converter->alphabet = options->alphabet;
+  converter->cache = options->cache;
+  converter->tableHash = options->tableHash;
+  converter->directOutput = options->directOutput;
+  converter->storing = false;
+  converter->recordBanner = NULL;
+  if (options->outputFile == NULL && options->outputDir == NULL &&
+      !options->raw) {
+    converter->recordBanner = options->decode ? "Decoded: " : "Encoded: ";
+  }
+  converter->format = MORSE_FORMAT_TEXT;
+  converter->headerLength = 0;
+  converter->parallel = NULL;
+  converter->sliceSize = STREAM_CHUNK_SIZE;
+  converter->inputSize = STREAM_READ_MAX;
+  converter->writer = NULL;
+  converter->audio = NULL;
+  converter->pipelineFd = -1;
+  converter->stats = NULL;
+  if (converter->packed || converter->transcode || converter->lines ||
+      converter->strict || converter->keying || converter->alphabet) {
+    // A table lookup per byte keeps up with any output, a record is too
+    // short to share out, malformed symbols are reported in order, a
+    // timeline is classified by what came before, and a UTF-8 character
+    // may straddle any split
+    threadCount = 1;
+  }
+  if (threadCount > 1) {
+    converter->parallel = morseParallelCreate(threadCount);
+    converter->sliceSize = (size_t)threadCount * PARALLEL_SLICE_PER_THREAD;
+    converter->inputSize = converter->sliceSize;
+  }
+  converter->input = morseArenaAlloc(arena, converter->inputSize);
+  converter->converted = morseArenaAlloc(
+      arena, converter->alphabet
+                 ? MORSE_ALPHABET_ENCODE_BOUND(STREAM_CHUNK_SIZE)
+             : converter->transcode
+                 ? MORSE_PACKED_TEXT_BOUND(STREAM_CHUNK_SIZE)
+                 : MORSE_ENCODER_FEED_BOUND(STREAM_CHUNK_SIZE));
+
+  if (!converter->input || !converter->converted ||
+      (threadCount > 1 && !converter->parallel)) {
+    return createError(arena, MORSE_MEMORY_ERROR,
+                       "Memory allocation failed");
+  }
+  return createSuccess(NULL, 0);
+}
+
+/* Stop the worker pool; the buffers go with the arena */
+static void destroyConverter(StreamConverter *converter) {
+  morseParallelDestroy(converter->parallel);
+  converter->input = NULL;
+  converter->converted = NULL;
+  converter->parallel = NULL;
+}
+
+/* Convert everything inputFd delivers, starting from a fresh codec state.
+ * With --strict the output is complete even if MORSE_MALFORMED_INPUT is
+ * returned. */
+static Result convertInput(StreamConverter *converter, int inputFd) {
+  return converter->cache ? convertCached(converter, inputFd)
+                          : convertStream(converter, inputFd);
+}
+
+/* --cache: copy the result of a regular file from the cache, or convert it
+ * and store what is written. Other input cannot be hashed before its
+ * output starts, and is converted as it comes. */
+static Result convertCached(StreamConverter *converter, int inputFd) {
+#ifdef _WIN32
+  return convertStream(converter, inputFd);
+#else
+  struct stat inputStat;
+  if (fstat(inputFd, &inputStat) != 0 || !S_ISREG(inputStat.st_mode)) {
+    return convertStream(converter, inputFd);
+  }
+  size_t size = (size_t)inputStat.st_size;
+  MorseStatsClock hashStart = morseStatsStart();
+  const char *mapping =
+      size > 0 ? mmap(NULL, size, PROT_READ, MAP_PRIVATE, inputFd, 0) : "";
+  if (mapping == MAP_FAILED) {
+    return convertStream(converter, inputFd);
+  }
+  uint64_t key = morseCacheKey(
+      mapping, size,
+      cacheMode(converter->decode, converter->slashWordspacer,
+                converter->packed, converter->transcode),
+      converter->tableHash);
+  if (size > 0) {
+    munmap((void *)mapping, size);
+  }
+  if (converter->stats) {
+    morseStatsStop(converter->stats, MORSE_PHASE_INPUT, hashStart);
+  }
+
+  size_t cachedSize;
+  int cachedFd = morseCacheLookup(converter->cache, key, &cachedSize);
+  if (cachedFd >= 0) {
+    // Counted in bytes only: the symbols are in the result's first run
+    MorseStatsClock sendStart = morseStatsStart();
+    bool sent = morseCacheSend(cachedFd, cachedSize, converter->writer,
+                               converter->directOutput);
+    if (converter->stats) {
+      morseStatsStop(converter->stats, MORSE_PHASE_OUTPUT, sendStart);
+      converter->stats->bytesIn += (long long)size;
+      converter->stats->bytesOut += (long long)cachedSize;
+    }
+    if (!sent) {
+      return createError(converter->arena, MORSE_FILE_WRITE_ERROR,
+                         "Could not write complete content to file");
+    }
+    return createSuccess(NULL, 0);
+  }
+
+  // Every write goes through writeConverted() to be copied into the entry
+  int pipelineFd = converter->pipelineFd;
+  converter->pipelineFd = -1;
+  morseCacheBegin(converter->cache, key, &converter->cacheEntry);
+  converter->storing = true;
+  Result result = convertStream(converter, inputFd);
+  converter->storing = false;
+  converter->pipelineFd = pipelineFd;
+  if (result.hasError) {
+    morseCacheAbort(&converter->cacheEntry);
+  } else {
+    morseCacheCommit(&converter->cacheEntry);
+  }
+  return result;
+#endif
+}
+
+/* Convert inputFd with the codec, see convertInput() */
+static Result convertStream(StreamConverter *converter, int inputFd) {
+  morseEncoderInit(&converter->encoder, converter->slashWordspacer);
+  morseDecoderInit(&converter->decoder);
+  morseTranscoderInit(&converter->transcoder, converter->slashWordspacer);
+  if (converter->keying) {
+    morseKeyingInit(&converter->keyingReader, converter->keyingWpm);
+  }
+  if (converter->alphabet) {
+    morseAlphabetEncoderInit(&converter->alphabetEncoder, converter->alphabet,
+                             converter->slashWordspacer);
+    morseAlphabetDecoderInit(&converter->alphabetDecoder, converter->alphabet);
+  }
+  if (converter->strict) {
+    converter->malformed.base = 0;
+    converter->malformed.count = 0;
+    morseDecoderSetStrict(&converter->decoder, reportMalformed,
+                          &converter->malformed);
+  }
+  Result result = streamInputFd(converter, inputFd);
+  if (!result.hasError && converter->strict) {
+    result = checkMalformed(converter->arena, &converter->malformed);
+  }
+  return result;
+}
+
+/* Pick the input path for inputFd */
+static Result streamInputFd(StreamConverter *converter, int inputFd) {
+  converter->format =
+      readsPacked(converter) ? MORSE_FORMAT_UNDECIDED : MORSE_FORMAT_TEXT;
+  converter->headerLength = 0;
+  if (converter->stats) {
+    morseStatsBeginInput(converter->stats);
+  }
+  if (converter->lines) {
+    converter->format = MORSE_FORMAT_TEXT; // packed code has no lines
+    return streamLines(inputFd, converter);
+  }
+
+  struct stat inputStat;
+  if (inputFd != STDIN_FILENO && fstat(inputFd, &inputStat) == 0 &&
+      S_ISREG(inputStat.st_mode) && inputStat.st_size > 0 &&
+      (converter->useMmap || inputStat.st_size >= MMAP_MIN_SIZE)) {
+    return streamMapped(inputFd, (size_t)inputStat.st_size, converter);
+  }
+  if (converter->pipelineFd >= 0) {
+    return streamPipelined(inputFd, converter);
+  }
+  return streamRead(inputFd, converter);
+}
+
+/* Convert input read(2) straight into the input buffer; serial reads grow
+ * geometrically and are converted in sliceSize steps */
+static Result streamRead(int inputFd, StreamConverter *converter) {
+  char *input = converter->input;
+  Result result = createSuccess(NULL, 0);
+  size_t readSize = firstReadSize(inputFd, converter);
+  size_t filled = 0;
+  for (;;) {
+    // read(2) returns whatever the pipe holds, so serial output is not
+    // delayed until a full chunk has arrived. The parallel codec waits
+    // for full slices to give every thread enough work.
+    MorseStatsClock readStart = {0, 0};
+    if (converter->stats) {
+      readStart = morseStatsStart();
+    }
+    ssize_t bytesRead = read(inputFd, input + filled, readSize - filled);
+    if (converter->stats) {
+      morseStatsStop(converter->stats, MORSE_PHASE_INPUT, readStart);
+    }
+    if (bytesRead < 0 && errno == EINTR) {
+      continue;
+    }
+    if (bytesRead < 0) {
+      result = createError(converter->arena, MORSE_FILE_READ_ERROR,
+                           "Could not read input");
+      break;
+    }
+    filled += bytesRead;
+    if (filled > 0 && (bytesRead == 0 || !converter->parallel ||
+                       filled == converter->sliceSize)) {
+      for (size_t offset = 0; offset < filled && !result.hasError;
+           offset += converter->sliceSize) {
+        size_t sliceLength = filled - offset < converter->sliceSize
+                                 ? filled - offset
+                                 : converter->sliceSize;
+        result = convertSlice(converter, input + offset, sliceLength);
+      }
+      // A full read means more is waiting: ask for twice as much next time
+      if (filled == readSize && readSize < converter->inputSize) {
+        readSize = readSize * 2 < converter->inputSize ? readSize * 2
+                                                       : converter->inputSize;
+      }
+      filled = 0;
+      if (result.hasError) {
+        break;
+      }
+    }
+    if (bytesRead == 0) {
+      result = finishConversion(converter);
+      break;
+    }
+  }
+  return result;
+}
+
+/* Convert with the next chunk being read and the previous one written at
+ * the same time; falls back to streamRead() if no pipeline can be set up */
+static Result streamPipelined(int inputFd, StreamConverter *converter) {
+  size_t outputSize =
+      converter->alphabet
+          ? (converter->decode ? MORSE_ALPHABET_DECODE_BOUND(STREAM_READ_MAX)
+                               : MORSE_ALPHABET_ENCODE_BOUND(STREAM_READ_MAX))
+      : converter->transcode ? MORSE_PACKED_TEXT_BOUND(STREAM_READ_MAX)
+      : converter->decode    ? MORSE_DECODER_FEED_BOUND(STREAM_READ_MAX)
+                             : MORSE_ENCODER_FEED_BOUND(STREAM_READ_MAX);
+  MorsePipeline *pipeline = morsePipelineCreate(
+      inputFd, converter->pipelineFd, STREAM_READ_MAX, outputSize);
+  if (!pipeline) {
+    return streamRead(inputFd, converter);
+  }
+
+  // With --stats, input and output time is what conversion waited for
+  MorseStatsClock clock = {0, 0};
+  Result result = createSuccess(NULL, 0);
+  for (;;) {
+    if (converter->stats) {
+      clock = morseStatsStart();
+    }
+    size_t length;
+    const char *input = morsePipelineRead(pipeline, &length);
+    if (!input) {
+      result = createError(converter->arena, MORSE_FILE_READ_ERROR,
+                           "Could not read input");
+      break;
+    }
+    if (converter->stats) {
+      morseStatsStop(converter->stats, MORSE_PHASE_INPUT, clock);
+      clock = morseStatsStart();
+    }
+
+    // An empty chunk is the end of input: flush the codec
+    char *output = morsePipelineOutput(pipeline);
+    size_t outputLength;
+    size_t chunkLength = length;
+    detectFormat(converter, &input, &length);
+    if (chunkLength > 0) {
+      outputLength = convertSerial(converter, input, length, output);
+    } else {
+      outputLength = finishSerial(converter, output);
+    }
+    if (converter->stats) {
+      morseStatsStop(converter->stats, MORSE_PHASE_CONVERT, clock);
+      countSlice(converter, input, length, output, outputLength);
+      clock = morseStatsStart();
+    }
+    result = checkTranscoded(converter);
+    if (result.hasError) {
+      break;
+    }
+
+    bool written = morsePipelineWrite(pipeline, outputLength) &&
+                   (chunkLength > 0 || morsePipelineFinish(pipeline));
+    if (converter->stats) {
+      morseStatsStop(converter->stats, MORSE_PHASE_OUTPUT, clock);
+    }
+    if (!written) {
+      result = createError(converter->arena, MORSE_FILE_WRITE_ERROR,
+                           "Could not write complete content to file");
+      break;
+    }
+    if (chunkLength == 0) {
+      break;
+    }
+  }
+  morsePipelineDestroy(pipeline);
+  return result;
+}
+
+/* --lines: convert every line as a record of its own, from a fresh codec
+ * state, and write it out as soon as its newline has been read. A line
+ * longer than a read is converted piece by piece, so memory stays bounded
+ * however long the stream runs. */
+static Result streamLines(int inputFd, StreamConverter *converter) {
+  Result result = createSuccess(NULL, 0);
+  bool inRecord = false; // part of the current line has been converted
+  size_t streamOffset = 0; // of the next byte of data
+  while (!result.hasError) {
+    MorseStatsClock readStart = {0, 0};
+    if (converter->stats) {
+      readStart = morseStatsStart();
+    }
+    ssize_t bytesRead = read(inputFd, converter->input, STREAM_CHUNK_SIZE);
+    if (converter->stats) {
+      morseStatsStop(converter->stats, MORSE_PHASE_INPUT, readStart);
+    }
+    if (bytesRead < 0 && errno == EINTR) {
+      continue;
+    }
+    if (bytesRead < 0) {
+      return createError(converter->arena, MORSE_FILE_READ_ERROR,
+                         "Could not read input");
+    }
+    if (bytesRead == 0) {
+      // A last line without a newline is still a record
+      return inRecord ? endRecord(converter) : result;
+    }
+
+    const char *data = converter->input;
+    size_t remaining = (size_t)bytesRead;
+    while (remaining > 0 && !result.hasError) {
+      const char *newline = memchr(data, '\n', remaining);
+      size_t length = newline ? (size_t)(newline - data) : remaining;
+      if (!inRecord) {
+        // The decoder counts offsets from the start of the record
+        converter->malformed.base = streamOffset;
+        if (converter->recordBanner) {
+          result = writeConverted(converter, converter->recordBanner, 9);
+        }
+      }
+      inRecord = true;
+      if (!result.hasError) {
+        result = convertSlice(converter, data, length);
+      }
+      if (newline && !result.hasError) {
+        result = endRecord(converter);
+        inRecord = false;
+        length++;
+        if (converter->stats) {
+          converter->stats->bytesIn++;
+        }
+      }
+      data += length;
+      remaining -= length;
+      streamOffset += length;
+    }
+
+    // Everything read has been converted: let it out before blocking on
+    // the next read
+    if (!result.hasError && !morseWriterFlush(converter->writer)) {
+      result = createError(converter->arena, MORSE_FILE_WRITE_ERROR,
+                           "Could not write complete content to file");
+    }
+  }
+  return result;
+}
+
+/* Flush the codec at the end of a --lines record and end its output line */
+static Result endRecord(StreamConverter *converter) {
+  Result result = finishConversion(converter);
+  if (converter->stats) {
+    morseStatsBeginInput(converter->stats);
+  }
+  return result.hasError ? result : writeConverted(converter, "\n", 1);
+}
+
+/* Size of the first read(2) of a stream. A pipe is grown towards
+ * inputSize first, so a fast writer upstream can queue more per read;
+ * reading its whole capacity at once empties it in one call. */
+static size_t firstReadSize(int inputFd, const StreamConverter *converter) {
+  if (converter->parallel) {
+    return converter->inputSize;
+  }
+#ifdef F_SETPIPE_SZ
+  struct stat inputStat;
+  if (fstat(inputFd, &inputStat) == 0 && S_ISFIFO(inputStat.st_mode)) {
+    // Fails above /proc/sys/fs/pipe-max-size; the pipe then keeps its size
+    fcntl(inputFd, F_SETPIPE_SZ, (int)converter->inputSize);
+    int pipeSize = fcntl(inputFd, F_GETPIPE_SZ);
+    if (pipeSize > 0) {
+      return (size_t)pipeSize < converter->inputSize ? (size_t)pipeSize
+                                                     : converter->inputSize;
+    }
+  }
+#else
+  (void)inputFd;
+#endif
+  return converter->sliceSize;
+}
+
+/* Convert a regular file directly from a read-only mapping, without copying
+ * it into a heap buffer first */
+static Result streamMapped(int inputFd, size_t size,
+                           StreamConverter *converter) {
+#ifdef _WIN32
+  (void)size;
+  return streamRead(inputFd, converter);
+#else
+  // Page faults are taken while converting, so with --stats the input
+  // phase covers only setting the mapping up
+  MorseStatsClock mapStart = morseStatsStart();
+  char *mapping = mmap(NULL, size, PROT_READ, MAP_PRIVATE, inputFd, 0);
+  if (mapping == MAP_FAILED) {
+    // e.g. file systems without mmap support: fall back to read(2)
+    return streamRead(inputFd, converter);
+  }
+  madvise(mapping, size, MADV_SEQUENTIAL);
+  if (converter->stats) {
+    morseStatsStop(converter->stats, MORSE_PHASE_INPUT, mapStart);
+  }
+
+  // A trailing newline is left to the codec: text skips it, and in packed
+  // code it is a symbol
+  size_t length = size;
+  Result result = createSuccess(NULL, 0);
+  for (size_t offset = 0; offset < length && !result.hasError;
+       offset += converter->sliceSize) {
+    size_t sliceLength = length - offset < converter->sliceSize
+                             ? length - offset
+                             : converter->sliceSize;
+    result = convertSlice(converter, mapping + offset, sliceLength);
+  }
+  if (!result.hasError) {
+    result = finishConversion(converter);
+  }
+
+  munmap(mapping, size);
+  return result;
+#endif
+}
+
+/* Convert up to sliceSize bytes and write the result out */
+static Result convertSlice(StreamConverter *converter, const char *data,
+                           size_t length) {
+  detectFormat(converter, &data, &length);
+  Result checked = checkTranscoded(converter);
+  if (checked.hasError) {
+    return checked;
+  }
+  // Packed code needs no threads, but the converted buffer holds one
+  // STREAM_CHUNK_SIZE step
+  bool parallel = converter->parallel != NULL &&
+                  converter->format != MORSE_FORMAT_PACKED;
+  if (converter->parallel && !parallel && length > STREAM_CHUNK_SIZE) {
+    Result result = createSuccess(NULL, 0);
+    for (size_t offset = 0; offset < length && !result.hasError;
+         offset += STREAM_CHUNK_SIZE) {
+      size_t chunkLength = length - offset < STREAM_CHUNK_SIZE
+                               ? length - offset
+                               : STREAM_CHUNK_SIZE;
+      result = convertSlice(converter, data + offset, chunkLength);
+    }
+    return result;
+  }
+
+  MorseStatsClock convertStart = {0, 0};
+  if (converter->stats) {
+    convertStart = morseStatsStart();
+  }
+
+  const char *converted = converter->converted;
+  size_t convertedLength;
+  if (parallel) {
+    converted =
+        converter->decode
+            ? morseParallelDecode(converter->parallel, &converter->decoder,
+                                  data, length, &convertedLength)
+            : morseParallelEncode(converter->parallel, &converter->encoder,
+                                  data, length, &convertedLength);
+    if (!converted) {
+      return createError(converter->arena, MORSE_MEMORY_ERROR,
+                         "Memory allocation failed");
+    }
+  } else {
+    convertedLength =
+        convertSerial(converter, data, length, converter->converted);
+  }
+
+  if (converter->stats) {
+    morseStatsStop(converter->stats, MORSE_PHASE_CONVERT, convertStart);
+    countSlice(converter, data, length, converted, convertedLength);
+  }
+  // What text before a layout error converted to is still written
+  Result result = writeConverted(converter, converted, convertedLength);
+  return result.hasError ? result : checkTranscoded(converter);
+}
+
+/* Flush what the decoder still holds at end of input */
+static Result finishConversion(StreamConverter *converter) {
+  size_t convertedLength = finishSerial(converter, converter->converted);
+  if (converter->stats) {
+    countSlice(converter, NULL, 0, converter->converted, convertedLength);
+  }
+  Result result =
+      writeConverted(converter, converter->converted, convertedLength);
+  return result.hasError ? result : checkTranscoded(converter);
+}
+
+/* --transcode: the error of input that has no conversion to the other
+ * format, if any */
+static Result checkTranscoded(StreamConverter *converter) {
+  if (!converter->transcode) {
+    return createSuccess(NULL, 0);
+  }
+  if (!converter->packed && converter->format == MORSE_FORMAT_TEXT) {
+    return createError(converter->arena, MORSE_INVALID_INPUT,
+                       "Input is not packed Morse code; transcode text "
+                       "with --format=packed");
+  }
+  if (converter->transcoder.failed) {
+    return createError(converter->arena, MORSE_INVALID_INPUT,
+                       "Not Morse code as the encoder writes it at offset "
+                       "%zu (word spacer %s, see --slash-wordspacer)",
+                       converter->transcoder.errorOffset,
+                       converter->slashWordspacer ? "\" / \"" : "\"   \"");
+  }
+  return createSuccess(NULL, 0);
+}
+
+/* Input that may be packed code: decoding, and transcoding to text */
+static bool readsPacked(const StreamConverter *converter) {
+  if (converter->transcode) {
+    return !converter->packed;
+  }
+  return converter->decode && !converter->keying && !converter->alphabet;
+}
+
+/* Tell packed from text input by its first bytes. Bytes that may still
+ * start a header are held back and *data is advanced past them; the first
+ * byte that cannot is left for the text decoder. */
+static void detectFormat(StreamConverter *converter, const char **data,
+                         size_t *length) {
+  while (converter->format == MORSE_FORMAT_UNDECIDED && *length > 0) {
+    converter->header[converter->headerLength] = **data;
+    converter->format =
+        morsePackedDetect(converter->header, converter->headerLength + 1);
+    if (converter->format == MORSE_FORMAT_TEXT) {
+      break;
+    }
+    converter->headerLength++;
+    (*data)++;
+    (*length)--;
+    if (converter->stats) {
+      converter->stats->bytesIn++;
+    }
+    if (converter->format == MORSE_FORMAT_PACKED && converter->transcode) {
+      // The text gets the word spacer the packed code was encoded with
+      morseTranscoderInit(&converter->transcoder,
+                          morsePackedHeaderSlash(converter->header));
+    }
+  }
+  if (converter->format == MORSE_FORMAT_TEXT && !converter->transcode) {
+    releaseHeader(converter);
+  }
+}
+
+/* Give a header prefix that turned out to be text to the text decoder. It
+ * holds no space or slash, so it decodes to nothing and only leaves the
+ * decoder inside an undecodable symbol. */
+static void releaseHeader(StreamConverter *converter) {
+  if (converter->headerLength > 0) {
+    if (converter->stats) {
+      morseStatsCountMorse(converter->stats, converter->header,
+                           converter->headerLength);
+    }
+    morseDecoderFeed(&converter->decoder, converter->header,
+                     converter->headerLength, converter->converted);
+    converter->headerLength = 0;
+  }
+  converter->format = MORSE_FORMAT_TEXT;
+}
+
+/* Feed length bytes to the encoder or decoder on the calling thread */
+static size_t convertSerial(StreamConverter *converter, const char *data,
+                            size_t length, char *out) {
+  if (converter->keying) {
+    return morseKeyingDecode(&converter->keyingReader, data, length, out);
+  }
+  if (converter->transcode) {
+    return converter->packed
+               ? morsePackedFromText(&converter->transcoder, data, length, out)
+               : morsePackedToText(&converter->transcoder, data, length, out);
+  }
+  if (converter->alphabet) {
+    return converter->decode
+               ? morseAlphabetDecode(&converter->alphabetDecoder, data,
+                                     length, out)
+               : morseAlphabetEncode(&converter->alphabetEncoder, data,
+                                     length, out);
+  }
+  if (converter->decode) {
+    return converter->format == MORSE_FORMAT_PACKED
+               ? morsePackedDecode(data, length, out)
+               : morseDecoderFeed(&converter->decoder, data, length, out);
+  }
+  return converter->packed
+             ? morsePackedEncode(&converter->encoder, data, length, out)
+             : morseEncoderFeed(&converter->encoder, data, length, out);
+}
+
+/* Flush the codec at end of input; packed tokens leave nothing pending */
+static size_t finishSerial(StreamConverter *converter, char *out) {
+  if (converter->transcode) {
+    if (converter->format == MORSE_FORMAT_UNDECIDED &&
+        converter->headerLength > 0) {
+      converter->format = MORSE_FORMAT_TEXT; // shorter than a header
+    }
+    return converter->packed
+               ? morsePackedFromTextFinish(&converter->transcoder, out)
+               : 0;
+  }
+  if (converter->alphabet) {
+    return converter->decode
+               ? morseAlphabetDecoderFinish(&converter->alphabetDecoder, out)
+               : morseAlphabetEncoderFinish(&converter->alphabetEncoder, out);
+  }
+  if (!converter->decode) {
+    return morseEncoderFinish(&converter->encoder, out);
+  }
+  if (converter->keying) {
+    return morseKeyingFinish(&converter->keyingReader, out);
+  }
+  if (converter->format == MORSE_FORMAT_PACKED) {
+    return 0;
+  }
+  // Input shorter than a header is text after all
+  releaseHeader(converter);
+  return morseDecoderFinish(&converter->decoder, out);
+}
+
+/* --stats counters of one converted slice; the plain text side is the
+ * input when encoding and the output when decoding */
+static void countSlice(StreamConverter *converter, const char *input,
+                       size_t inputLength, const char *converted,
+                       size_t convertedLength) {
+  MorseStats *stats = converter->stats;
+  stats->bytesIn += (long long)inputLength;
+  stats->bytesOut += (long long)convertedLength;
+  if (converter->transcode) {
+    // Symbols, words and '*' of the code, read off its packed side
+    if (converter->packed) {
+      morseStatsCountTokens(stats, converted, convertedLength);
+    } else {
+      morseStatsCountTokens(stats, input, inputLength);
+    }
+  } else if (converter->alphabet) {
+    // A symbol of a table may be several bytes of text, the prosign <SK>
+    // or a two-byte letter, so the codec counts symbols; the text gives
+    // the words
+    MorseAlphabetCounts *counts = converter->decode
+                                      ? &converter->alphabetDecoder.counts
+                                      : &converter->alphabetEncoder.counts;
+    long long symbols = stats->symbols;
+    if (converter->decode) {
+      morseStatsCountText(stats, converted, convertedLength, false);
+      stats->morseSymbols += (long long)(counts->symbols + counts->unknown);
+    } else {
+      morseStatsCountText(stats, input, inputLength, false);
+      stats->unsupported += (long long)counts->unknown;
+    }
+    stats->symbols = symbols + (long long)counts->symbols;
+    *counts = (MorseAlphabetCounts){0, 0};
+  } else if (converter->decode) {
+    if (converter->format == MORSE_FORMAT_PACKED) {
+      morseStatsCountPacked(stats, input, inputLength);
+    } else if (!converter->keying) {
+      morseStatsCountMorse(stats, input, inputLength);
+    }
+    morseStatsCountText(stats, converted, convertedLength, false);
+  } else {
+    morseStatsCountText(stats, input, inputLength, true);
+  }
+}
+
+/* Hand converted bytes to the writer; pipeline consumers see them at once,
+ * file output is collected into large writes */
+static Result writeConverted(StreamConverter *converter, const char *data,
+                             size_t length) {
+  MorseStatsClock outputStart = {0, 0};
+  if (converter->stats) {
+    outputStart = morseStatsStart();
+  }
+  bool written = converter->audio
+                     ? morseAudioFeed(converter->audio, data, length)
+                     : morseWriterWrite(converter->writer, data, length);
+  if (converter->stats) {
+    morseStatsStop(converter->stats, MORSE_PHASE_OUTPUT, outputStart);
+  }
+  if (!written) {
+    return createError(converter->arena, MORSE_FILE_WRITE_ERROR,
+                       "Could not write complete content to file");
+  }
+  if (converter->storing) {
+    morseCacheAppend(&converter->cacheEntry, data, length);
+  }
+  return createSuccess(NULL, 0);
+}
+
+/* Parse the -j, --threads argument; 0 selects one thread per CPU core */
+static Result parseThreadCount(MorseArena *arena, const char *text,
+                               unsigned int *threadCount) {
+  char *end;
+  errno = 0;
+  unsigned long value = strtoul(text, &end, 10);
+  if (errno != 0 || end == text || *end != '\0' || text[0] == '-' ||
+      value > MAX_THREADS) {
+    return createError(arena, MORSE_INVALID_OPTION, "Invalid thread count");
+  }
+  if (value == 0) {
+    long cores = sysconf(_SC_NPROCESSORS_ONLN);
+    value = cores > 0 ? (unsigned long)cores : 1;
+  }
+  *threadCount = (unsigned int)value;
+  return createSuccess(NULL, 0);
+}
+
+/* Parse the --cache-size argument: bytes, or with a K, M or G suffix */
+static Result parseCacheSize(MorseArena *arena, const char *text,
+                             size_t *size) {
+  char *end;
+  errno = 0;
+  unsigned long long value = strtoull(text, &end, 10);
+  unsigned int shift = 0;
+  if (end != text) {
+    shift = *end == 'K' ? 10 : *end == 'M' ? 20 : *end == 'G' ? 30 : 0;
+    end += shift != 0;
+  }
+  if (errno != 0 || end == text || *end != '\0' || text[0] == '-' ||
+      value == 0 || value > (SIZE_MAX >> shift)) {
+    return createError(arena, MORSE_INVALID_OPTION,
+                       "Invalid --cache-size '%s'", text);
+  }
+  *size = (size_t)value << shift;
+  return createSuccess(NULL, 0);
+}
+
+/* Parse a number of --wpm, --tone, --sample-rate or --channels within
+ * [minimum, maximum] */
+static Result parseAudioValue(MorseArena *arena, const char *option,
+                              const char *text, unsigned int minimum,
+                              unsigned int maximum, unsigned int *value) {
+  char *end;
+  errno = 0;
+  unsigned long number = strtoul(text, &end, 10);
+  if (errno != 0 || end == text || *end != '\0' || text[0] == '-' ||
+      number < minimum || number > maximum) {
+    return createError(arena, MORSE_INVALID_OPTION,
+                       "Invalid %s '%s' (%u to %u)", option, text, minimum,
+                       maximum);
+  }
+  *value = (unsigned int)number;
+  return createSuccess(NULL, 0);
+}
+
+/* Convert every positional and --batch listed file. Errors are reported
+ * per file and the batch carries on with the next one. */
+static Result convertBatch(MorseArena *arena, const Options *options,
+                           MorseStats *stats) {
+  char **files = options->inputFiles;
+  size_t fileCount = options->inputFileCount;
+  if (options->batchList) {
+    char **listed = NULL;
+    size_t listedCount = 0;
+    Result listResult =
+        readBatchList(arena, options->batchList, &listed, &listedCount);
+    if (listResult.hasError) {
+      return listResult;
+    }
+    files = morseArenaAlloc(arena, (fileCount + listedCount) * sizeof(char *));
+    if (!files) {
+      return createError(arena, MORSE_MEMORY_ERROR,
+                         "Memory allocation failed");
+    }
+    memcpy(files, options->inputFiles, fileCount * sizeof(char *));
+    memcpy(files + fileCount, listed, listedCount * sizeof(char *));
+    fileCount += listedCount;
+  }
+
+  if (options->outputDir) {
+#ifdef _WIN32
+    mkdir(options->outputDir);
+#else
+    mkdir(options->outputDir, 0777); // EEXIST is fine
+#endif
+  }
+
+  BatchQueue queue = {options, files, fileCount, 0, false, stats,
+                      PTHREAD_MUTEX_INITIALIZER};
+
+  // Files are independent with --out-dir, so -j spreads whole files over
+  // the threads. Otherwise the results share one output in order and -j
+  // goes to the parallel codec instead.
+  unsigned int workerCount = 1;
+  if (options->outputDir && options->threadCount > 1) {
+    workerCount = options->threadCount;
+    if (workerCount > fileCount) {
+      workerCount = (unsigned int)fileCount;
+    }
+  }
+  pthread_t *workers = NULL;
+  unsigned int started = 0;
+  if (workerCount > 1) {
+    workers = morseArenaAlloc(arena, (workerCount - 1) * sizeof(pthread_t));
+    for (; workers && started < workerCount - 1; started++) {
+      if (pthread_create(&workers[started], NULL, batchWorker, &queue) != 0) {
+        break; // carry on with the threads we have
+      }
+    }
+  }
+  batchWorker(&queue);
+  for (unsigned int i = 0; i < started; i++) {
+    pthread_join(workers[i], NULL);
+  }
+  pthread_mutex_destroy(&queue.lock);
+
+  if (queue.failed) {
+    // Every failure has been reported with its file name already
+    return createError(arena, MORSE_FILE_READ_ERROR, NULL);
+  }
+  return createSuccess(NULL, 0);
+}
+
+/* Read the --batch list: one path per line, blank lines skipped */
+static Result readBatchList(MorseArena *arena, const char *path,
+                            char ***files, size_t *count) {
+  FILE *list = fopen(path, "r");
+  if (!list) {
+    return createError(arena, MORSE_FILE_NOT_FOUND,
+                       "Could not open file '%s'", path);
+  }
+
+  char line[MAX_OUTPUT_PATH];
+  size_t capacity = 0;
+  *files = NULL;
+  *count = 0;
+  while (fgets(line, sizeof(line), list)) {
+    line[strcspn(line, "\r\n")] = '\0';
+    if (line[0] == '\0') {
+      continue;
+    }
+    if (*count == capacity) {
+      // The old array stays in the arena; doubling keeps that O(n)
+      capacity = capacity ? capacity * 2 : 64;
+      char **grown = morseArenaAlloc(arena, capacity * sizeof(char *));
+      if (grown) {
+        memcpy(grown, *files, *count * sizeof(char *));
+        *files = grown;
+      }
+    }
+    char *copy = morseArenaStrdup(arena, line);
+    if (*count == capacity || !copy) {
+      fclose(list);
+      return createError(arena, MORSE_MEMORY_ERROR,
+                         "Memory allocation failed");
+    }
+    (*files)[(*count)++] = copy;
+  }
+
+  bool readFailed = ferror(list);
+  fclose(list);
+  if (readFailed) {
+    return createError(arena, MORSE_FILE_READ_ERROR,
+                       "Could not read batch list");
+  }
+  return createSuccess(*files, *count * sizeof(char *));
+}
+
+/* Take files off the queue until it is empty. Each worker owns one arena,
+ * one converter and, with --out-dir, one writer reopened for every file.
+ * Whatever a file allocates is released by rewinding the arena. */
+static void *batchWorker(void *argument) {
+  BatchQueue *queue = argument;
+  const Options *options = queue->options;
+  bool parallelCodec = !options->outputDir && options->threadCount > 1;
+
+  MorseArena arena;
+  morseArenaInit(&arena, MORSE_ARENA_BLOCK_SIZE);
+  MorseStats workerStats;
+  morseStatsInit(&workerStats);
+  StreamConverter converter;
+  Result result =
+      createConverter(&arena, options,
+                      parallelCodec ? options->threadCount : 1, &converter);
+  converter.stats = queue->stats ? &workerStats : NULL;
+  MorseWriter writer;
+  bool writerOpen = false;
+  if (!result.hasError && !options->outputDir) {
+    result = openOutput(&arena, options, &writer);
+    writerOpen = !result.hasError;
+    // Shared packed output is one stream with one header
+    if (writerOpen && options->packed &&
+        !writeBanner(options, &writer, false)) {
+      result = createError(&arena, MORSE_FILE_WRITE_ERROR,
+                           "Could not write complete content to file");
+    }
+  }
+  MorseArenaMark jobStart = morseArenaMark(&arena);
+
+  for (;;) {
+    pthread_mutex_lock(&queue->lock);
+    size_t index = queue->next < queue->fileCount && !result.hasError
+                       ? queue->next++
+                       : queue->fileCount;
+    pthread_mutex_unlock(&queue->lock);
+    if (index == queue->fileCount) {
+      break;
+    }
+
+    const char *path = queue->files[index];
+    Result fileResult =
+        convertBatchFile(queue, &converter, &writer, &writerOpen, path);
+    if (fileResult.hasError) {
+      if (fileResult.errorMessage) {
+        fprintf(stderr, "%s: %s: %s\n", errorContext(fileResult.errorCode),
+                path, fileResult.errorMessage);
+      }
+      pthread_mutex_lock(&queue->lock);
+      queue->failed = true;
+      pthread_mutex_unlock(&queue->lock);
+    }
+    morseArenaRewind(&arena, jobStart);
+  }
+
+  MorseStatsClock closeStart = morseStatsStart();
+  if (writerOpen && !morseWriterClose(&writer) && !result.hasError) {
+    result = createError(&arena, MORSE_FILE_WRITE_ERROR,
+                         "Could not write complete content to file");
+  }
+  destroyConverter(&converter);
+  if (queue->stats) {
+    morseStatsStop(&workerStats, MORSE_PHASE_OUTPUT, closeStart);
+    pthread_mutex_lock(&queue->lock);
+    morseStatsMerge(queue->stats, &workerStats);
+    pthread_mutex_unlock(&queue->lock);
+  }
+  if (result.hasError) {
+    // Setup failed before any file could be converted
+    if (result.errorMessage) {
+      fprintf(stderr, "%s: %s\n", errorContext(result.errorCode),
+              result.errorMessage);
+    }
+    pthread_mutex_lock(&queue->lock);
+    queue->failed = true;
+    pthread_mutex_unlock(&queue->lock);
+  }
+  morseArenaDestroy(&arena);
+  return NULL;
+}
+
+/* Convert one batch file into DIR/<file name>, or append it as one line to
+ * the shared output */
+static Result convertBatchFile(BatchQueue *queue, StreamConverter *converter,
+                               MorseWriter *writer, bool *writerOpen,
+                               const char *path) {
+  const Options *options = queue->options;
+  MorseArena *arena = converter->arena;
+  int inputFd = open(path, O_RDONLY);
+  if (inputFd < 0) {
+    return createError(arena, MORSE_FILE_NOT_FOUND, "Could not open file");
+  }
+
+  if (options->outputDir) {
+    const char *name = strrchr(path, '/');
+    name = name ? name + 1 : path;
+    char *outputPath =
+        morseArenaPrintf(arena, "%s/%s", options->outputDir, name);
+    unsigned int flags = options->directOutput ? MORSE_WRITER_DIRECT : 0;
+    bool opened = false;
+    if (outputPath && strlen(outputPath) < MAX_OUTPUT_PATH) {
+      opened = *writerOpen ? morseWriterReopen(writer, outputPath, flags)
+                           : morseWriterOpenFile(writer, outputPath, flags);
+    }
+    if (!opened) {
+      close(inputFd);
+      return createError(arena, MORSE_FILE_WRITE_ERROR,
+                         "Could not open file '%s/%s' for writing",
+                         options->outputDir, name);
+    }
+    *writerOpen = true;
+    if (!writeBanner(options, writer, false)) {
+      close(inputFd);
+      return createError(arena, MORSE_FILE_WRITE_ERROR,
+                         "Could not write complete content to file");
+    }
+  } else if (!options->packed && !options->lines &&
+             !writeBanner(options, writer, options->outputFile == NULL)) {
+    close(inputFd);
+    return createError(arena, MORSE_FILE_WRITE_ERROR,
+                       "Could not write complete content to file");
+  }
+
+  converter->writer = writer;
+  converter->malformed.name = path;
+  Result result = convertInput(converter, inputFd);
+  close(inputFd);
+
+  MorseStatsClock finishStart = morseStatsStart();
+  bool written = options->outputDir ? morseWriterFinish(writer)
+                                    : options->packed || options->lines ||
+                                          morseWriterWrite(writer, "\n", 1);
+  if (converter->stats) {
+    morseStatsStop(converter->stats, MORSE_PHASE_OUTPUT, finishStart);
+  }
+  if (!written && !result.hasError) {
+    return createError(arena, MORSE_FILE_WRITE_ERROR,
+                       "Could not write complete content to file");
+  }
+  return result;
+}
+
+/* Prefix for error messages, naming the stage that failed */
+static const char *errorContext(MorseError errorCode) {
+  switch (errorCode) {
+  case MORSE_FILE_NOT_FOUND:
+  case MORSE_FILE_READ_ERROR:
+  case MORSE_MALFORMED_INPUT:
+    return "Input Error";
+  case MORSE_FILE_WRITE_ERROR:
+    return "Output Error";
+  default:
+    return "Processing Error";
+  }
+}
+
+/* Encode text to Morse code - ReqFunc13-21, ReqFunc23, ReqFunc25-28,
+ * ReqOptFunc02. Packed tokens come without their header, which
+ * writeOutput() writes. */
+static Result encodeText(MorseArena *arena, const char *text, size_t length,
+                         bool useSlashWordspacer, bool packed) {
+  // Sizing pass first: the buffer holds exactly the encoded text
+  unsigned int flags = (useSlashWordspacer ? MORSE_SLASH_WORDSPACER : 0) |
+                       (packed ? MORSE_PACKED : 0);
+  size_t encodedLength = morseEncode(text, length, NULL, 0, flags);
+  char *result = morseArenaAlloc(arena, encodedLength);
+  if (!result) {
+    return createError(arena, MORSE_MEMORY_ERROR, "Memory allocation failed");
+  }
+
+  morseEncode(text, length, result, encodedLength, flags);
+  size_t header = packed ? MORSE_PACKED_HEADER_SIZE : 0;
+  return createSuccess(result + header, encodedLength - header);
+}
+
+/* Decode Morse code to text - ReqFunc14, ReqFunc16, ReqFunc18, ReqFunc20,
+ * ReqFunc22, ReqFunc24. With a report, decoding is strict. */
+static Result decodeText(MorseArena *arena, const char *morse,
+                         size_t length, MalformedReport *report) {
+  if (report) {
+    // Sized for the worst case: every symbol is reported exactly once
+    char *result = morseArenaAlloc(arena, MORSE_DECODER_FEED_BOUND(length) +
+                                              MORSE_FINISH_BOUND);
+    if (!result) {
+      return createError(arena, MORSE_MEMORY_ERROR,
+                         "Memory allocation failed");
+    }
+    MorseDecoder decoder;
+    morseDecoderInit(&decoder);
+    morseDecoderSetStrict(&decoder, reportMalformed, report);
+    size_t decodedLength = morseDecoderFeed(&decoder, morse, length, result);
+    decodedLength += morseDecoderFinish(&decoder, result + decodedLength);
+    return createSuccess(result, decodedLength);
+  }
+
+  size_t decodedLength = morseDecode(morse, length, NULL, 0, 0);
+  char *result = morseArenaAlloc(arena, decodedLength);
+  if (!result) {
+    return createError(arena, MORSE_MEMORY_ERROR, "Memory allocation failed");
+  }
+
+  morseDecode(morse, length, result, decodedLength, 0);
+  return createSuccess(result, decodedLength);
+}
+
+/* -d --format=keying: decode a keying timeline argument */
+static Result decodeKeying(MorseArena *arena, const char *timeline,
+                           size_t length, unsigned int wpm) {
+  char *result = morseArenaAlloc(arena, MORSE_KEYING_FEED_BOUND(length) + 1);
+  if (!result) {
+    return createError(arena, MORSE_MEMORY_ERROR, "Memory allocation failed");
+  }
+  MorseKeyingReader reader;
+  morseKeyingInit(&reader, wpm);
+  size_t decodedLength = morseKeyingDecode(&reader, timeline, length, result);
+  decodedLength += morseKeyingFinish(&reader, result + decodedLength);
+  return createSuccess(result, decodedLength);
+}
+
+/* --table: encode or decode an argument with the code table */
+static Result convertWithTable(MorseArena *arena, const Options *options,
+                               const char *input, size_t length,
+                               MorseAlphabetCounts *counts) {
+  size_t bound = options->decode ? MORSE_ALPHABET_DECODE_BOUND(length)
+                                 : MORSE_ALPHABET_ENCODE_BOUND(length);
+  char *result = morseArenaAlloc(arena, bound + MORSE_ALPHABET_FINISH_BOUND);
+  if (!result) {
+    return createError(arena, MORSE_MEMORY_ERROR, "Memory allocation failed");
+  }
+  size_t convertedLength;
+  if (options->decode) {
+    MorseAlphabetDecoder decoder;
+    morseAlphabetDecoderInit(&decoder, options->alphabet);
+    convertedLength = morseAlphabetDecode(&decoder, input, length, result);
+    convertedLength +=
+        morseAlphabetDecoderFinish(&decoder, result + convertedLength);
+    *counts = decoder.counts;
+  } else {
+    MorseAlphabetEncoder encoder;
+    morseAlphabetEncoderInit(&encoder, options->alphabet,
+                             options->slashWordspacer);
+    convertedLength = morseAlphabetEncode(&encoder, input, length, result);
+    convertedLength +=
+        morseAlphabetEncoderFinish(&encoder, result + convertedLength);
+    *counts = encoder.counts;
+  }
+  return createSuccess(result, convertedLength);
+}
+
+/* --transcode of an argument: text Morse code to packed tokens, without
+ * the header as in encodeText(). An argument cannot hold packed code,
+ * which starts with a NUL byte. */
+static Result transcodeText(MorseArena *arena, const Options *options,
+                            const char *morse, size_t length) {
+  if (!options->packed) {
+    return createError(arena, MORSE_INVALID_INPUT,
+                       "Input is not packed Morse code; transcode text "
+                       "with --format=packed");
+  }
+  char *result = morseArenaAlloc(arena, MORSE_PACKED_FEED_BOUND(length) +
+                                            MORSE_PACKED_FINISH_BOUND);
+  if (!result) {
+    return createError(arena, MORSE_MEMORY_ERROR, "Memory allocation failed");
+  }
+  MorseTranscoder transcoder;
+  morseTranscoderInit(&transcoder, options->slashWordspacer);
+  size_t written = morsePackedFromText(&transcoder, morse, length, result);
+  written += morsePackedFromTextFinish(&transcoder, result + written);
+  if (transcoder.failed) {
+    return createError(arena, MORSE_INVALID_INPUT,
+                       "Not Morse code as the encoder writes it at offset "
+                       "%zu (word spacer %s, see --slash-wordspacer)",
+                       transcoder.errorOffset,
+                       options->slashWordspacer ? "\" / \"" : "\"   \"");
+  }
+  return createSuccess(result, written);
+}
+
+/* --table: a built-in table by name, or one compiled from a file into the
+ * arena */
+static Result loadTable(MorseArena *arena, const char *table,
+                        const MorseAlphabet **alphabet, uint64_t *hash) {
+  for (size_t i = 0; MORSE_BUILTIN_ALPHABETS[i]; i++) {
+    if (strcmp(MORSE_BUILTIN_ALPHABETS[i]->name, table) == 0) {
+      *alphabet = MORSE_BUILTIN_ALPHABETS[i];
+      *hash = morseHash64((*alphabet)->strings, strlen((*alphabet)->strings),
+                          0);
+      return createSuccess(NULL, 0);
+    }
+  }
+
+  FILE *file = fopen(table, "rb");
+  if (!file) {
+    return createError(arena, MORSE_FILE_NOT_FOUND,
+                       "Invalid --table '%s' (itu, extended or a file)",
+                       table);
+  }
+  // One byte more than a table may have, so a larger one is rejected
+  char *text = morseArenaAlloc(arena, MORSE_ALPHABET_MAX_TABLE_SIZE + 1);
+  MorseAlphabet *compiled = morseArenaAlloc(arena, sizeof(*compiled));
+  if (!text || !compiled) {
+    fclose(file);
+    return createError(arena, MORSE_MEMORY_ERROR, "Memory allocation failed");
+  }
+  size_t length = fread(text, 1, MORSE_ALPHABET_MAX_TABLE_SIZE + 1, file);
+  bool readFailed = ferror(file);
+  fclose(file);
+  if (readFailed) {
+    return createError(arena, MORSE_FILE_READ_ERROR,
+                       "Could not read table '%s'", table);
+  }
+  char error[MORSE_ALPHABET_ERROR_SIZE];
+  if (!morseAlphabetCompile(compiled, table, text, length, error)) {
+    return createError(arena, MORSE_INVALID_OPTION, "Invalid --table '%s': %s",
+                       table, error);
+  }
+  *alphabet = compiled;
+  *hash = morseHash64(text, length, 0);
+  return createSuccess(NULL, 0);
+}
+
+/* morseCacheKey() mode of a conversion */
+static unsigned int cacheMode(bool decode, bool slashWordspacer, bool packed,
+                              bool transcode) {
+  return (decode ? MORSE_CACHE_DECODE : 0) |
+         (slashWordspacer ? MORSE_CACHE_SLASH : 0) |
+         (packed ? MORSE_CACHE_PACKED : 0) |
+         (transcode ? MORSE_CACHE_TRANSCODE : 0);
+}
+
+/* --strict: called by the decoder for every symbol it drops */
+static void reportMalformed(void *context, size_t offset) {
+  MalformedReport *report = context;
+  report->count++;
+  fprintf(stderr, "Input Error: %s%sMalformed Morse symbol at offset %zu\n",
+          report->name ? report->name : "", report->name ? ": " : "",
+          report->base + offset);
+}
+
+/* --strict: fail an input once every malformed symbol has been reported */
+static Result checkMalformed(MorseArena *arena,
+                             const MalformedReport *report) {
+  if (report->count == 0) {
+    return createSuccess(NULL, 0);
+  }
+  return createError(arena, MORSE_MALFORMED_INPUT,
+                     "%zu malformed Morse symbol%s", report->count,
+                     report->count == 1 ? "" : "s");
+}
@@ -0,0 +1,479 @@
+/**
+ * @file morse_alphabet.c
+ * @brief Compiler of code tables, and the codec that runs on them
+ * @author Diego Rubio Carrera
+ *
+ * Also linked into tools/morse_gentables.c, which compiles the tables of
+ * tables/ with it at build time, so nothing here may use the generated
+ * tables.
+ */
+
+#include <morse_alphabet.h>
+#include <morse_tables.h>
+#include <stdio.h>
+#include <string.h>
+
+static bool compileLine(MorseAlphabet *alphabet, const char *line,
+                        size_t length, size_t offset, unsigned int *prosigns,
+                        char *error);
+static bool readCodePoint(const char *text, size_t length,
+                          unsigned long *codePoint);
+static unsigned long lowerCase(unsigned long codePoint);
+static unsigned int prosignSlot(const MorseAlphabet *alphabet,
+                                const char *name, size_t length);
+static char upperCase(char c);
+static bool isProsignCharacter(char c);
+static char *encodeSymbol(MorseAlphabetEncoder *encoder,
+                          MorseAlphabetString code, char *cursor);
+static char *encodeAscii(MorseAlphabetEncoder *encoder, char c,
+                         char *cursor);
+static char *releaseHeld(MorseAlphabetEncoder *encoder, char *cursor);
+static size_t flushSymbol(MorseAlphabetDecoder *decoder, char *out);
+
+/* Smallest code point of an n-byte UTF-8 sequence; shorter forms of it
+ * are overlong and malformed */
+static const unsigned long SEQUENCE_MINIMUM[5] = {0, 0, 0x80, 0x800,
+                                                  0x10000};
+
+static const MorseAlphabetString NO_STRING = {0, 0};
+
+bool morseAlphabetCompile(MorseAlphabet *alphabet, const char *name,
+                          const char *text, size_t length, char *error) {
+  memset(alphabet, 0, sizeof(*alphabet));
+  alphabet->name = name;
+  alphabet->strings = text;
+  if (length > MORSE_ALPHABET_MAX_TABLE_SIZE) {
+    snprintf(error, MORSE_ALPHABET_ERROR_SIZE,
+             "table is larger than %d bytes", MORSE_ALPHABET_MAX_TABLE_SIZE);
+    return false;
+  }
+
+  unsigned int prosigns = 0;
+  unsigned int lineNumber = 1;
+  for (size_t start = 0; start < length; lineNumber++) {
+    const char *newline = memchr(text + start, '\n', length - start);
+    size_t end = newline ? (size_t)(newline - text) : length;
+    char lineError[MORSE_ALPHABET_ERROR_SIZE];
+    if (!compileLine(alphabet, text + start, end - start, start, &prosigns,
+                     lineError)) {
+      snprintf(error, MORSE_ALPHABET_ERROR_SIZE, "line %u: %.100s",
+               lineNumber, lineError);
+      return false;
+    }
+    start = end + 1;
+  }
+
+  // ReqFunc15: the other case of a letter encodes the same
+  for (unsigned long c = 0; c < MORSE_ALPHABET_CODE_POINTS; c++) {
+    unsigned long lower = lowerCase(c);
+    if (lower != c && alphabet->encode[c].length > 0 &&
+        alphabet->encode[lower].length == 0) {
+      alphabet->encode[lower] = alphabet->encode[c];
+    } else if (lower != c && alphabet->encode[lower].length > 0 &&
+               alphabet->encode[c].length == 0) {
+      alphabet->encode[c] = alphabet->encode[lower];
+    }
+  }
+  return true;
+}
+
+/* One "SYMBOL CODE" line at offset of the table text */
+static bool compileLine(MorseAlphabet *alphabet, const char *line,
+                        size_t length, size_t offset, unsigned int *prosigns,
+                        char *error) {
+  if (length > 0 && line[length - 1] == '\r') {
+    length--;
+  }
+  size_t i = 0;
+  while (i < length && (line[i] == ' ' || line[i] == '\t')) {
+    i++;
+  }
+  if (i == length || line[i] == '#') {
+    return true;
+  }
+  size_t symbolStart = i;
+  while (i < length && line[i] != ' ' && line[i] != '\t') {
+    i++;
+  }
+  size_t symbolLength = i - symbolStart;
+  while (i < length && (line[i] == ' ' || line[i] == '\t')) {
+    i++;
+  }
+  size_t codeStart = i;
+  while (i < length && (line[i] == '.' || line[i] == '-')) {
+    i++;
+  }
+  size_t codeLength = i - codeStart;
+  while (i < length && (line[i] == ' ' || line[i] == '\t')) {
+    i++;
+  }
+  const char *symbol = line + symbolStart;
+  if (codeLength == 0 || codeLength > MORSE_ALPHABET_MAX_CODE_LENGTH ||
+      (i < length && line[i] != '#')) {
+    snprintf(error, MORSE_ALPHABET_ERROR_SIZE,
+             "'%.*s' needs a code of 1-%d dots and dashes", (int)symbolLength,
+             symbol, MORSE_ALPHABET_MAX_CODE_LENGTH);
+    return false;
+  }
+
+  unsigned int dashes = 0;
+  for (size_t e = 0; e < codeLength; e++) {
+    dashes |= (unsigned int)(line[codeStart + e] == '-') << e;
+  }
+  MorseAlphabetString code = {(unsigned short)(offset + codeStart),
+                              (unsigned char)codeLength};
+  MorseAlphabetString text = {(unsigned short)(offset + symbolStart),
+                              (unsigned char)symbolLength};
+
+  unsigned long c;
+  if (symbolLength > 2 && symbol[0] == '<' &&
+      symbol[symbolLength - 1] == '>') {
+    size_t nameLength = symbolLength - 2;
+    bool valid = nameLength <= MORSE_ALPHABET_MAX_PROSIGN;
+    for (size_t n = 0; valid && n < nameLength; n++) {
+      valid = isProsignCharacter(symbol[1 + n]) &&
+              upperCase(symbol[1 + n]) == symbol[1 + n];
+    }
+    if (!valid) {
+      snprintf(error, MORSE_ALPHABET_ERROR_SIZE,
+               "prosign '%.*s' needs 1-%d upper-case letters or digits",
+               (int)symbolLength, symbol, MORSE_ALPHABET_MAX_PROSIGN);
+      return false;
+    }
+    unsigned int slot = prosignSlot(alphabet, symbol + 1, nameLength);
+    if (alphabet->prosigns[slot].name.length > 0) {
+      snprintf(error, MORSE_ALPHABET_ERROR_SIZE, "'%.*s' is listed twice",
+               (int)symbolLength, symbol);
+      return false;
+    }
+    if (++*prosigns > MORSE_ALPHABET_MAX_PROSIGNS) {
+      snprintf(error, MORSE_ALPHABET_ERROR_SIZE, "more than %d prosigns",
+               MORSE_ALPHABET_MAX_PROSIGNS);
+      return false;
+    }
+    alphabet->prosigns[slot].name = text;
+    alphabet->prosigns[slot].code = code;
+    alphabet->hasProsigns = true;
+  } else if (!readCodePoint(symbol, symbolLength, &c) || c <= ' ' ||
+             c == 0x7F || c == '*' || c >= MORSE_ALPHABET_CODE_POINTS) {
+    // ' ', CR and LF separate symbols and '*' replaces unsupported ones
+    snprintf(error, MORSE_ALPHABET_ERROR_SIZE,
+             "'%.*s' is not one UTF-8 character up to U+07FF, nor a prosign",
+             (int)symbolLength, symbol);
+    return false;
+  } else if (alphabet->encode[c].length > 0) {
+    snprintf(error, MORSE_ALPHABET_ERROR_SIZE, "'%.*s' is listed twice",
+             (int)symbolLength, symbol);
+    return false;
+  } else {
+    alphabet->encode[c] = code;
+  }
+
+  unsigned int index = MORSE_DECODE_INDEX(dashes, codeLength);
+  if (alphabet->decode[index].length == 0) {
+    alphabet->decode[index] = text;
+  }
+  return true;
+}
+
+/* Decode a whole, well-formed UTF-8 character */
+static bool readCodePoint(const char *text, size_t length,
+                          unsigned long *codePoint) {
+  unsigned char lead = (unsigned char)text[0];
+  size_t expected = lead < 0x80   ? 1
+                    : lead < 0xC2 ? 0
+                    : lead < 0xE0 ? 2
+                    : lead < 0xF0 ? 3
+                    : lead < 0xF5 ? 4
+                                  : 0;
+  if (expected == 0 || length != expected) {
+    return false;
+  }
+  unsigned long c = expected == 1 ? lead : lead & (0x7F >> expected);
+  for (size_t i = 1; i < expected; i++) {
+    if (((unsigned char)text[i] & 0xC0) != 0x80) {
+      return false;
+    }
+    c = c << 6 | ((unsigned char)text[i] & 0x3F);
+  }
+  *codePoint = c;
+  return expected == 1 || c >= SEQUENCE_MINIMUM[expected];
+}
+
+/* Lower-case form of a letter below MORSE_ALPHABET_CODE_POINTS, else the
+ * code point itself */
+static unsigned long lowerCase(unsigned long c) {
+  if ((c >= 'A' && c <= 'Z') || (c >= 0xC0 && c <= 0xDE && c != 0xD7) ||
+      (c >= 0x391 && c <= 0x3AB && c != 0x3A2) || (c >= 0x410 && c <= 0x42F)) {
+    return c + 0x20; // ASCII, Latin-1, Greek, Cyrillic
+  }
+  if (c >= 0x400 && c <= 0x40F) {
+    return c + 0x50; // Cyrillic with diacritics
+  }
+  if (c == 0x178) {
+    return 0xFF; // Y with diaeresis
+  }
+  // Latin Extended-A pairs upper and lower case, even first except in
+  // two runs where the odd one is upper case
+  bool oddFirst = (c >= 0x139 && c <= 0x148) || (c >= 0x179 && c <= 0x17E);
+  if (c >= 0x100 && c <= 0x17F && c != 0x130 && c != 0x131 && c != 0x138 &&
+      c != 0x149 && c != 0x17F && (c & 1) == (oddFirst ? 1u : 0u)) {
+    return c + 1;
+  }
+  return c;
+}
+
+/* Slot of the prosign called name, or the empty slot it would go in:
+ * FNV-1a of the name, probed linearly */
+static unsigned int prosignSlot(const MorseAlphabet *alphabet,
+                                const char *name, size_t length) {
+  unsigned int hash = 2166136261u;
+  for (size_t i = 0; i < length; i++) {
+    hash = (hash ^ (unsigned char)upperCase(name[i])) * 16777619u;
+  }
+  for (unsigned int probe = 0;; probe++) {
+    unsigned int slot = (hash + probe) % MORSE_ALPHABET_PROSIGN_SLOTS;
+    const MorseAlphabetString *listed = &alphabet->prosigns[slot].name;
+    if (listed->length == 0) {
+      return slot;
+    }
+    // A listed name is "<NAME>" in upper case
+    const char *listedName = alphabet->strings + listed->offset + 1;
+    bool same = listed->length == length + 2;
+    for (size_t i = 0; same && i < length; i++) {
+      same = upperCase(name[i]) == listedName[i];
+    }
+    if (same) {
+      return slot;
+    }
+  }
+}
+
+static char upperCase(char c) {
+  return c >= 'a' && c <= 'z' ? (char)(c - 'a' + 'A') : c;
+}
+
+static bool isProsignCharacter(char c) {
+  return (c >= 'A' && c <= 'Z') || (c >= 'a' && c <= 'z') ||
+         (c >= '0' && c <= '9');
+}
+
+void morseAlphabetEncoderInit(MorseAlphabetEncoder *encoder,
+                              const MorseAlphabet *alphabet,
+                              bool useSlashWordspacer) {
+  encoder->alphabet = alphabet;
+  // As morseEncoderInit(), which the generator does not link
+  encoder->spacing.useSlashWordspacer = useSlashWordspacer;
+  encoder->spacing.lastWasSpace = false;
+  encoder->spacing.firstChar = true;
+  encoder->codePoint = 0;
+  encoder->remaining = 0;
+  encoder->sequenceLength = 0;
+  encoder->heldLength = 0;
+  encoder->counts = (MorseAlphabetCounts){0, 0};
+}
+
+/* ReqFunc13, ReqFunc15, ReqFunc17, ReqFunc19, ReqFunc21, ReqFunc23,
+ * ReqFunc25-28, ReqOptFunc02 as in morseEncoderFeed() */
+size_t morseAlphabetEncode(MorseAlphabetEncoder *encoder, const char *text,
+                           size_t length, char *out) {
+  const MorseAlphabet *alphabet = encoder->alphabet;
+  char *cursor = out;
+  for (size_t i = 0; i < length; i++) {
+    char c = text[i];
+    unsigned char byte = (unsigned char)c;
+
+    if (encoder->remaining > 0) {
+      if ((byte & 0xC0) == 0x80) {
+        encoder->codePoint = encoder->codePoint << 6 | (byte & 0x3F);
+        if (--encoder->remaining == 0) {
+          unsigned long codePoint = encoder->codePoint;
+          bool valid = codePoint >= SEQUENCE_MINIMUM[encoder->sequenceLength];
+          cursor = encodeSymbol(encoder,
+                                valid && codePoint < MORSE_ALPHABET_CODE_POINTS
+                                    ? alphabet->encode[codePoint]
+                                    : NO_STRING,
+                                cursor);
+        }
+        continue;
+      }
+      // A sequence cut short is one malformed character; the byte that
+      // cut it starts afresh
+      encoder->remaining = 0;
+      cursor = encodeSymbol(encoder, NO_STRING, cursor);
+    }
+
+    if (encoder->heldLength > 0) {
+      if (isProsignCharacter(c) &&
+          encoder->heldLength < MORSE_ALPHABET_HELD) {
+        encoder->held[encoder->heldLength++] = c;
+        continue;
+      }
+      if (c == '>' && encoder->heldLength > 1) {
+        unsigned int slot = prosignSlot(alphabet, encoder->held + 1,
+                                        encoder->heldLength - 1u);
+        if (alphabet->prosigns[slot].name.length > 0) {
+          encoder->heldLength = 0;
+          cursor = encodeSymbol(encoder, alphabet->prosigns[slot].code,
+                                cursor);
+          continue;
+        }
+      }
+      // Not a prosign after all: the held bytes are characters
+      cursor = releaseHeld(encoder, cursor);
+    }
+
+    if (byte < 0x80) {
+      if (c == '<' && alphabet->hasProsigns) {
+        encoder->held[0] = c;
+        encoder->heldLength = 1;
+      } else {
+        cursor = encodeAscii(encoder, c, cursor);
+      }
+    } else if (byte >= 0xC2 && byte < 0xF5) {
+      encoder->sequenceLength = byte < 0xE0 ? 2 : byte < 0xF0 ? 3 : 4;
+      encoder->remaining = (unsigned char)(encoder->sequenceLength - 1);
+      encoder->codePoint = byte & (0x7Fu >> encoder->sequenceLength);
+    } else {
+      // A lone continuation byte, or one that never leads a sequence
+      cursor = encodeSymbol(encoder, NO_STRING, cursor);
+    }
+  }
+  return (size_t)(cursor - out);
+}
+
+size_t morseAlphabetEncoderFinish(MorseAlphabetEncoder *encoder, char *out) {
+  char *cursor = out;
+  if (encoder->remaining > 0) {
+    cursor = encodeSymbol(encoder, NO_STRING, cursor);
+  }
+  cursor = releaseHeld(encoder, cursor);
+  MorseAlphabetCounts counts = encoder->counts;
+  morseAlphabetEncoderInit(encoder, encoder->alphabet,
+                           encoder->spacing.useSlashWordspacer);
+  encoder->counts = counts;
+  return (size_t)(cursor - out);
+}
+
+/* One symbol with the separator before it; '*' if it has no code -
+ * ReqFunc25, ReqFunc26 */
+static char *encodeSymbol(MorseAlphabetEncoder *encoder,
+                          MorseAlphabetString code, char *cursor) {
+  MorseEncoder *spacing = &encoder->spacing;
+  if (!spacing->firstChar && !spacing->lastWasSpace) {
+    *cursor++ = ' ';
+  }
+  if (code.length > 0) {
+    memcpy(cursor, encoder->alphabet->strings + code.offset, code.length);
+    cursor += code.length;
+  } else {
+    *cursor++ = '*';
+    encoder->counts.unknown++;
+  }
+  encoder->counts.symbols++;
+  spacing->lastWasSpace = false;
+  spacing->firstChar = false;
+  return cursor;
+}
+
+/* A byte below 0x80 that does not start a prosign - ReqFunc27, ReqFunc28,
+ * ReqOptFunc02 */
+static char *encodeAscii(MorseAlphabetEncoder *encoder, char c,
+                         char *cursor) {
+  MorseEncoder *spacing = &encoder->spacing;
+  if (c == '\n' || c == '\r') {
+    return cursor;
+  }
+  if (c == ' ') {
+    if (!spacing->lastWasSpace && !spacing->firstChar) {
+      memcpy(cursor, spacing->useSlashWordspacer ? " / " : "   ", 3);
+      cursor += 3;
+    }
+    spacing->lastWasSpace = true;
+    return cursor;
+  }
+  return encodeSymbol(encoder,
+                      encoder->alphabet->encode[(unsigned char)c], cursor);
+}
+
+/* Encode the held '<' and name as the characters they are */
+static char *releaseHeld(MorseAlphabetEncoder *encoder, char *cursor) {
+  for (unsigned int i = 0; i < encoder->heldLength; i++) {
+    cursor = encodeAscii(encoder, encoder->held[i], cursor);
+  }
+  encoder->heldLength = 0;
+  return cursor;
+}
+
+void morseAlphabetDecoderInit(MorseAlphabetDecoder *decoder,
+                              const MorseAlphabet *alphabet) {
+  decoder->alphabet = alphabet;
+  decoder->code = 0;
+  decoder->codeLength = 0;
+  decoder->spaceCount = 0;
+  decoder->counts = (MorseAlphabetCounts){0, 0};
+}
+
+/* ReqFunc14, ReqFunc16, ReqFunc18, ReqFunc20, ReqFunc22, ReqFunc24,
+ * ReqFunc28 as in morseDecoderFeedScalar() */
+size_t morseAlphabetDecode(MorseAlphabetDecoder *decoder, const char *morse,
+                           size_t length, char *out) {
+  size_t resultIndex = 0;
+  for (size_t i = 0; i < length; i++) {
+    char c = morse[i];
+    if (c == '\n' || c == '\r') {
+      continue;
+    }
+    if (c == ' ') {
+      decoder->spaceCount++;
+      if (decoder->spaceCount == 1) {
+        resultIndex += flushSymbol(decoder, out + resultIndex);
+      } else if (decoder->spaceCount == 3) {
+        out[resultIndex++] = ' ';
+        decoder->spaceCount = 0;
+      }
+    } else if (c == '/') {
+      resultIndex += flushSymbol(decoder, out + resultIndex);
+      out[resultIndex++] = ' ';
+      decoder->spaceCount = 0;
+    } else {
+      // Anything but '.' and '-', or one element too many, makes the
+      // symbol undecodable
+      decoder->spaceCount = 0;
+      if ((c != '.' && c != '-') ||
+          decoder->codeLength >= MORSE_ALPHABET_MAX_CODE_LENGTH) {
+        decoder->codeLength = MORSE_ALPHABET_MAX_CODE_LENGTH + 1;
+      } else {
+        decoder->code |= (unsigned int)(c == '-') << decoder->codeLength++;
+      }
+    }
+  }
+  return resultIndex;
+}
+
+size_t morseAlphabetDecoderFinish(MorseAlphabetDecoder *decoder, char *out) {
+  size_t written = flushSymbol(decoder, out);
+  MorseAlphabetCounts counts = decoder->counts;
+  morseAlphabetDecoderInit(decoder, decoder->alphabet);
+  decoder->counts = counts;
+  return written;
+}
+
+/* Write the text of the pending symbol, if it has one */
+static size_t flushSymbol(MorseAlphabetDecoder *decoder, char *out) {
+  size_t written = 0;
+  if (decoder->codeLength > 0 &&
+      decoder->codeLength <= MORSE_ALPHABET_MAX_CODE_LENGTH) {
+    MorseAlphabetString text = decoder->alphabet->decode[MORSE_DECODE_INDEX(
+        decoder->code, decoder->codeLength)];
+    memcpy(out, decoder->alphabet->strings + text.offset, text.length);
+    written = text.length;
+  }
+  if (decoder->codeLength > 0) {
+    decoder->counts.symbols += written > 0;
+    decoder->counts.unknown += written == 0;
+  }
+  decoder->code = 0;
+  decoder->codeLength = 0;
+  return written;
+}
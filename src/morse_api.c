@@ -0,0 +1,64 @@
+/**
+ * @file morse_api.c
+ * @brief One-call conversion entry points of libmorse
+ * @author Diego Rubio Carrera
+ */
+
+#include <morse/morse.h>
+#include <morse_codec.h>
+#include <morse_packed.h>
+
+/* The context lives on the stack, so a call needs no memory but out. A
+ * capacity below the bound is checked against the exact size first; an
+ * empty result returns there too, so a size query never passes its NULL
+ * buffer to the codec. */
+size_t morseEncode(const char *text, size_t length, char *out,
+                   size_t capacity, unsigned int flags) {
+  bool packed = (flags & MORSE_PACKED) != 0;
+  if (capacity < MORSE_ENCODE_BOUND(length)) {
+    size_t encodedLength =
+        packed ? MORSE_PACKED_HEADER_SIZE +
+                     morsePackedEncodedLength(text, length)
+               : morseEncodedLength(text, length);
+    if (encodedLength > capacity || encodedLength == 0) {
+      return encodedLength;
+    }
+  }
+
+  MorseEncoder encoder;
+  morseEncoderInit(&encoder, (flags & MORSE_SLASH_WORDSPACER) != 0);
+  if (packed) {
+    size_t written = morsePackedHeader(encoder.useSlashWordspacer, out);
+    return written + morsePackedEncode(&encoder, text, length, out + written);
+  }
+  size_t written = morseEncoderFeed(&encoder, text, length, out);
+  return written + morseEncoderFinish(&encoder, out + written);
+}
+
+size_t morseDecode(const char *morse, size_t length, char *out,
+                   size_t capacity, unsigned int flags) {
+  (void)flags;
+  if (morsePackedDetect(morse, length) == MORSE_FORMAT_PACKED) {
+    const char *tokens = morse + MORSE_PACKED_HEADER_SIZE;
+    size_t tokenCount = length - MORSE_PACKED_HEADER_SIZE;
+    if (capacity < tokenCount) {
+      size_t decodedLength = morsePackedDecodedLength(tokens, tokenCount);
+      if (decodedLength > capacity || decodedLength == 0) {
+        return decodedLength;
+      }
+    }
+    return morsePackedDecode(tokens, tokenCount, out);
+  }
+
+  if (capacity < MORSE_DECODE_BOUND(length)) {
+    size_t decodedLength = morseDecodedLength(morse, length);
+    if (decodedLength > capacity || decodedLength == 0) {
+      return decodedLength;
+    }
+  }
+
+  MorseDecoder decoder;
+  morseDecoderInit(&decoder);
+  size_t written = morseDecoderFeed(&decoder, morse, length, out);
+  return written + morseDecoderFinish(&decoder, out + written);
+}
@@ -0,0 +1,132 @@
+/**
+ * @file morse_arena.c
+ * @brief Bump allocator for per-job memory
+ * @author Diego Rubio Carrera
+ */
+
+#include <morse_arena.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* Alignment of every allocation, enough for any scalar type */
+#define ARENA_ALIGNMENT 16
+
+/* Block header size, rounded up so block data stays aligned */
+#define BLOCK_HEADER                                                           \
+  ((sizeof(MorseArenaBlock) + ARENA_ALIGNMENT - 1) &                           \
+   ~(size_t)(ARENA_ALIGNMENT - 1))
+
+static MorseArenaBlock *createBlock(size_t capacity);
+
+void morseArenaInit(MorseArena *arena, size_t blockSize) {
+  arena->first = NULL;
+  arena->current = NULL;
+  arena->blockSize = blockSize;
+}
+
+void morseArenaDestroy(MorseArena *arena) {
+  MorseArenaBlock *block = arena->first;
+  while (block) {
+    MorseArenaBlock *next = block->next;
+    free(block);
+    block = next;
+  }
+  arena->first = NULL;
+  arena->current = NULL;
+}
+
+/* Bump within the current block; move on to the next kept block, or chain
+ * in a new one where none is large enough */
+void *morseArenaAlloc(MorseArena *arena, size_t size) {
+  size = (size + ARENA_ALIGNMENT - 1) & ~(size_t)(ARENA_ALIGNMENT - 1);
+  MorseArenaBlock *block = arena->current;
+  if (block && block->capacity - block->used >= size) {
+    void *memory = (char *)block + BLOCK_HEADER + block->used;
+    block->used += size;
+    return memory;
+  }
+
+  MorseArenaBlock *next = block ? block->next : arena->first;
+  if (!next || next->capacity < size) {
+    // Blocks after this one keep their place for later jobs
+    MorseArenaBlock *created =
+        createBlock(size > arena->blockSize ? size : arena->blockSize);
+    if (!created) {
+      return NULL;
+    }
+    created->next = next;
+    if (block) {
+      block->next = created;
+    } else {
+      arena->first = created;
+    }
+    next = created;
+  }
+
+  next->used = size;
+  arena->current = next;
+  return (char *)next + BLOCK_HEADER;
+}
+
+char *morseArenaStrdup(MorseArena *arena, const char *text) {
+  size_t length = strlen(text);
+  char *copy = morseArenaAlloc(arena, length + 1);
+  if (copy) {
+    memcpy(copy, text, length + 1);
+  }
+  return copy;
+}
+
+char *morseArenaPrintf(MorseArena *arena, const char *format, ...) {
+  va_list arguments;
+  va_start(arguments, format);
+  char *text = morseArenaVprintf(arena, format, arguments);
+  va_end(arguments);
+  return text;
+}
+
+char *morseArenaVprintf(MorseArena *arena, const char *format,
+                        va_list arguments) {
+  va_list measure;
+  va_copy(measure, arguments);
+  int length = vsnprintf(NULL, 0, format, measure);
+  va_end(measure);
+  if (length < 0) {
+    return NULL;
+  }
+
+  char *text = morseArenaAlloc(arena, (size_t)length + 1);
+  if (text) {
+    vsnprintf(text, (size_t)length + 1, format, arguments);
+  }
+  return text;
+}
+
+MorseArenaMark morseArenaMark(const MorseArena *arena) {
+  MorseArenaMark mark = {arena->current,
+                         arena->current ? arena->current->used : 0};
+  return mark;
+}
+
+void morseArenaRewind(MorseArena *arena, MorseArenaMark mark) {
+  arena->current = mark.block;
+  if (mark.block) {
+    mark.block->used = mark.used;
+  }
+}
+
+void morseArenaReset(MorseArena *arena) {
+  MorseArenaMark start = {NULL, 0};
+  morseArenaRewind(arena, start);
+}
+
+static MorseArenaBlock *createBlock(size_t capacity) {
+  MorseArenaBlock *block = malloc(BLOCK_HEADER + capacity);
+  if (block) {
+    block->next = NULL;
+    block->capacity = capacity;
+    block->used = 0;
+  }
+  return block;
+}
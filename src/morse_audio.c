@@ -0,0 +1,304 @@
+/**
+ * @file morse_audio.c
+ * @brief PARIS timeline of encoded Morse code as WAV samples or keying
+ * @author Diego Rubio Carrera
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <math.h>
+#include <morse_audio.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+/* Peak of the tone, half of full scale */
+#define TONE_AMPLITUDE 16383.0
+
+/* Rise and fall of a tone burst, in seconds; a hard key-down would click */
+#define TONE_RAMP 0.005
+
+/* Gaps of the PARIS standard, in units */
+#define ELEMENT_GAP 1
+#define LETTER_GAP 3
+#define WORD_GAP 7
+
+/* Longest line of keying output */
+#define KEYING_LINE_MAX 32
+
+/* WAV sizes of a stream whose length is not known in advance */
+#define WAV_SIZE_UNKNOWN 0xFFFFFFFFu
+
+static const double PI = 3.14159265358979323846;
+
+static void synthesizeTone(const MorseAudioConfig *config, size_t frames,
+                           char *out);
+static size_t wavHeader(const MorseAudioConfig *config,
+                        unsigned long long dataBytes, bool sized, char *out);
+static long long rewritableOffset(int fd);
+static bool playTone(MorseAudio *audio, unsigned int units);
+static bool playSilence(MorseAudio *audio, unsigned int units);
+static bool writeTransition(MorseAudio *audio, const char *state);
+static bool appendBytes(MorseAudio *audio, const char *data, size_t length);
+static bool drainBlock(MorseAudio *audio);
+static void putLittleEndian(char *out, unsigned long value, int bytes);
+
+void morseAudioDefaults(MorseAudioConfig *config) {
+  config->wpm = MORSE_AUDIO_DEFAULT_WPM;
+  config->tone = MORSE_AUDIO_DEFAULT_TONE;
+  config->sampleRate = MORSE_AUDIO_DEFAULT_SAMPLE_RATE;
+  config->channels = 1;
+}
+
+bool morseAudioInit(MorseAudio *audio, MorseAudioFormat format,
+                    const MorseAudioConfig *config, MorseWriter *writer) {
+  *audio = (MorseAudio){.format = format,
+                        .config = *config,
+                        .writer = writer,
+                        .headerOffset = -1};
+  audio->block = malloc(MORSE_AUDIO_BLOCK_SIZE);
+  if (!audio->block) {
+    errno = ENOMEM;
+    return false;
+  }
+  if (format != MORSE_AUDIO_WAV) {
+    return true;
+  }
+
+  // One unit is 1.2 / WPM seconds, rounded to whole frames once, so every
+  // element and gap is an exact multiple of it
+  size_t frames = (size_t)(((unsigned long long)config->sampleRate * 12 +
+                            config->wpm * 5) /
+                           (config->wpm * 10));
+  audio->unitBytes = frames * config->channels * 2;
+  audio->dot = malloc(audio->unitBytes);
+  audio->dash = malloc(audio->unitBytes * 3);
+  if (!audio->dot || !audio->dash) {
+    morseAudioDestroy(audio);
+    errno = ENOMEM;
+    return false;
+  }
+  synthesizeTone(config, frames, audio->dot);
+  synthesizeTone(config, frames * 3, audio->dash);
+
+  // Nothing is buffered yet, so the header lands at the descriptor's offset
+  audio->headerOffset = rewritableOffset(morseWriterFd(writer));
+  char header[MORSE_AUDIO_WAV_HEADER_SIZE];
+  size_t length = wavHeader(config, 0, false, header);
+  return appendBytes(audio, header, length);
+}
+
+/* Dots and dashes sound; spaces, slashes and '*' only widen the gap before
+ * the next tone, so consecutive separators merge into the longest one */
+bool morseAudioFeed(MorseAudio *audio, const char *morse, size_t length) {
+  for (size_t i = 0; i < length; i++) {
+    char c = morse[i];
+    if (c == '.' || c == '-') {
+      if (audio->inSymbol && audio->gap < ELEMENT_GAP) {
+        audio->gap = ELEMENT_GAP;
+      }
+      if (audio->started && !playSilence(audio, audio->gap)) {
+        return false;
+      }
+      if (!playTone(audio, c == '-' ? 3 : 1)) {
+        return false;
+      }
+      audio->gap = 0;
+      audio->spaces = 0;
+      audio->inSymbol = true;
+      audio->started = true;
+    } else if (c == ' ') {
+      // ReqFunc26, ReqFunc27: one space ends a letter, three a word
+      audio->spaces++;
+      unsigned int gap = audio->spaces >= 3 ? WORD_GAP : LETTER_GAP;
+      audio->gap = gap > audio->gap ? gap : audio->gap;
+      audio->inSymbol = false;
+    } else if (c == '/') {
+      audio->gap = WORD_GAP;
+      audio->spaces = 0;
+      audio->inSymbol = false;
+    } else if (c == '*') {
+      // ReqFunc25: an unsupported character has no sound
+      audio->spaces = 0;
+      audio->inSymbol = false;
+    }
+  }
+  return true;
+}
+
+bool morseAudioFinish(MorseAudio *audio) {
+  if (!drainBlock(audio)) {
+    return false;
+  }
+  if (audio->format != MORSE_AUDIO_WAV || audio->headerOffset < 0) {
+    return true;
+  }
+#ifdef _WIN32
+  return true;
+#else
+  // The header must be in the file before it is rewritten
+  if (!morseWriterFlush(audio->writer)) {
+    return false;
+  }
+  char header[MORSE_AUDIO_WAV_HEADER_SIZE];
+  size_t length = wavHeader(&audio->config, audio->dataBytes, true, header);
+  ssize_t written = pwrite(morseWriterFd(audio->writer), header, length,
+                           (off_t)audio->headerOffset);
+  return written == (ssize_t)length;
+#endif
+}
+
+void morseAudioDestroy(MorseAudio *audio) {
+  free(audio->dot);
+  free(audio->dash);
+  free(audio->block);
+  audio->dot = NULL;
+  audio->dash = NULL;
+  audio->block = NULL;
+}
+
+/* A burst of frames with a raised-cosine rise and fall, written as 16-bit
+ * little-endian samples, the same on every channel */
+static void synthesizeTone(const MorseAudioConfig *config, size_t frames,
+                           char *out) {
+  size_t ramp = (size_t)(config->sampleRate * TONE_RAMP);
+  ramp = ramp < frames / 2 ? ramp : frames / 2;
+  double step = 2.0 * PI * config->tone / config->sampleRate;
+  size_t index = 0;
+  for (size_t i = 0; i < frames; i++) {
+    size_t edge = i < frames - 1 - i ? i : frames - 1 - i;
+    double envelope =
+        edge < ramp ? 0.5 - 0.5 * cos(PI * (double)edge / (double)ramp) : 1.0;
+    long sample = lround(TONE_AMPLITUDE * envelope * sin(step * (double)i));
+    for (unsigned int channel = 0; channel < config->channels; channel++) {
+      putLittleEndian(out + index, (unsigned long)sample & 0xFFFF, 2);
+      index += 2;
+    }
+  }
+}
+
+/* RIFF header of 16-bit PCM; unsized, both lengths are WAV_SIZE_UNKNOWN */
+static size_t wavHeader(const MorseAudioConfig *config,
+                        unsigned long long dataBytes, bool sized, char *out) {
+  unsigned long dataSize = WAV_SIZE_UNKNOWN;
+  unsigned long riffSize = WAV_SIZE_UNKNOWN;
+  if (sized && dataBytes <= WAV_SIZE_UNKNOWN - 36) {
+    dataSize = (unsigned long)dataBytes;
+    riffSize = dataSize + 36;
+  }
+  unsigned int blockAlign = config->channels * 2;
+  memcpy(out, "RIFF", 4);
+  putLittleEndian(out + 4, riffSize, 4);
+  memcpy(out + 8, "WAVEfmt ", 8);
+  putLittleEndian(out + 16, 16, 4); // size of the format chunk
+  putLittleEndian(out + 20, 1, 2);  // PCM
+  putLittleEndian(out + 22, config->channels, 2);
+  putLittleEndian(out + 24, config->sampleRate, 4);
+  putLittleEndian(out + 28, (unsigned long)config->sampleRate * blockAlign,
+                  4);
+  putLittleEndian(out + 32, blockAlign, 2);
+  putLittleEndian(out + 34, 16, 2); // bits per sample
+  memcpy(out + 36, "data", 4);
+  putLittleEndian(out + 40, dataSize, 4);
+  return MORSE_AUDIO_WAV_HEADER_SIZE;
+}
+
+/* Where a header written to fd now can be rewritten later: only in a
+ * regular file, and not one opened for appending, where pwrite(2) would
+ * append as well */
+static long long rewritableOffset(int fd) {
+#ifdef _WIN32
+  (void)fd;
+  return -1;
+#else
+  struct stat fileStat;
+  int statusFlags = fcntl(fd, F_GETFL);
+  if (fstat(fd, &fileStat) != 0 || !S_ISREG(fileStat.st_mode) ||
+      statusFlags < 0 || (statusFlags & O_APPEND)) {
+    return -1;
+  }
+  off_t offset = lseek(fd, 0, SEEK_CUR);
+  return offset < 0 ? -1 : (long long)offset;
+#endif
+}
+
+/* A dot (one unit) or a dash (three) */
+static bool playTone(MorseAudio *audio, unsigned int units) {
+  bool ok;
+  if (audio->format == MORSE_AUDIO_KEYING) {
+    ok = writeTransition(audio, "down");
+    audio->units += units;
+    ok = ok && writeTransition(audio, "up");
+  } else {
+    ok = appendBytes(audio, units == 1 ? audio->dot : audio->dash,
+                     units * audio->unitBytes);
+    audio->dataBytes += units * audio->unitBytes;
+    audio->units += units;
+  }
+  return ok;
+}
+
+static bool playSilence(MorseAudio *audio, unsigned int units) {
+  audio->units += units;
+  if (audio->format == MORSE_AUDIO_KEYING) {
+    return true;
+  }
+  size_t remaining = units * audio->unitBytes;
+  audio->dataBytes += remaining;
+  while (remaining > 0) {
+    if (audio->used == MORSE_AUDIO_BLOCK_SIZE && !drainBlock(audio)) {
+      return false;
+    }
+    size_t space = MORSE_AUDIO_BLOCK_SIZE - audio->used;
+    size_t step = remaining < space ? remaining : space;
+    memset(audio->block + audio->used, 0, step);
+    audio->used += step;
+    remaining -= step;
+  }
+  return true;
+}
+
+/* One keying line at the current position; microseconds are rounded from
+ * the unit count, so the timeline never drifts */
+static bool writeTransition(MorseAudio *audio, const char *state) {
+  if (MORSE_AUDIO_BLOCK_SIZE - audio->used < KEYING_LINE_MAX &&
+      !drainBlock(audio)) {
+    return false;
+  }
+  unsigned long long wpm = audio->config.wpm;
+  unsigned long long micros = (audio->units * 1200000 + wpm / 2) / wpm;
+  int length = snprintf(audio->block + audio->used, KEYING_LINE_MAX,
+                        "%llu %s\n", micros, state);
+  audio->used += (size_t)length;
+  return true;
+}
+
+static bool appendBytes(MorseAudio *audio, const char *data, size_t length) {
+  while (length > 0) {
+    if (audio->used == MORSE_AUDIO_BLOCK_SIZE && !drainBlock(audio)) {
+      return false;
+    }
+    size_t space = MORSE_AUDIO_BLOCK_SIZE - audio->used;
+    size_t step = length < space ? length : space;
+    memcpy(audio->block + audio->used, data, step);
+    audio->used += step;
+    data += step;
+    length -= step;
+  }
+  return true;
+}
+
+/* Hand the block to the writer and start it over */
+static bool drainBlock(MorseAudio *audio) {
+  bool ok = morseWriterWrite(audio->writer, audio->block, audio->used);
+  audio->used = 0;
+  return ok;
+}
+
+static void putLittleEndian(char *out, unsigned long value, int bytes) {
+  for (int i = 0; i < bytes; i++) {
+    out[i] = (char)((value >> (8 * i)) & 0xFF);
+  }
+}
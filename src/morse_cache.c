@@ -0,0 +1,665 @@
+/**
+ * @file morse_cache.c
+ * @brief Content-addressed cache of converted results, for --cache
+ * @author Diego Rubio Carrera
+ */
+
+#define _GNU_SOURCE // O_CLOEXEC, futimens
+
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <morse_cache.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#ifdef MORSE_HAVE_SENDFILE
+#include <sys/sendfile.h>
+#endif
+#ifndef _WIN32
+#include <sys/mman.h>
+#endif
+
+/* Part of every key: results of an older codec are never looked up.
+ * Raise it whenever any conversion starts writing different bytes. */
+#define CACHE_FORMAT_VERSION 1
+
+/* Length of an entry name: the key in hex and ".morse" */
+#define ENTRY_NAME_LENGTH (16 + 6)
+
+/* A directory over its limit is trimmed to this share of it, so the next
+ * results are stored without scanning it again */
+#define TRIM_NUMERATOR 7
+#define TRIM_DENOMINATOR 8
+
+/* Bytes copied at a time when a result goes through the writer */
+#define COPY_CHUNK_SIZE (64 * 1024)
+
+/* Buckets a memory cache starts with; doubled as entries are added */
+#define INITIAL_BUCKETS 1024
+
+/* XXH64 primes */
+#define PRIME64_1 0x9E3779B185EBCA87ull
+#define PRIME64_2 0xC2B2AE3D27D4EB4Full
+#define PRIME64_3 0x165667B19E3779F9ull
+#define PRIME64_4 0x85EBCA77C2B2AE63ull
+#define PRIME64_5 0x27D4EB2F165667C5ull
+
+struct MorseCache {
+  char *path;
+  size_t limit;
+  size_t size; // bytes of the entries, as of the last scan plus stores
+  long long hits;
+  long long misses;
+  long long evictions;
+  pthread_mutex_t lock; // guards size and the counters
+};
+
+/* One result in memory, in its bucket's chain and in the LRU list */
+typedef struct MemoryEntry {
+  uint64_t key;
+  size_t length;
+  struct MemoryEntry *chain; // next entry of the bucket
+  struct MemoryEntry *newer;
+  struct MemoryEntry *older;
+  char data[];
+} MemoryEntry;
+
+struct MorseMemoryCache {
+  size_t limit;
+  size_t size; // bytes of the results
+  MemoryEntry **buckets;
+  size_t bucketCount; // a power of two
+  size_t count;
+  MemoryEntry *newest;
+  MemoryEntry *oldest;
+  long long hits;
+  long long misses;
+  long long evictions;
+  pthread_mutex_t lock; // guards everything above
+};
+
+/* A file of the directory, for trimming */
+typedef struct {
+  struct timespec used;
+  size_t size;
+  char name[ENTRY_NAME_LENGTH + 1];
+} DirectoryEntry;
+
+static uint64_t read64(const unsigned char *bytes);
+static uint32_t read32(const unsigned char *bytes);
+static uint64_t rotateLeft(uint64_t value, int bits);
+static uint64_t hashRound(uint64_t accumulator, uint64_t input);
+static uint64_t mergeRound(uint64_t accumulator, uint64_t value);
+static void entryPath(const MorseCache *cache, uint64_t key, char *path);
+static bool isEntryName(const char *name);
+static void trimDirectory(MorseCache *cache);
+static int compareUse(const void *left, const void *right);
+static bool copyThroughWriter(int fd, size_t offset, size_t size,
+                              MorseWriter *writer);
+static void unlinkEntry(MorseMemoryCache *cache, MemoryEntry *entry);
+static void makeNewest(MorseMemoryCache *cache, MemoryEntry *entry);
+static void growBuckets(MorseMemoryCache *cache);
+
+uint64_t morseHash64(const void *data, size_t length, uint64_t seed) {
+  const unsigned char *bytes = data;
+  const unsigned char *end = bytes + length;
+  uint64_t hash;
+  if (length >= 32) {
+    uint64_t v1 = seed + PRIME64_1 + PRIME64_2;
+    uint64_t v2 = seed + PRIME64_2;
+    uint64_t v3 = seed;
+    uint64_t v4 = seed - PRIME64_1;
+    do {
+      v1 = hashRound(v1, read64(bytes));
+      v2 = hashRound(v2, read64(bytes + 8));
+      v3 = hashRound(v3, read64(bytes + 16));
+      v4 = hashRound(v4, read64(bytes + 24));
+      bytes += 32;
+    } while (end - bytes >= 32);
+    hash = rotateLeft(v1, 1) + rotateLeft(v2, 7) + rotateLeft(v3, 12) +
+           rotateLeft(v4, 18);
+    hash = mergeRound(hash, v1);
+    hash = mergeRound(hash, v2);
+    hash = mergeRound(hash, v3);
+    hash = mergeRound(hash, v4);
+  } else {
+    hash = seed + PRIME64_5;
+  }
+  hash += (uint64_t)length;
+
+  for (; end - bytes >= 8; bytes += 8) {
+    hash ^= hashRound(0, read64(bytes));
+    hash = rotateLeft(hash, 27) * PRIME64_1 + PRIME64_4;
+  }
+  if (end - bytes >= 4) {
+    hash ^= (uint64_t)read32(bytes) * PRIME64_1;
+    hash = rotateLeft(hash, 23) * PRIME64_2 + PRIME64_3;
+    bytes += 4;
+  }
+  for (; bytes < end; bytes++) {
+    hash ^= *bytes * PRIME64_5;
+    hash = rotateLeft(hash, 11) * PRIME64_1;
+  }
+
+  hash ^= hash >> 33;
+  hash *= PRIME64_2;
+  hash ^= hash >> 29;
+  hash *= PRIME64_3;
+  hash ^= hash >> 32;
+  return hash;
+}
+
+uint64_t morseCacheKey(const char *input, size_t length, unsigned int mode,
+                       uint64_t table) {
+  unsigned char conversion[2] = {CACHE_FORMAT_VERSION, (unsigned char)mode};
+  return morseHash64(input, length,
+                     morseHash64(conversion, sizeof(conversion), table));
+}
+
+/* Little-endian loads, whatever the host's byte order */
+static uint64_t read64(const unsigned char *bytes) {
+  return (uint64_t)read32(bytes) | (uint64_t)read32(bytes + 4) << 32;
+}
+
+static uint32_t read32(const unsigned char *bytes) {
+  return (uint32_t)bytes[0] | (uint32_t)bytes[1] << 8 |
+         (uint32_t)bytes[2] << 16 | (uint32_t)bytes[3] << 24;
+}
+
+static uint64_t rotateLeft(uint64_t value, int bits) {
+  return value << bits | value >> (64 - bits);
+}
+
+static uint64_t hashRound(uint64_t accumulator, uint64_t input) {
+  accumulator += input * PRIME64_2;
+  return rotateLeft(accumulator, 31) * PRIME64_1;
+}
+
+static uint64_t mergeRound(uint64_t accumulator, uint64_t value) {
+  accumulator ^= hashRound(0, value);
+  return accumulator * PRIME64_1 + PRIME64_4;
+}
+
+MorseCache *morseCacheOpen(const char *path, size_t limit) {
+#ifdef _WIN32
+  int made = mkdir(path);
+#else
+  int made = mkdir(path, 0777);
+#endif
+  struct stat pathStat;
+  if ((made != 0 && errno != EEXIST) || stat(path, &pathStat) != 0) {
+    return NULL;
+  }
+  if (!S_ISDIR(pathStat.st_mode)) {
+    errno = ENOTDIR;
+    return NULL;
+  }
+  MorseCache *cache = calloc(1, sizeof(*cache));
+  if (!cache) {
+    return NULL;
+  }
+  size_t pathLength = strlen(path);
+  if (pathLength + 1 + ENTRY_NAME_LENGTH >= MORSE_CACHE_MAX_PATH) {
+    free(cache);
+    errno = ENAMETOOLONG;
+    return NULL;
+  }
+  cache->path = malloc(pathLength + 1);
+  if (!cache->path) {
+    free(cache);
+    return NULL;
+  }
+  memcpy(cache->path, path, pathLength + 1);
+  cache->limit = limit;
+  pthread_mutex_init(&cache->lock, NULL);
+  trimDirectory(cache);
+  return cache;
+}
+
+void morseCacheClose(MorseCache *cache) {
+  if (!cache) {
+    return;
+  }
+  pthread_mutex_destroy(&cache->lock);
+  free(cache->path);
+  free(cache);
+}
+
+int morseCacheLookup(MorseCache *cache, uint64_t key, size_t *size) {
+  char path[MORSE_CACHE_MAX_PATH];
+  entryPath(cache, key, path);
+  int fd = open(path, O_RDONLY | O_CLOEXEC);
+  struct stat entryStat;
+  if (fd >= 0 &&
+      (fstat(fd, &entryStat) != 0 || !S_ISREG(entryStat.st_mode))) {
+    close(fd);
+    fd = -1;
+  }
+  pthread_mutex_lock(&cache->lock);
+  if (fd >= 0) {
+    cache->hits++;
+  } else {
+    cache->misses++;
+  }
+  pthread_mutex_unlock(&cache->lock);
+  if (fd < 0) {
+    return -1;
+  }
+#ifndef _WIN32
+  futimens(fd, NULL); // now the most recently used
+#endif
+  *size = (size_t)entryStat.st_size;
+  return fd;
+}
+
+bool morseCacheSend(int fd, size_t size, MorseWriter *writer, bool direct) {
+  size_t sent = 0;
+#ifdef MORSE_HAVE_SENDFILE
+  // Page cache to output in the kernel, once the writer has let out what
+  // it holds, e.g. a banner
+  if (!direct && morseWriterFlush(writer)) {
+    off_t offset = 0;
+    while (sent < size) {
+      ssize_t copied =
+          sendfile(morseWriterFd(writer), fd, &offset, size - sent);
+      if (copied < 0 && errno == EINTR) {
+        continue;
+      }
+      if (copied <= 0) {
+        break; // EINVAL: not possible to this output; the writer does it
+      }
+      sent += (size_t)copied;
+    }
+  }
+#else
+  (void)direct;
+#endif
+  bool copied = copyThroughWriter(fd, sent, size, writer);
+  close(fd);
+  return copied;
+}
+
+/* Copy what sendfile(2) did not, from offset on */
+static bool copyThroughWriter(int fd, size_t offset, size_t size,
+                              MorseWriter *writer) {
+  char chunk[COPY_CHUNK_SIZE];
+  if (offset < size && lseek(fd, (off_t)offset, SEEK_SET) < 0) {
+    return false;
+  }
+  for (size_t copied = offset; copied < size;) {
+    size_t wanted = size - copied < COPY_CHUNK_SIZE ? size - copied
+                                                    : COPY_CHUNK_SIZE;
+    ssize_t bytesRead = read(fd, chunk, wanted);
+    if (bytesRead < 0 && errno == EINTR) {
+      continue;
+    }
+    if (bytesRead <= 0) {
+      errno = bytesRead == 0 ? EIO : errno; // cut short by another run
+      return false;
+    }
+    if (!morseWriterWrite(writer, chunk, (size_t)bytesRead)) {
+      return false;
+    }
+    copied += (size_t)bytesRead;
+  }
+  return true;
+}
+
+const char *morseCacheMap(int fd, size_t size) {
+#ifdef _WIN32
+  (void)size;
+  close(fd);
+  return NULL;
+#else
+  if (size == 0) {
+    close(fd);
+    return "";
+  }
+  void *mapping = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  return mapping == MAP_FAILED ? NULL : mapping;
+#endif
+}
+
+void morseCacheUnmap(const char *data, size_t size) {
+#ifdef _WIN32
+  (void)data;
+  (void)size;
+#else
+  if (size > 0) {
+    munmap((void *)data, size);
+  }
+#endif
+}
+
+void morseCacheBegin(MorseCache *cache, uint64_t key, MorseCacheEntry *entry) {
+  entry->cache = cache;
+  entry->key = key;
+  entry->length = 0;
+  // Written under a name lookups ignore, so no run sees half a result
+  snprintf(entry->path, sizeof(entry->path), "%s/.tmp-XXXXXX", cache->path);
+  entry->fd = mkstemp(entry->path);
+}
+
+void morseCacheAppend(MorseCacheEntry *entry, const char *data,
+                      size_t length) {
+  while (entry->fd >= 0 && length > 0) {
+    ssize_t written = write(entry->fd, data, length);
+    if (written < 0 && errno == EINTR) {
+      continue;
+    }
+    if (written <= 0) {
+      morseCacheAbort(entry); // e.g. the disk is full: just do not store
+      return;
+    }
+    data += written;
+    length -= (size_t)written;
+    entry->length += (size_t)written;
+  }
+}
+
+void morseCacheCommit(MorseCacheEntry *entry) {
+  if (entry->fd < 0) {
+    return;
+  }
+  MorseCache *cache = entry->cache;
+  bool closed = close(entry->fd) == 0;
+  entry->fd = -1;
+  char path[MORSE_CACHE_MAX_PATH];
+  entryPath(cache, entry->key, path);
+  if (!closed || entry->length > cache->limit ||
+      rename(entry->path, path) != 0) {
+    unlink(entry->path);
+    return;
+  }
+  pthread_mutex_lock(&cache->lock);
+  cache->size += entry->length;
+  if (cache->size > cache->limit) {
+    trimDirectory(cache);
+  }
+  pthread_mutex_unlock(&cache->lock);
+}
+
+void morseCacheAbort(MorseCacheEntry *entry) {
+  if (entry->fd >= 0) {
+    close(entry->fd);
+    unlink(entry->path);
+    entry->fd = -1;
+  }
+}
+
+void morseCacheStore(MorseCache *cache, uint64_t key, const char *data,
+                     size_t length) {
+  if (length > cache->limit) {
+    return;
+  }
+  MorseCacheEntry entry;
+  morseCacheBegin(cache, key, &entry);
+  morseCacheAppend(&entry, data, length);
+  morseCacheCommit(&entry);
+}
+
+void morseCacheReport(MorseCache *cache, MorseStats *stats) {
+  pthread_mutex_lock(&cache->lock);
+  stats->cacheHits = cache->hits;
+  stats->cacheMisses = cache->misses;
+  stats->cacheEvictions = cache->evictions;
+  stats->cacheBytes = (long long)cache->size;
+  stats->cacheLimit = (long long)cache->limit;
+  pthread_mutex_unlock(&cache->lock);
+}
+
+/* Where the result of key is kept */
+static void entryPath(const MorseCache *cache, uint64_t key, char *path) {
+  snprintf(path, MORSE_CACHE_MAX_PATH, "%s/%016llx.morse", cache->path,
+           (unsigned long long)key);
+}
+
+/* The key in hex and ".morse"; temporary files and anything else found in
+ * the directory are left alone */
+static bool isEntryName(const char *name) {
+  return strlen(name) == ENTRY_NAME_LENGTH &&
+         strspn(name, "0123456789abcdef") == 16 &&
+         strcmp(name + 16, ".morse") == 0;
+}
+
+/* Count the entries of the directory and, if they take more than the
+ * limit, remove the least recently used. Runs sharing the directory may
+ * remove entries at the same time, which only makes them misses. Called
+ * with the lock held or before the cache is shared. */
+static void trimDirectory(MorseCache *cache) {
+  DIR *directory = opendir(cache->path);
+  if (!directory) {
+    return;
+  }
+  DirectoryEntry *entries = NULL;
+  size_t count = 0;
+  size_t capacity = 0;
+  size_t total = 0;
+  char path[MORSE_CACHE_MAX_PATH];
+  for (struct dirent *found; (found = readdir(directory)) != NULL;) {
+    struct stat entryStat;
+    if (!isEntryName(found->d_name)) {
+      continue;
+    }
+    snprintf(path, sizeof(path), "%s/%s", cache->path, found->d_name);
+    if (stat(path, &entryStat) != 0 || !S_ISREG(entryStat.st_mode)) {
+      continue;
+    }
+    if (count == capacity) {
+      capacity = capacity ? capacity * 2 : 256;
+      DirectoryEntry *grown = realloc(entries, capacity * sizeof(*entries));
+      if (!grown) {
+        break; // trim what has been counted
+      }
+      entries = grown;
+    }
+    DirectoryEntry *entry = &entries[count++];
+#ifdef _WIN32
+    entry->used = (struct timespec){entryStat.st_mtime, 0};
+#else
+    entry->used = entryStat.st_mtim;
+#endif
+    entry->size = (size_t)entryStat.st_size;
+    memcpy(entry->name, found->d_name, ENTRY_NAME_LENGTH + 1);
+    total += entry->size;
+  }
+  closedir(directory);
+
+  if (total > cache->limit) {
+    size_t target = cache->limit / TRIM_DENOMINATOR * TRIM_NUMERATOR;
+    qsort(entries, count, sizeof(*entries), compareUse);
+    for (size_t i = 0; i < count && total > target; i++) {
+      snprintf(path, sizeof(path), "%s/%s", cache->path, entries[i].name);
+      if (unlink(path) == 0) {
+        total -= entries[i].size;
+        cache->evictions++;
+      }
+    }
+  }
+  cache->size = total;
+  free(entries);
+}
+
+/* Least recently used first */
+static int compareUse(const void *left, const void *right) {
+  const struct timespec *a = &((const DirectoryEntry *)left)->used;
+  const struct timespec *b = &((const DirectoryEntry *)right)->used;
+  if (a->tv_sec != b->tv_sec) {
+    return a->tv_sec < b->tv_sec ? -1 : 1;
+  }
+  return a->tv_nsec < b->tv_nsec ? -1 : a->tv_nsec > b->tv_nsec;
+}
+
+MorseMemoryCache *morseMemoryCacheCreate(size_t limit) {
+  MorseMemoryCache *cache = calloc(1, sizeof(*cache));
+  if (!cache) {
+    return NULL;
+  }
+  cache->buckets = calloc(INITIAL_BUCKETS, sizeof(*cache->buckets));
+  if (!cache->buckets) {
+    free(cache);
+    return NULL;
+  }
+  cache->bucketCount = INITIAL_BUCKETS;
+  cache->limit = limit;
+  pthread_mutex_init(&cache->lock, NULL);
+  return cache;
+}
+
+void morseMemoryCacheDestroy(MorseMemoryCache *cache) {
+  if (!cache) {
+    return;
+  }
+  for (MemoryEntry *entry = cache->newest; entry;) {
+    MemoryEntry *older = entry->older;
+    free(entry);
+    entry = older;
+  }
+  pthread_mutex_destroy(&cache->lock);
+  free(cache->buckets);
+  free(cache);
+}
+
+bool morseMemoryCacheGet(MorseMemoryCache *cache, uint64_t key, char *out,
+                         size_t capacity, size_t *length) {
+  pthread_mutex_lock(&cache->lock);
+  MemoryEntry *entry = cache->buckets[key & (cache->bucketCount - 1)];
+  while (entry && entry->key != key) {
+    entry = entry->chain;
+  }
+  if (!entry) {
+    cache->misses++;
+  } else if (entry->length <= capacity) {
+    memcpy(out, entry->data, entry->length);
+    cache->hits++;
+    makeNewest(cache, entry);
+  }
+  if (entry) {
+    *length = entry->length;
+  }
+  pthread_mutex_unlock(&cache->lock);
+  return entry != NULL;
+}
+
+void morseMemoryCachePut(MorseMemoryCache *cache, uint64_t key,
+                         const char *data, size_t length) {
+  if (length > cache->limit) {
+    return;
+  }
+  // Copied before taking the lock, which the other threads wait on
+  MemoryEntry *added = malloc(sizeof(*added) + length);
+  if (!added) {
+    return;
+  }
+  added->key = key;
+  added->length = length;
+  memcpy(added->data, data, length);
+
+  pthread_mutex_lock(&cache->lock);
+  MemoryEntry **bucket = &cache->buckets[key & (cache->bucketCount - 1)];
+  MemoryEntry *entry = *bucket;
+  while (entry && entry->key != key) {
+    entry = entry->chain;
+  }
+  if (entry) {
+    // Another thread converted the same request first
+    pthread_mutex_unlock(&cache->lock);
+    free(added);
+    return;
+  }
+  added->chain = *bucket;
+  *bucket = added;
+  added->newer = added->older = NULL;
+  makeNewest(cache, added);
+  cache->size += length;
+  cache->count++;
+  while (cache->size > cache->limit) {
+    MemoryEntry *oldest = cache->oldest;
+    unlinkEntry(cache, oldest);
+    cache->evictions++;
+    free(oldest);
+  }
+  if (cache->count > cache->bucketCount) {
+    growBuckets(cache);
+  }
+  pthread_mutex_unlock(&cache->lock);
+}
+
+void morseMemoryCacheReport(MorseMemoryCache *cache, MorseStats *stats) {
+  pthread_mutex_lock(&cache->lock);
+  stats->cacheHits = cache->hits;
+  stats->cacheMisses = cache->misses;
+  stats->cacheEvictions = cache->evictions;
+  stats->cacheBytes = (long long)cache->size;
+  stats->cacheLimit = (long long)cache->limit;
+  pthread_mutex_unlock(&cache->lock);
+}
+
+/* Take an entry out of its bucket and the LRU list */
+static void unlinkEntry(MorseMemoryCache *cache, MemoryEntry *entry) {
+  MemoryEntry **link = &cache->buckets[entry->key & (cache->bucketCount - 1)];
+  while (*link != entry) {
+    link = &(*link)->chain;
+  }
+  *link = entry->chain;
+  if (entry->newer) {
+    entry->newer->older = entry->older;
+  } else {
+    cache->newest = entry->older;
+  }
+  if (entry->older) {
+    entry->older->newer = entry->newer;
+  } else {
+    cache->oldest = entry->newer;
+  }
+  cache->size -= entry->length;
+  cache->count--;
+}
+
+/* Move an entry, or add a new one, to the front of the LRU list */
+static void makeNewest(MorseMemoryCache *cache, MemoryEntry *entry) {
+  if (cache->newest == entry) {
+    return;
+  }
+  if (entry->newer) {
+    entry->newer->older = entry->older;
+  }
+  if (entry->older) {
+    entry->older->newer = entry->newer;
+  } else if (cache->oldest == entry) {
+    cache->oldest = entry->newer;
+  }
+  entry->newer = NULL;
+  entry->older = cache->newest;
+  if (cache->newest) {
+    cache->newest->newer = entry;
+  }
+  cache->newest = entry;
+  if (!cache->oldest) {
+    cache->oldest = entry;
+  }
+}
+
+/* Double the buckets, keeping chains short; stays as it is if out of
+ * memory */
+static void growBuckets(MorseMemoryCache *cache) {
+  size_t bucketCount = cache->bucketCount * 2;
+  MemoryEntry **buckets = calloc(bucketCount, sizeof(*buckets));
+  if (!buckets) {
+    return;
+  }
+  for (MemoryEntry *entry = cache->newest; entry; entry = entry->older) {
+    MemoryEntry **bucket = &buckets[entry->key & (bucketCount - 1)];
+    entry->chain = *bucket;
+    *bucket = entry;
+  }
+  free(cache->buckets);
+  cache->buckets = buckets;
+  cache->bucketCount = bucketCount;
+}
@@ -0,0 +1,138 @@
+/**
+ * @file morse_channels.c
+ * @brief Structure-of-arrays decoder of interleaved Morse code streams
+ * @author Diego Rubio Carrera
+ */
+
+#include <morse_channels.h>
+#include <morse_tables.h>
+#include <stdlib.h>
+
+/* Channels advanced together: one cache line of each input row */
+#define CHANNEL_TILE 64
+
+struct MorseChannels {
+  size_t count;
+  unsigned char *symbols; ///< MORSE_CHANNEL_DECODE index of each channel
+  unsigned char *spaces;  ///< spaces since each channel's last element
+  size_t *lengths;        ///< output cursor of each channel
+};
+
+static void decodeTile(MorseChannels *channels, size_t base, size_t width,
+                       const char *batch, size_t steps, char *out,
+                       size_t stride);
+
+MorseChannels *morseChannelsCreate(size_t channelCount) {
+  MorseChannels *channels = calloc(1, sizeof(*channels));
+  if (!channels) {
+    return NULL;
+  }
+  // One entry at least, so no channels is not taken for a failed malloc()
+  size_t entries = channelCount ? channelCount : 1;
+  channels->count = channelCount;
+  channels->symbols = malloc(entries);
+  channels->spaces = calloc(entries, 1);
+  channels->lengths = calloc(entries, sizeof(*channels->lengths));
+  if (!channels->symbols || !channels->spaces || !channels->lengths) {
+    morseChannelsDestroy(channels);
+    return NULL;
+  }
+  for (size_t c = 0; c < channelCount; c++) {
+    channels->symbols[c] = MORSE_CHANNEL_EMPTY;
+  }
+  return channels;
+}
+
+void morseChannelsDestroy(MorseChannels *channels) {
+  if (!channels) {
+    return;
+  }
+  free(channels->symbols);
+  free(channels->spaces);
+  free(channels->lengths);
+  free(channels);
+}
+
+void morseChannelsDecode(MorseChannels *channels, const char *batch,
+                         size_t steps, char *out, size_t stride) {
+  for (size_t c = 0; c < channels->count; c++) {
+    channels->lengths[c] = 0;
+  }
+  for (size_t base = 0; base < channels->count; base += CHANNEL_TILE) {
+    size_t width = channels->count - base;
+    width = width < CHANNEL_TILE ? width : CHANNEL_TILE;
+    decodeTile(channels, base, width, batch, steps, out, stride);
+  }
+}
+
+const size_t *morseChannelsLengths(const MorseChannels *channels) {
+  return channels->lengths;
+}
+
+size_t morseChannelsFinish(MorseChannels *channels, size_t channel,
+                           char *out) {
+  char c = MORSE_CHANNEL_DECODE[channels->symbols[channel]];
+  channels->symbols[channel] = MORSE_CHANNEL_EMPTY;
+  channels->spaces[channel] = 0;
+  if (c == '\0') {
+    return 0;
+  }
+  out[0] = c;
+  return 1;
+}
+
+/* Every step of channels base to base + width - 1. A step first updates
+ * the states of the whole row without a branch, noting the symbol each
+ * channel ended and whether it ended a word, then writes them out: both
+ * bytes are always stored and the cursor moves past those that count.
+ * ReqFunc14, ReqFunc16, ReqFunc18, ReqFunc20, ReqFunc22, ReqFunc24,
+ * ReqFunc28 as in morseDecoderFeedScalar() */
+static void decodeTile(MorseChannels *channels, size_t base, size_t width,
+                       const char *batch, size_t steps, char *out,
+                       size_t stride) {
+  unsigned char *restrict symbols = channels->symbols + base;
+  unsigned char *restrict spaces = channels->spaces + base;
+  size_t *restrict lengths = channels->lengths + base;
+  unsigned char ended[CHANNEL_TILE];
+  unsigned char words[CHANNEL_TILE];
+  char *tileOut = out + base * stride;
+
+  for (size_t s = 0; s < steps; s++) {
+    const unsigned char *restrict row =
+        (const unsigned char *)batch + s * channels->count + base;
+    for (size_t k = 0; k < width; k++) {
+      // Every test is a mask of all ones or zeros, which the compiler
+      // keeps in vector lanes where a conditional would be a branch
+      unsigned char b = row[k];
+      unsigned char symbol = symbols[k];
+      unsigned char space = spaces[k];
+      unsigned char skip = (unsigned char)-((b == '\n') | (b == '\r'));
+      unsigned char end = (unsigned char)-((b == ' ') | (b == '/'));
+      unsigned char element = (unsigned char)-((b == '.') | (b == '-'));
+      // A byte other than '.' and '-', or one element too many, makes the
+      // symbol undecodable until it ends
+      unsigned char invalid =
+          (unsigned char)((symbol >= MORSE_CHANNEL_INVALID ? 0xFF : 0) |
+                          ~element);
+      unsigned char grown =
+          (unsigned char)((symbol + symbol) | (b == '-') | invalid);
+      unsigned char counted = (unsigned char)((space + 1) & -(b == ' '));
+      unsigned char third = (unsigned char)-(counted == 3);
+      ended[k] = (unsigned char)((symbol & end) |
+                                 (MORSE_CHANNEL_EMPTY & ~end));
+      words[k] = (unsigned char)((b == '/') | (counted == 3));
+      spaces[k] = (unsigned char)((space & skip) | (counted & ~third & ~skip));
+      symbols[k] = (unsigned char)((symbol & skip) |
+                                   (((MORSE_CHANNEL_EMPTY & end) |
+                                     (grown & ~end)) & ~skip));
+    }
+    for (size_t k = 0; k < width; k++) {
+      char c = MORSE_CHANNEL_DECODE[ended[k]];
+      size_t flushed = c != '\0';
+      char *channelOut = tileOut + k * stride + lengths[k];
+      channelOut[0] = flushed ? c : ' ';
+      channelOut[flushed] = ' ';
+      lengths[k] += flushed + words[k];
+    }
+  }
+}
@@ -0,0 +1,319 @@
+/**
+ * @file morse_codec.c
+ * @brief Table-driven incremental Morse code encoder and decoder
+ * @author Diego Rubio Carrera
+ */
+
+#include <morse_codec.h>
+#include <morse_simd.h>
+#include <morse_tables.h>
+#include <string.h>
+
+/* Decoder output staged per step by morseDecodedLength() */
+#define MEASURE_STAGING 4096
+
+static const MorseCode *getCharacterCode(char c);
+static char getCodeCharacter(unsigned int code, size_t codeLength);
+
+/* Get the table entry (code and length) for a character, NULL if
+ * unsupported */
+static const MorseCode *getCharacterCode(char c) {
+  const MorseCode *entry = &MORSE_ENCODE_TABLE[(unsigned char)c];
+  return entry->length > 0 ? entry : NULL;
+}
+
+/* Get character from a Morse code given as dash bits and element count */
+static char getCodeCharacter(unsigned int code, size_t codeLength) {
+  if (codeLength == 0 || codeLength > MORSE_MAX_CODE_LENGTH) {
+    return '\0'; // Code not found
+  }
+  return MORSE_DECODE_TABLE[MORSE_DECODE_INDEX(code, codeLength)];
+}
+
+void morseEncoderInit(MorseEncoder *encoder, bool useSlashWordspacer) {
+  encoder->useSlashWordspacer = useSlashWordspacer;
+  encoder->lastWasSpace = false;
+  encoder->firstChar = true;
+}
+
+size_t morseEncoderFeed(MorseEncoder *encoder, const char *text,
+                        size_t length, char *out) {
+  return morseEncoderFeedKernel(encoder, morseBestKernel(), text, length,
+                                out);
+}
+
+/* Encode text - ReqFunc13, ReqFunc15, ReqFunc17, ReqFunc19, ReqFunc21,
+ * ReqFunc23, ReqFunc25-28, ReqOptFunc02 */
+size_t morseEncoderFeedKernel(MorseEncoder *encoder, MorseKernel kernel,
+                              const char *text, size_t length, char *out) {
+  // Write cursor into out; every append is O(length of the appended code)
+  char *cursor = out;
+  const char *wordSpacer = encoder->useSlashWordspacer ? " / " : "   ";
+  bool lastWasSpace = encoder->lastWasSpace;
+  bool firstChar = encoder->firstChar;
+  bool simd = morseSimdSupported(kernel);
+  size_t i = 0;
+
+  while (i < length) {
+    // Letters, digits and spaces go through the SIMD fast path once the
+    // first symbol is out; it stops at every byte it does not handle
+    if (simd && !firstChar && length - i >= MORSE_SIMD_ENCODE_BLOCK) {
+      size_t consumed;
+      encoder->lastWasSpace = lastWasSpace;
+      cursor += morseSimdEncode(encoder, kernel, text + i, length - i, cursor,
+                                &consumed);
+      lastWasSpace = encoder->lastWasSpace;
+      i += consumed;
+      if (i == length) {
+        break;
+      }
+    }
+
+    char currentChar = text[i++];
+
+    // ReqFunc28: Skip newlines and carriage returns
+    if (currentChar == '\n' || currentChar == '\r') {
+      continue;
+    }
+
+    // Handle word separation
+    if (currentChar == ' ') {
+      if (!lastWasSpace && !firstChar) {
+        // ReqFunc27: triple space, ReqOptFunc02: " / " between words
+        memcpy(cursor, wordSpacer, 3);
+        cursor += 3;
+      }
+      lastWasSpace = true;
+      continue;
+    }
+
+    // ReqFunc26: Add space between letters (except before first letter)
+    if (!firstChar && !lastWasSpace) {
+      *cursor++ = ' ';
+    }
+
+    const MorseCode *entry = getCharacterCode(currentChar);
+    if (entry) {
+      memcpy(cursor, entry->code, entry->length);
+      cursor += entry->length;
+    } else {
+      // ReqFunc25: Output * for unsupported characters
+      *cursor++ = '*';
+    }
+
+    lastWasSpace = false;
+    firstChar = false;
+  }
+
+  encoder->lastWasSpace = lastWasSpace;
+  encoder->firstChar = firstChar;
+  return (size_t)(cursor - out);
+}
+
+/* Whole 64-byte blocks are counted from SIMD byte-class masks, the tail by
+ * the scalar reference */
+size_t morseEncoderMeasure(MorseEncoder *encoder, const char *text,
+                           size_t length) {
+  MorseKernel kernel = morseBestKernel();
+  size_t blocks = morseSimdSupported(kernel) ? length / MORSE_SIMD_BLOCK : 0;
+  size_t total = 0;
+  if (blocks > 0) {
+    total = morseSimdMeasure(encoder, kernel, text, blocks);
+  }
+  size_t done = blocks * MORSE_SIMD_BLOCK;
+  return total +
+         morseEncoderMeasureScalar(encoder, text + done, length - done);
+}
+
+/* Same state machine as morseEncoderFeed, counting instead of writing */
+size_t morseEncoderMeasureScalar(MorseEncoder *encoder, const char *text,
+                                 size_t length) {
+  size_t total = 0;
+  bool lastWasSpace = encoder->lastWasSpace;
+  bool firstChar = encoder->firstChar;
+
+  for (size_t i = 0; i < length; i++) {
+    char currentChar = text[i];
+    if (currentChar == '\n' || currentChar == '\r') {
+      continue;
+    }
+
+    if (currentChar == ' ') {
+      if (!lastWasSpace && !firstChar) {
+        total += 3;
+      }
+      lastWasSpace = true;
+      continue;
+    }
+
+    if (!firstChar && !lastWasSpace) {
+      total++;
+    }
+    const MorseCode *entry = getCharacterCode(currentChar);
+    total += entry ? entry->length : 1;
+
+    lastWasSpace = false;
+    firstChar = false;
+  }
+
+  encoder->lastWasSpace = lastWasSpace;
+  encoder->firstChar = firstChar;
+  return total;
+}
+
+size_t morseEncodedLength(const char *text, size_t length) {
+  MorseEncoder encoder;
+  morseEncoderInit(&encoder, false);
+  return morseEncoderMeasure(&encoder, text, length);
+}
+
+size_t morseEncoderFinish(MorseEncoder *encoder, char *out) {
+  (void)out;
+  morseEncoderInit(encoder, encoder->useSlashWordspacer);
+  return 0;
+}
+
+void morseDecoderInit(MorseDecoder *decoder) {
+  decoder->code = 0;
+  decoder->codeLength = 0;
+  decoder->spaceCount = 0;
+  decoder->offset = 0;
+  decoder->symbolStart = 0;
+  decoder->malformed = NULL;
+  decoder->malformedContext = NULL;
+}
+
+void morseDecoderSetStrict(MorseDecoder *decoder,
+                           MorseMalformedHandler handler, void *context) {
+  decoder->malformed = handler;
+  decoder->malformedContext = context;
+}
+
+size_t morseDecoderFeed(MorseDecoder *decoder, const char *morse,
+                        size_t length, char *out) {
+  return morseDecoderFeedKernel(decoder, morseBestKernel(), morse, length,
+                                out);
+}
+
+/* Whole 64-byte blocks go through the SIMD tokenizer, the tail through the
+ * scalar reference decoder */
+size_t morseDecoderFeedKernel(MorseDecoder *decoder, MorseKernel kernel,
+                              const char *morse, size_t length, char *out) {
+  size_t blocks = morseSimdSupported(kernel) ? length / MORSE_SIMD_BLOCK : 0;
+  size_t resultIndex = 0;
+  if (blocks > 0) {
+    resultIndex = morseSimdDecode(decoder, kernel, morse, blocks, out);
+  }
+  size_t done = blocks * MORSE_SIMD_BLOCK;
+  return resultIndex + morseDecoderFeedScalar(decoder, morse + done,
+                                              length - done,
+                                              out + resultIndex);
+}
+
+/* Decode Morse code - ReqFunc14, ReqFunc16, ReqFunc18, ReqFunc20, ReqFunc22,
+ * ReqFunc24, ReqFunc28 */
+size_t morseDecoderFeedScalar(MorseDecoder *decoder, const char *morse,
+                              size_t length, char *out) {
+  unsigned int code = decoder->code;
+  size_t codeLength = decoder->codeLength;
+  int spaceCount = decoder->spaceCount;
+  size_t symbolStart = decoder->symbolStart;
+  size_t resultIndex = 0;
+
+  for (size_t i = 0; i < length; i++) {
+    // ReqFunc28: Skip newlines and carriage returns
+    if (morse[i] == '\n' || morse[i] == '\r') {
+      continue;
+    }
+
+    if (morse[i] == ' ') {
+      spaceCount++;
+
+      if (spaceCount == 1 && codeLength > 0) {
+        // End of a character (single space)
+        char c = getCodeCharacter(code, codeLength);
+        if (c != '\0') {
+          out[resultIndex++] = c;
+        } else if (decoder->malformed) {
+          decoder->malformed(decoder->malformedContext, symbolStart);
+        }
+        code = 0;
+        codeLength = 0;
+      } else if (spaceCount == 3) {
+        // End of a word (triple space)
+        out[resultIndex++] = ' ';
+        spaceCount = 0;
+      }
+    } else if (morse[i] == '/') {
+      // Handle slash word separator
+      if (codeLength > 0) {
+        char c = getCodeCharacter(code, codeLength);
+        if (c != '\0') {
+          out[resultIndex++] = c;
+        } else if (decoder->malformed) {
+          decoder->malformed(decoder->malformedContext, symbolStart);
+        }
+        code = 0;
+        codeLength = 0;
+      }
+      out[resultIndex++] = ' ';
+      spaceCount = 0;
+    } else {
+      // Part of a morse character; anything but '.' and '-' or more than
+      // MORSE_MAX_CODE_LENGTH elements makes the symbol undecodable
+      spaceCount = 0;
+      if (codeLength == 0) {
+        symbolStart = decoder->offset + i;
+      }
+      if (morse[i] != '.' && morse[i] != '-') {
+        codeLength = MORSE_MAX_CODE_LENGTH + 1;
+      } else if (codeLength < MORSE_MAX_CODE_LENGTH) {
+        code |= (unsigned int)(morse[i] == '-') << codeLength++;
+      } else {
+        codeLength = MORSE_MAX_CODE_LENGTH + 1;
+      }
+    }
+  }
+
+  decoder->code = code;
+  decoder->codeLength = codeLength;
+  decoder->spaceCount = spaceCount;
+  decoder->symbolStart = symbolStart;
+  decoder->offset += length;
+  return resultIndex;
+}
+
+/* Flush the symbol still pending at end of input */
+size_t morseDecoderFinish(MorseDecoder *decoder, char *out) {
+  size_t resultIndex = 0;
+  if (decoder->codeLength > 0) {
+    char c = getCodeCharacter(decoder->code, decoder->codeLength);
+    if (c != '\0') {
+      out[resultIndex++] = c;
+    } else if (decoder->malformed) {
+      decoder->malformed(decoder->malformedContext, decoder->symbolStart);
+    }
+  }
+  MorseMalformedHandler malformed = decoder->malformed;
+  void *malformedContext = decoder->malformedContext;
+  morseDecoderInit(decoder);
+  morseDecoderSetStrict(decoder, malformed, malformedContext);
+  return resultIndex;
+}
+
+/* The decoder's output is no longer than its input, so decoding into a
+ * small staging buffer and counting is exact and runs at kernel speed */
+size_t morseDecodedLength(const char *morse, size_t length) {
+  char staged[MORSE_DECODER_FEED_BOUND(MEASURE_STAGING)];
+  MorseDecoder decoder;
+  MorseKernel kernel = morseBestKernel();
+  size_t total = 0;
+  morseDecoderInit(&decoder);
+  for (size_t offset = 0; offset < length; offset += MEASURE_STAGING) {
+    size_t step = length - offset < MEASURE_STAGING ? length - offset
+                                                    : MEASURE_STAGING;
+    total += morseDecoderFeedKernel(&decoder, kernel, morse + offset, step,
+                                    staged);
+  }
+  return total + morseDecoderFinish(&decoder, staged);
+}
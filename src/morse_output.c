@@ -0,0 +1,303 @@
+/**
+ * @file morse_output.c
+ * @brief Buffered output writer for converted text
+ * @author Diego Rubio Carrera
+ */
+
+#define _GNU_SOURCE // O_DIRECT
+
+#include <errno.h>
+#include <fcntl.h>
+#include <morse_output.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#ifndef _WIN32
+#include <sys/uio.h> // writev
+#endif
+
+/* O_DIRECT transfers must be aligned to the logical block size, which is
+ * at most a page on the file systems we care about */
+#define DIRECT_ALIGNMENT 4096
+
+static bool allocateBuffer(MorseWriter *writer);
+static bool writeSlices(MorseWriter *writer, const MorseSlice *slices,
+                        size_t count);
+static bool flushBuffer(MorseWriter *writer, size_t length);
+
+bool morseWriterOpenFd(MorseWriter *writer, int fd) {
+  struct stat fdStat;
+  *writer = (MorseWriter){fd, NULL, 0, false, false, false, false, 0};
+  // Pipes and terminals are read while we write: never hold output back
+  writer->eager = fstat(fd, &fdStat) != 0 || !S_ISREG(fdStat.st_mode);
+  return allocateBuffer(writer);
+}
+
+bool morseWriterOpenFile(MorseWriter *writer, const char *path,
+                         unsigned int flags) {
+  *writer = (MorseWriter){-1, NULL, 0, false, false, false, false, 0};
+  if (!allocateBuffer(writer)) {
+    return false;
+  }
+  if (!morseWriterReopen(writer, path, flags)) {
+    int savedErrno = errno;
+    free(writer->buffer);
+    writer->buffer = NULL;
+    errno = savedErrno;
+    return false;
+  }
+  return true;
+}
+
+bool morseWriterReopen(MorseWriter *writer, const char *path,
+                       unsigned int flags) {
+  int openFlags = O_WRONLY | O_CREAT | O_TRUNC;
+  int fd = -1;
+  bool direct = false;
+#ifdef O_DIRECT
+  if (flags & MORSE_WRITER_DIRECT) {
+    // tmpfs and others refuse O_DIRECT with EINVAL
+    fd = open(path, openFlags | O_DIRECT, 0666);
+    direct = fd >= 0;
+  }
+#endif
+  if (fd < 0) {
+    fd = open(path, openFlags, 0666);
+  }
+  if (fd < 0) {
+    return false;
+  }
+
+  writer->fd = fd;
+  writer->direct = direct;
+  writer->ownsFd = true;
+#ifdef POSIX_FADV_DONTNEED
+  writer->dropCache = (flags & MORSE_WRITER_DIRECT) && !direct;
+#endif
+  return true;
+}
+
+int morseWriterFd(const MorseWriter *writer) { return writer->fd; }
+
+bool morseWriterWrite(MorseWriter *writer, const char *data, size_t length) {
+  MorseSlice slice = {data, length};
+  return morseWriterWriteParts(writer, &slice, 1);
+}
+
+/* Small writes are collected in the buffer; anything larger goes out in one
+ * writev(2) together with what is buffered, straight from the caller's
+ * memory. O_DIRECT needs aligned transfers, so there everything passes
+ * through the buffer. */
+bool morseWriterWriteParts(MorseWriter *writer, const MorseSlice *parts,
+                           size_t count) {
+  size_t total = 0;
+  for (size_t i = 0; i < count; i++) {
+    total += parts[i].length;
+  }
+
+  if (!writer->eager && writer->used + total <= MORSE_WRITER_BUFFER_SIZE) {
+    for (size_t i = 0; i < count; i++) {
+      memcpy(writer->buffer + writer->used, parts[i].data, parts[i].length);
+      writer->used += parts[i].length;
+    }
+    return true;
+  }
+
+  if (writer->direct) {
+    for (size_t i = 0; i < count; i++) {
+      const char *data = parts[i].data;
+      size_t remaining = parts[i].length;
+      while (remaining > 0) {
+        size_t space = MORSE_WRITER_BUFFER_SIZE - writer->used;
+        size_t step = remaining < space ? remaining : space;
+        memcpy(writer->buffer + writer->used, data, step);
+        writer->used += step;
+        data += step;
+        remaining -= step;
+        if (writer->used == MORSE_WRITER_BUFFER_SIZE &&
+            !flushBuffer(writer, MORSE_WRITER_BUFFER_SIZE)) {
+          return false;
+        }
+      }
+    }
+    return true;
+  }
+
+  return writeSlices(writer, parts, count);
+}
+
+bool morseWriterFlush(MorseWriter *writer) {
+  size_t length = writer->direct
+                      ? writer->used - writer->used % DIRECT_ALIGNMENT
+                      : writer->used;
+  return length == 0 || flushBuffer(writer, length);
+}
+
+bool morseWriterFinish(MorseWriter *writer) {
+  bool ok = true;
+#ifdef O_DIRECT
+  if (writer->direct && writer->used % DIRECT_ALIGNMENT != 0) {
+    // Write the aligned part directly, the short tail through the cache
+    size_t aligned = writer->used - writer->used % DIRECT_ALIGNMENT;
+    ok = flushBuffer(writer, aligned);
+    int statusFlags = fcntl(writer->fd, F_GETFL);
+    if (ok && (statusFlags < 0 ||
+               fcntl(writer->fd, F_SETFL, statusFlags & ~O_DIRECT) != 0)) {
+      ok = false;
+    }
+  }
+#endif
+  if (ok && writer->used > 0) {
+    ok = flushBuffer(writer, writer->used);
+  }
+
+  int savedErrno = errno;
+  if (writer->ownsFd && close(writer->fd) != 0 && ok) {
+    ok = false;
+    savedErrno = errno;
+  }
+  // Whatever could not be written belongs to the finished output
+  *writer = (MorseWriter){-1, writer->buffer, 0, false, false, false, false, 0};
+  errno = savedErrno;
+  return ok;
+}
+
+bool morseWriterClose(MorseWriter *writer) {
+  bool ok = morseWriterFinish(writer);
+  free(writer->buffer);
+  writer->buffer = NULL;
+  return ok;
+}
+
+/* Page-aligned, as O_DIRECT requires */
+static bool allocateBuffer(MorseWriter *writer) {
+#ifdef _WIN32
+  writer->buffer = malloc(MORSE_WRITER_BUFFER_SIZE);
+#else
+  void *buffer = NULL;
+  if (posix_memalign(&buffer, DIRECT_ALIGNMENT, MORSE_WRITER_BUFFER_SIZE) !=
+      0) {
+    buffer = NULL;
+  }
+  writer->buffer = buffer;
+#endif
+  if (!writer->buffer) {
+    errno = ENOMEM;
+    return false;
+  }
+  return true;
+}
+
+/* Write the buffered bytes followed by slices, retrying short writes */
+static bool writeSlices(MorseWriter *writer, const MorseSlice *slices,
+                        size_t count) {
+  size_t total = writer->used;
+  for (size_t i = 0; i < count; i++) {
+    total += slices[i].length;
+  }
+
+#ifdef _WIN32
+  total -= writer->used; // accounted for by flushBuffer()
+  if (writer->used > 0 && !flushBuffer(writer, writer->used)) {
+    return false;
+  }
+  for (size_t i = 0; i < count; i++) {
+    const char *data = slices[i].data;
+    size_t remaining = slices[i].length;
+    while (remaining > 0) {
+      ssize_t written = write(writer->fd, data, remaining);
+      if (written < 0 && errno == EINTR) {
+        continue;
+      }
+      if (written < 0) {
+        return false;
+      }
+      data += written;
+      remaining -= (size_t)written;
+    }
+  }
+#else
+  // The buffer and each slice become one iovec
+  struct iovec vectors[16];
+  size_t vectorCount = 0;
+  size_t next = 0;
+  if (writer->used > 0) {
+    vectors[vectorCount++] = (struct iovec){writer->buffer, writer->used};
+  }
+
+  while (vectorCount > 0 || next < count) {
+    while (next < count &&
+           vectorCount < sizeof(vectors) / sizeof(vectors[0])) {
+      if (slices[next].length > 0) {
+        vectors[vectorCount++] =
+            (struct iovec){(void *)slices[next].data, slices[next].length};
+      }
+      next++;
+    }
+    if (vectorCount == 0) {
+      break;
+    }
+
+    ssize_t written = writev(writer->fd, vectors, (int)vectorCount);
+    if (written < 0 && errno == EINTR) {
+      continue;
+    }
+    if (written < 0) {
+      return false;
+    }
+
+    // Drop what was written, keeping the unwritten rest in order
+    size_t done = (size_t)written;
+    size_t first = 0;
+    while (first < vectorCount && done >= vectors[first].iov_len) {
+      done -= vectors[first].iov_len;
+      first++;
+    }
+    if (first < vectorCount) {
+      vectors[first].iov_base = (char *)vectors[first].iov_base + done;
+      vectors[first].iov_len -= done;
+    }
+    memmove(vectors, vectors + first,
+            (vectorCount - first) * sizeof(vectors[0]));
+    vectorCount -= first;
+  }
+  writer->used = 0;
+#endif
+
+#ifdef POSIX_FADV_DONTNEED
+  if (writer->dropCache) {
+    posix_fadvise(writer->fd, (off_t)writer->written, (off_t)total,
+                  POSIX_FADV_DONTNEED);
+  }
+#endif
+  writer->written += (long long)total;
+  return true;
+}
+
+/* Write the first length buffered bytes and keep the rest */
+static bool flushBuffer(MorseWriter *writer, size_t length) {
+  size_t done = 0;
+  while (done < length) {
+    ssize_t written = write(writer->fd, writer->buffer + done, length - done);
+    if (written < 0 && errno == EINTR) {
+      continue;
+    }
+    if (written < 0) {
+      return false;
+    }
+    done += (size_t)written;
+  }
+
+#ifdef POSIX_FADV_DONTNEED
+  if (writer->dropCache) {
+    posix_fadvise(writer->fd, (off_t)writer->written, (off_t)length,
+                  POSIX_FADV_DONTNEED);
+  }
+#endif
+  writer->written += (long long)length;
+  memmove(writer->buffer, writer->buffer + length, writer->used - length);
+  writer->used -= length;
+  return true;
+}
@@ -0,0 +1,235 @@
+/**
+ * @file morse_packed.c
+ * @brief Encoder, decoder and transcoder of the packed binary Morse format
+ * @author Diego Rubio Carrera
+ */
+
+#include <morse_packed.h>
+#include <morse_tables.h>
+#include <string.h>
+
+/* First bytes of every packed header; a NUL never starts Morse text */
+static const char PACKED_MAGIC[3] = {'\0', 'M', 'P'};
+
+/* Format version, the high nibble of the fourth header byte */
+#define PACKED_VERSION 0x10
+
+size_t morsePackedHeader(bool useSlashWordspacer, char *out) {
+  out[0] = PACKED_MAGIC[0];
+  out[1] = PACKED_MAGIC[1];
+  out[2] = PACKED_MAGIC[2];
+  out[3] = (char)(PACKED_VERSION | (useSlashWordspacer ? MORSE_PACKED_SLASH
+                                                       : 0));
+  return MORSE_PACKED_HEADER_SIZE;
+}
+
+MorseFormat morsePackedDetect(const char *data, size_t length) {
+  for (size_t i = 0; i < length && i < MORSE_PACKED_HEADER_SIZE; i++) {
+    bool matches = i < sizeof(PACKED_MAGIC)
+                       ? data[i] == PACKED_MAGIC[i]
+                       : ((unsigned char)data[i] & 0xF0) == PACKED_VERSION;
+    if (!matches) {
+      return MORSE_FORMAT_TEXT;
+    }
+  }
+  return length >= MORSE_PACKED_HEADER_SIZE ? MORSE_FORMAT_PACKED
+                                            : MORSE_FORMAT_UNDECIDED;
+}
+
+/* The text encoder's state machine, with a token for every symbol and
+ * word gap and nothing for separators - ReqFunc25-28 */
+size_t morsePackedEncode(MorseEncoder *encoder, const char *text,
+                         size_t length, char *out) {
+  bool lastWasSpace = encoder->lastWasSpace;
+  bool firstChar = encoder->firstChar;
+  size_t resultIndex = 0;
+
+  for (size_t i = 0; i < length; i++) {
+    unsigned char token = MORSE_PACKED_TOKENS[(unsigned char)text[i]];
+    if (token == MORSE_PACKED_SKIP) {
+      continue;
+    }
+    if (token == MORSE_PACKED_GAP) {
+      if (!lastWasSpace && !firstChar) {
+        out[resultIndex++] = (char)MORSE_PACKED_GAP;
+      }
+      lastWasSpace = true;
+      continue;
+    }
+    out[resultIndex++] = (char)token;
+    lastWasSpace = false;
+    firstChar = false;
+  }
+
+  encoder->lastWasSpace = lastWasSpace;
+  encoder->firstChar = firstChar;
+  return resultIndex;
+}
+
+size_t morsePackedEncodedLength(const char *text, size_t length) {
+  bool lastWasSpace = false;
+  bool firstChar = true;
+  size_t total = 0;
+
+  for (size_t i = 0; i < length; i++) {
+    unsigned char token = MORSE_PACKED_TOKENS[(unsigned char)text[i]];
+    if (token == MORSE_PACKED_SKIP) {
+      continue;
+    }
+    if (token == MORSE_PACKED_GAP) {
+      total += !lastWasSpace && !firstChar;
+      lastWasSpace = true;
+      continue;
+    }
+    total++;
+    lastWasSpace = false;
+    firstChar = false;
+  }
+  return total;
+}
+
+/* Only '*' and unknown codes decode to nothing, so the branch is almost
+ * always taken and out may be sized exactly */
+size_t morsePackedDecode(const char *packed, size_t length, char *out) {
+  size_t resultIndex = 0;
+  for (size_t i = 0; i < length; i++) {
+    char c = MORSE_PACKED_DECODE[(unsigned char)packed[i]];
+    if (c != '\0') {
+      out[resultIndex++] = c;
+    }
+  }
+  return resultIndex;
+}
+
+size_t morsePackedDecodedLength(const char *packed, size_t length) {
+  size_t total = 0;
+  for (size_t i = 0; i < length; i++) {
+    total += MORSE_PACKED_DECODE[(unsigned char)packed[i]] != '\0';
+  }
+  return total;
+}
+
+bool morsePackedHeaderSlash(const char *header) {
+  return ((unsigned char)header[3] & MORSE_PACKED_SLASH) != 0;
+}
+
+void morseTranscoderInit(MorseTranscoder *transcoder,
+                         bool useSlashWordspacer) {
+  *transcoder = (MorseTranscoder){.useSlashWordspacer = useSlashWordspacer};
+}
+
+/* Token of the pending symbol, which is then cleared */
+static unsigned char takeSymbol(MorseTranscoder *transcoder) {
+  unsigned char token =
+      transcoder->unsupported
+          ? MORSE_PACKED_UNSUPPORTED
+          : (unsigned char)MORSE_DECODE_INDEX(transcoder->code,
+                                              transcoder->codeLength);
+  transcoder->code = 0;
+  transcoder->codeLength = 0;
+  transcoder->unsupported = false;
+  transcoder->afterSymbol = true;
+  return token;
+}
+
+/* The encoder writes a symbol, then one space before the next symbol or
+ * the word spacer for a space of the text; every other layout has no
+ * tokens that give it back, so it stops the conversion - ReqFunc25-28 */
+size_t morsePackedFromText(MorseTranscoder *transcoder, const char *morse,
+                           size_t length, char *out) {
+  const char *wordSpacer = transcoder->useSlashWordspacer ? " / " : "   ";
+  size_t resultIndex = 0;
+
+  for (size_t i = 0; i < length && !transcoder->failed; i++) {
+    char c = morse[i];
+    bool pending = transcoder->codeLength > 0 || transcoder->unsupported;
+    bool valid = true;
+    if (c == '\n' || c == '\r') {
+      // Skipped, as the decoder skips them
+    } else if (c == '.' || c == '-' || c == '*') {
+      // A symbol starts after one space or a complete word spacer, and
+      // '*' is a symbol of its own
+      if (!pending) {
+        valid = transcoder->spacing != 2;
+        transcoder->spacing = 0;
+      } else {
+        valid = c != '*' && !transcoder->unsupported &&
+                transcoder->codeLength < MORSE_PACKED_MAX_ELEMENTS;
+      }
+      if (valid && c == '*') {
+        transcoder->unsupported = true;
+      } else if (valid) {
+        transcoder->code |= (unsigned int)(c == '-')
+                            << transcoder->codeLength++;
+      }
+    } else if (c == ' ' || c == '/') {
+      if (pending) {
+        out[resultIndex++] = (char)takeSymbol(transcoder);
+      }
+      // Only one word spacer follows a symbol, and nothing precedes the
+      // first one
+      valid = transcoder->afterSymbol && transcoder->spacing < 3 &&
+              c == wordSpacer[transcoder->spacing];
+      if (valid && ++transcoder->spacing == 3) {
+        out[resultIndex++] = (char)MORSE_PACKED_GAP;
+      }
+    } else {
+      valid = false;
+    }
+    if (!valid) {
+      transcoder->failed = true;
+      transcoder->errorOffset = transcoder->offset + i;
+    }
+  }
+  transcoder->offset += length;
+  return resultIndex;
+}
+
+size_t morsePackedFromTextFinish(MorseTranscoder *transcoder, char *out) {
+  if (transcoder->failed) {
+    return 0;
+  }
+  if (transcoder->codeLength > 0 || transcoder->unsupported) {
+    out[0] = (char)takeSymbol(transcoder);
+    return 1;
+  }
+  // A space of the text is a complete word spacer
+  if (transcoder->spacing == 1 || transcoder->spacing == 2) {
+    transcoder->failed = true;
+    transcoder->errorOffset = transcoder->offset;
+  }
+  return 0;
+}
+
+size_t morsePackedToText(MorseTranscoder *transcoder, const char *packed,
+                         size_t length, char *out) {
+  const char *wordSpacer = transcoder->useSlashWordspacer ? " / " : "   ";
+  bool afterSymbol = transcoder->afterSymbol;
+  size_t resultIndex = 0;
+
+  for (size_t i = 0; i < length; i++) {
+    unsigned int token = (unsigned char)packed[i];
+    if (token == MORSE_PACKED_GAP) {
+      memcpy(out + resultIndex, wordSpacer, 3);
+      resultIndex += 3;
+      afterSymbol = false;
+      continue;
+    }
+    if (afterSymbol) {
+      out[resultIndex++] = ' ';
+    }
+    if (token == MORSE_PACKED_UNSUPPORTED) {
+      out[resultIndex++] = '*';
+    } else {
+      // The marker bit above the elements gives the symbol's length
+      unsigned int elements = 31 - (unsigned int)__builtin_clz(token);
+      for (unsigned int e = 0; e < elements; e++) {
+        out[resultIndex++] = (token >> e) & 1 ? '-' : '.';
+      }
+    }
+    afterSymbol = true;
+  }
+
+  transcoder->afterSymbol = afterSymbol;
+  return resultIndex;
+}
@@ -0,0 +1,408 @@
+/**
+ * @file morse_parallel.c
+ * @brief Thread pool and chunked multi-threaded encoder and decoder
+ * @author Diego Rubio Carrera
+ */
+
+#include <morse_parallel.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* Chunks per thread, so uneven chunks still keep every thread busy */
+#define CHUNKS_PER_THREAD 4
+
+/* Inputs are never cut into chunks smaller than this */
+#define MIN_CHUNK_SIZE (64 * 1024)
+
+/* How far a chunk boundary may move forward to reach a word boundary */
+#define WORD_ALIGN_WINDOW 4096
+
+/* First byte of a chunk that is not CR/LF */
+typedef enum {
+  CHUNK_EMPTY,
+  CHUNK_STARTS_SPACE,
+  CHUNK_STARTS_SYMBOL
+} ChunkStart;
+
+typedef struct {
+  size_t start;  // input offset
+  size_t length; // input bytes
+  ChunkStart firstKind;
+  bool hasSymbol;        // chunk emits at least one symbol
+  bool endsWithSpace;    // last non-CR/LF byte is a space
+  size_t measured;       // output bytes when started like a fresh text
+  MorseEncoder encoder;  // exact state at chunk start
+  MorseDecoder decoder;  // exact state at chunk start
+  size_t decoded;        // bytes decoded into the scratch buffer
+  size_t offset;         // output offset
+} ParallelChunk;
+
+typedef void (*ParallelTask)(MorseParallel *parallel, size_t index);
+
+struct MorseParallel {
+  unsigned int threadCount;
+  unsigned int workerCount; // threads started besides the caller
+  pthread_t *workers;
+  pthread_mutex_t lock;
+  pthread_cond_t taskReady;
+  pthread_cond_t taskDone;
+  ParallelTask task;
+  size_t taskCount;
+  size_t nextTask;
+  size_t doneTasks;
+  bool shutdown;
+
+  // Current job, reused across calls
+  const char *input;
+  ParallelChunk *chunks;
+  size_t chunkCapacity;
+  char *output;
+  size_t outputCapacity;
+  char *scratch; // decoder output before it is packed into output
+  size_t scratchCapacity;
+};
+
+static void *workerMain(void *arg);
+static void runTasks(MorseParallel *parallel, ParallelTask task,
+                     size_t taskCount);
+static void runNextTasks(MorseParallel *parallel);
+static bool reserve(char **buffer, size_t *capacity, size_t size);
+static size_t splitInput(MorseParallel *parallel, const char *text,
+                         size_t length);
+static size_t splitMorse(MorseParallel *parallel, const char *morse,
+                         size_t length);
+static void measureChunk(MorseParallel *parallel, size_t index);
+static void encodeChunk(MorseParallel *parallel, size_t index);
+static void decodeChunk(MorseParallel *parallel, size_t index);
+static void packChunk(MorseParallel *parallel, size_t index);
+
+MorseParallel *morseParallelCreate(unsigned int threadCount) {
+  MorseParallel *parallel = calloc(1, sizeof(MorseParallel));
+  if (!parallel) {
+    return NULL;
+  }
+  if (threadCount < 1) {
+    threadCount = 1;
+  }
+  parallel->threadCount = threadCount;
+  parallel->chunkCapacity = (size_t)threadCount * CHUNKS_PER_THREAD;
+  parallel->chunks = malloc(parallel->chunkCapacity * sizeof(ParallelChunk));
+  parallel->workers = malloc(threadCount * sizeof(pthread_t));
+  if (!parallel->chunks || !parallel->workers) {
+    free(parallel->chunks);
+    free(parallel->workers);
+    free(parallel);
+    return NULL;
+  }
+
+  pthread_mutex_init(&parallel->lock, NULL);
+  pthread_cond_init(&parallel->taskReady, NULL);
+  pthread_cond_init(&parallel->taskDone, NULL);
+
+  // A worker that fails to start only costs parallelism, not correctness
+  for (unsigned int i = 0; i + 1 < threadCount; i++) {
+    if (pthread_create(&parallel->workers[parallel->workerCount], NULL,
+                       workerMain, parallel) == 0) {
+      parallel->workerCount++;
+    }
+  }
+  return parallel;
+}
+
+void morseParallelDestroy(MorseParallel *parallel) {
+  if (!parallel) {
+    return;
+  }
+  pthread_mutex_lock(&parallel->lock);
+  parallel->shutdown = true;
+  pthread_cond_broadcast(&parallel->taskReady);
+  pthread_mutex_unlock(&parallel->lock);
+  for (unsigned int i = 0; i < parallel->workerCount; i++) {
+    pthread_join(parallel->workers[i], NULL);
+  }
+
+  pthread_mutex_destroy(&parallel->lock);
+  pthread_cond_destroy(&parallel->taskReady);
+  pthread_cond_destroy(&parallel->taskDone);
+  free(parallel->workers);
+  free(parallel->chunks);
+  free(parallel->output);
+  free(parallel->scratch);
+  free(parallel);
+}
+
+/* Encode in two passes: size every chunk, then encode at exact offsets */
+const char *morseParallelEncode(MorseParallel *parallel, MorseEncoder *encoder,
+                                const char *text, size_t length,
+                                size_t *encodedLength) {
+  size_t chunkCount = splitInput(parallel, text, length);
+  for (size_t i = 0; i < chunkCount; i++) {
+    parallel->chunks[i].encoder.useSlashWordspacer =
+        encoder->useSlashWordspacer;
+  }
+  runTasks(parallel, measureChunk, chunkCount);
+
+  // Prefix sum: the measured sizes assume a chunk starts like a fresh text,
+  // which only differs when it continues a word of the previous chunk
+  MorseEncoder state = *encoder;
+  size_t total = 0;
+  for (size_t i = 0; i < chunkCount; i++) {
+    ParallelChunk *chunk = &parallel->chunks[i];
+    chunk->encoder = state;
+    chunk->offset = total;
+    total += chunk->measured;
+    if (!state.firstChar && !state.lastWasSpace) {
+      if (chunk->firstKind == CHUNK_STARTS_SYMBOL) {
+        total += 1; // ReqFunc26: letter separator
+      } else if (chunk->firstKind == CHUNK_STARTS_SPACE) {
+        total += 3; // ReqFunc27, ReqOptFunc02: word separator
+      }
+    }
+    if (chunk->firstKind != CHUNK_EMPTY) {
+      state.firstChar = state.firstChar && !chunk->hasSymbol;
+      state.lastWasSpace = chunk->endsWithSpace;
+    }
+  }
+
+  if (!reserve(&parallel->output, &parallel->outputCapacity, total)) {
+    return NULL;
+  }
+
+  runTasks(parallel, encodeChunk, chunkCount);
+
+  *encoder = state;
+  *encodedLength = total;
+  return parallel->output;
+}
+
+/* Decode every chunk into its own scratch region, then pack the regions
+ * into the output in order */
+const char *morseParallelDecode(MorseParallel *parallel, MorseDecoder *decoder,
+                                const char *morse, size_t length,
+                                size_t *decodedLength) {
+  size_t chunkCount = splitMorse(parallel, morse, length);
+
+  // A chunk never decodes to more than MORSE_DECODER_FEED_BOUND(length)
+  // bytes, so region i starts at its input offset plus i
+  if (!reserve(&parallel->scratch, &parallel->scratchCapacity,
+               length + chunkCount)) {
+    return NULL;
+  }
+  parallel->chunks[0].decoder = *decoder;
+  for (size_t i = 1; i < chunkCount; i++) {
+    MorseDecoder *chunkDecoder = &parallel->chunks[i].decoder;
+    morseDecoderInit(chunkDecoder);
+    morseDecoderSetStrict(chunkDecoder, decoder->malformed,
+                          decoder->malformedContext);
+    chunkDecoder->offset = decoder->offset + parallel->chunks[i].start;
+  }
+  runTasks(parallel, decodeChunk, chunkCount);
+
+  size_t total = 0;
+  for (size_t i = 0; i < chunkCount; i++) {
+    parallel->chunks[i].offset = total;
+    total += parallel->chunks[i].decoded;
+  }
+  if (!reserve(&parallel->output, &parallel->outputCapacity, total)) {
+    return NULL;
+  }
+  runTasks(parallel, packChunk, chunkCount);
+
+  // The last chunk's end state is the state after the whole input
+  *decoder = parallel->chunks[chunkCount - 1].decoder;
+  *decodedLength = total;
+  return parallel->output;
+}
+
+/* Grow a reusable buffer to at least size bytes */
+static bool reserve(char **buffer, size_t *capacity, size_t size) {
+  if (*buffer && size <= *capacity) {
+    return true;
+  }
+  char *grown = realloc(*buffer, size > 0 ? size : 1);
+  if (!grown) {
+    return false;
+  }
+  *buffer = grown;
+  *capacity = size;
+  return true;
+}
+
+/* Cut text into at most chunkCapacity chunks that end after a space where
+ * one is close by */
+static size_t splitInput(MorseParallel *parallel, const char *text,
+                         size_t length) {
+  size_t chunkCount = length / MIN_CHUNK_SIZE;
+  if (chunkCount > parallel->chunkCapacity) {
+    chunkCount = parallel->chunkCapacity;
+  }
+  if (chunkCount < 1) {
+    chunkCount = 1;
+  }
+
+  parallel->input = text;
+  size_t count = 0;
+  size_t start = 0;
+  for (size_t i = 1; i <= chunkCount && start < length; i++) {
+    size_t end = length;
+    if (i < chunkCount) {
+      end = length / chunkCount * i;
+      if (end < start) {
+        end = start;
+      }
+      size_t limit = end + WORD_ALIGN_WINDOW < length
+                         ? end + WORD_ALIGN_WINDOW
+                         : length;
+      size_t space = end;
+      while (space < limit && text[space] != ' ') {
+        space++;
+      }
+      if (space < limit) {
+        end = space + 1;
+      }
+    }
+    if (end > start) {
+      parallel->chunks[count].start = start;
+      parallel->chunks[count].length = end - start;
+      count++;
+      start = end;
+    }
+  }
+  return count;
+}
+
+/* Cut Morse code into chunks that each start at a resynchronization point:
+ * a byte other than space or CR/LF right after a space or slash. The
+ * pending symbol is always empty there, and the byte resets spaceCount, so
+ * a fresh decoder started at that point produces exactly what the
+ * sequential decoder would. */
+static size_t splitMorse(MorseParallel *parallel, const char *morse,
+                         size_t length) {
+  size_t chunkCount = length / MIN_CHUNK_SIZE;
+  if (chunkCount > parallel->chunkCapacity) {
+    chunkCount = parallel->chunkCapacity;
+  }
+  if (chunkCount < 1) {
+    chunkCount = 1;
+  }
+
+  parallel->input = morse;
+  size_t count = 0;
+  size_t start = 0;
+  for (size_t i = 1; i <= chunkCount && start < length; i++) {
+    size_t end = length;
+    if (i < chunkCount) {
+      end = length / chunkCount * i;
+      if (end <= start) {
+        end = start + 1;
+      }
+      while (end < length &&
+             ((morse[end - 1] != ' ' && morse[end - 1] != '/') ||
+              morse[end] == ' ' || morse[end] == '\n' ||
+              morse[end] == '\r')) {
+        end++;
+      }
+    }
+    parallel->chunks[count].start = start;
+    parallel->chunks[count].length = end - start;
+    count++;
+    start = end;
+  }
+  if (count == 0) {
+    // Empty input still runs one chunk, so the decoder state carries over
+    parallel->chunks[0].start = 0;
+    parallel->chunks[0].length = 0;
+    count = 1;
+  }
+  return count;
+}
+
+/* Pass 1: output size and boundary summary of one chunk */
+static void measureChunk(MorseParallel *parallel, size_t index) {
+  ParallelChunk *chunk = &parallel->chunks[index];
+  const char *text = parallel->input + chunk->start;
+
+  chunk->firstKind = CHUNK_EMPTY;
+  for (size_t i = 0; i < chunk->length; i++) {
+    if (text[i] != '\n' && text[i] != '\r') {
+      chunk->firstKind =
+          text[i] == ' ' ? CHUNK_STARTS_SPACE : CHUNK_STARTS_SYMBOL;
+      break;
+    }
+  }
+
+  MorseEncoder probe;
+  morseEncoderInit(&probe, chunk->encoder.useSlashWordspacer);
+  chunk->measured = morseEncoderMeasure(&probe, text, chunk->length);
+  chunk->hasSymbol = !probe.firstChar;
+  chunk->endsWithSpace = probe.lastWasSpace;
+}
+
+/* Pass 2: encode one chunk at its final offset */
+static void encodeChunk(MorseParallel *parallel, size_t index) {
+  ParallelChunk *chunk = &parallel->chunks[index];
+  MorseEncoder encoder = chunk->encoder;
+  morseEncoderFeed(&encoder, parallel->input + chunk->start, chunk->length,
+                   parallel->output + chunk->offset);
+}
+
+/* Decode one chunk into its scratch region */
+static void decodeChunk(MorseParallel *parallel, size_t index) {
+  ParallelChunk *chunk = &parallel->chunks[index];
+  chunk->decoded =
+      morseDecoderFeed(&chunk->decoder, parallel->input + chunk->start,
+                       chunk->length, parallel->scratch + chunk->start + index);
+}
+
+/* Copy one decoded chunk to its final offset */
+static void packChunk(MorseParallel *parallel, size_t index) {
+  ParallelChunk *chunk = &parallel->chunks[index];
+  memcpy(parallel->output + chunk->offset,
+         parallel->scratch + chunk->start + index, chunk->decoded);
+}
+
+/* Run task(0 .. taskCount - 1) on the pool and wait for all of them */
+static void runTasks(MorseParallel *parallel, ParallelTask task,
+                     size_t taskCount) {
+  pthread_mutex_lock(&parallel->lock);
+  parallel->task = task;
+  parallel->taskCount = taskCount;
+  parallel->nextTask = 0;
+  parallel->doneTasks = 0;
+  pthread_cond_broadcast(&parallel->taskReady);
+
+  runNextTasks(parallel);
+  while (parallel->doneTasks < parallel->taskCount) {
+    pthread_cond_wait(&parallel->taskDone, &parallel->lock);
+  }
+  parallel->taskCount = 0;
+  pthread_mutex_unlock(&parallel->lock);
+}
+
+/* Take tasks until none are left; called with the lock held */
+static void runNextTasks(MorseParallel *parallel) {
+  while (parallel->nextTask < parallel->taskCount) {
+    size_t index = parallel->nextTask++;
+    pthread_mutex_unlock(&parallel->lock);
+    parallel->task(parallel, index);
+    pthread_mutex_lock(&parallel->lock);
+    if (++parallel->doneTasks == parallel->taskCount) {
+      pthread_cond_broadcast(&parallel->taskDone);
+    }
+  }
+}
+
+static void *workerMain(void *arg) {
+  MorseParallel *parallel = arg;
+  pthread_mutex_lock(&parallel->lock);
+  while (!parallel->shutdown) {
+    runNextTasks(parallel);
+    if (!parallel->shutdown) {
+      pthread_cond_wait(&parallel->taskReady, &parallel->lock);
+    }
+  }
+  pthread_mutex_unlock(&parallel->lock);
+  return NULL;
+}
@@ -0,0 +1,445 @@
+/**
+ * @file morse_pipeline.c
+ * @brief Double-buffered asynchronous input and output on io_uring or
+ * threads
+ * @author Diego Rubio Carrera
+ */
+
+#include <errno.h>
+#include <morse_pipeline.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#ifdef MORSE_HAVE_IO_URING
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#endif
+
+/* Largest transfer asked for at once; read(2) and the ring take 32 bits */
+#define MAX_TRANSFER (1u << 30)
+
+/* One read or write; at most one of each kind is in flight */
+typedef struct {
+  MorsePipeline *owner;
+  int fd;
+  bool write;
+  char *data;       // next byte to transfer
+  size_t remaining; // bytes still to write, or the size of the read
+  bool pending;     // started and not completed yet
+  bool queued;      // thread fallback: not picked up by the thread yet
+  size_t done;      // bytes transferred
+  int error;        // errno of a failed transfer, else 0
+} PipelineTransfer;
+
+#ifdef MORSE_HAVE_IO_URING
+/* The rings shared with the kernel */
+typedef struct {
+  int fd;
+  void *rings;
+  size_t ringsSize;
+  struct io_uring_sqe *sqes;
+  size_t sqesSize;
+  unsigned *sqTail;
+  unsigned *sqMask;
+  unsigned *sqArray;
+  unsigned *cqHead;
+  unsigned *cqTail;
+  unsigned *cqMask;
+  struct io_uring_cqe *cqes;
+} PipelineRing;
+#endif
+
+struct MorsePipeline {
+  char *input[2];
+  char *output[2];
+  size_t inputSize;
+  unsigned int readSlot;  // input buffer the pending read fills
+  unsigned int writeSlot; // output buffer handed out for the next write
+  PipelineTransfer reading;
+  PipelineTransfer writing;
+  int writeError; // first failed write; later writes are not started
+  bool useRing;
+#ifdef MORSE_HAVE_IO_URING
+  PipelineRing ring;
+#endif
+
+  // Thread fallback: one thread per transfer kind
+  pthread_t threads[2];
+  unsigned int threadCount;
+  pthread_mutex_t lock;
+  pthread_cond_t changed;
+  bool shutdown;
+};
+
+static void startTransfer(MorsePipeline *pipeline,
+                          PipelineTransfer *transfer, char *data,
+                          size_t length);
+static void waitTransfer(MorsePipeline *pipeline, PipelineTransfer *transfer);
+static bool completeTransfer(PipelineTransfer *transfer, ssize_t result);
+static bool startThreads(MorsePipeline *pipeline);
+static void *transferMain(void *arg);
+#ifdef MORSE_HAVE_IO_URING
+static bool ringSetup(PipelineRing *ring);
+static void ringDestroy(PipelineRing *ring);
+static bool ringSubmit(PipelineRing *ring, PipelineTransfer *transfer);
+static void ringReap(PipelineRing *ring);
+#endif
+
+MorsePipeline *morsePipelineCreate(int inputFd, int outputFd,
+                                   size_t inputSize, size_t outputSize) {
+  MorsePipeline *pipeline = calloc(1, sizeof(MorsePipeline));
+  if (!pipeline) {
+    return NULL;
+  }
+  pipeline->inputSize = inputSize;
+  pipeline->reading = (PipelineTransfer){.owner = pipeline, .fd = inputFd};
+  pipeline->writing =
+      (PipelineTransfer){.owner = pipeline, .fd = outputFd, .write = true};
+  bool allocated = true;
+  for (int i = 0; i < 2; i++) {
+    pipeline->input[i] = malloc(inputSize);
+    pipeline->output[i] = malloc(outputSize);
+    allocated = allocated && pipeline->input[i] && pipeline->output[i];
+  }
+  if (!allocated) {
+    morsePipelineDestroy(pipeline);
+    errno = ENOMEM;
+    return NULL;
+  }
+
+#ifdef MORSE_HAVE_IO_URING
+  // Kernels without io_uring, or with it disabled, get the threads
+  pipeline->useRing = ringSetup(&pipeline->ring);
+#endif
+  if (!pipeline->useRing && !startThreads(pipeline)) {
+    int savedErrno = errno;
+    morsePipelineDestroy(pipeline);
+    errno = savedErrno;
+    return NULL;
+  }
+
+  startTransfer(pipeline, &pipeline->reading, pipeline->input[0], inputSize);
+  return pipeline;
+}
+
+void morsePipelineDestroy(MorsePipeline *pipeline) {
+  if (!pipeline) {
+    return;
+  }
+  // Buffers may only go once the kernel or the threads are done with them
+  waitTransfer(pipeline, &pipeline->reading);
+  waitTransfer(pipeline, &pipeline->writing);
+#ifdef MORSE_HAVE_IO_URING
+  if (pipeline->useRing) {
+    ringDestroy(&pipeline->ring);
+  }
+#endif
+  if (pipeline->threadCount > 0) {
+    pthread_mutex_lock(&pipeline->lock);
+    pipeline->shutdown = true;
+    pthread_cond_broadcast(&pipeline->changed);
+    pthread_mutex_unlock(&pipeline->lock);
+    for (unsigned int i = 0; i < pipeline->threadCount; i++) {
+      pthread_join(pipeline->threads[i], NULL);
+    }
+    pthread_mutex_destroy(&pipeline->lock);
+    pthread_cond_destroy(&pipeline->changed);
+  }
+  for (int i = 0; i < 2; i++) {
+    free(pipeline->input[i]);
+    free(pipeline->output[i]);
+  }
+  free(pipeline);
+}
+
+const char *morsePipelineRead(MorsePipeline *pipeline, size_t *length) {
+  PipelineTransfer *reading = &pipeline->reading;
+  waitTransfer(pipeline, reading);
+  if (reading->error != 0) {
+    errno = reading->error;
+    return NULL;
+  }
+
+  // After end of input nothing is started and every call returns 0
+  char *chunk = pipeline->input[pipeline->readSlot];
+  *length = reading->done;
+  if (reading->done > 0) {
+    pipeline->readSlot ^= 1;
+    startTransfer(pipeline, reading, pipeline->input[pipeline->readSlot],
+                  pipeline->inputSize);
+  }
+  return chunk;
+}
+
+char *morsePipelineOutput(MorsePipeline *pipeline) {
+  return pipeline->output[pipeline->writeSlot];
+}
+
+bool morsePipelineWrite(MorsePipeline *pipeline, size_t length) {
+  if (!morsePipelineFinish(pipeline)) {
+    return false;
+  }
+  if (length > 0) {
+    startTransfer(pipeline, &pipeline->writing,
+                  pipeline->output[pipeline->writeSlot], length);
+    pipeline->writeSlot ^= 1;
+  }
+  return true;
+}
+
+bool morsePipelineFinish(MorsePipeline *pipeline) {
+  PipelineTransfer *writing = &pipeline->writing;
+  waitTransfer(pipeline, writing);
+  if (writing->error != 0 && pipeline->writeError == 0) {
+    pipeline->writeError = writing->error;
+  }
+  if (pipeline->writeError != 0) {
+    errno = pipeline->writeError;
+    return false;
+  }
+  return true;
+}
+
+static void startTransfer(MorsePipeline *pipeline,
+                          PipelineTransfer *transfer, char *data,
+                          size_t length) {
+  transfer->data = data;
+  transfer->remaining = length;
+  transfer->done = 0;
+  transfer->error = 0;
+  transfer->pending = true;
+#ifdef MORSE_HAVE_IO_URING
+  if (pipeline->useRing) {
+    if (!ringSubmit(&pipeline->ring, transfer)) {
+      transfer->error = errno;
+      transfer->pending = false;
+    }
+    return;
+  }
+#endif
+  pthread_mutex_lock(&pipeline->lock);
+  transfer->queued = true;
+  pthread_cond_broadcast(&pipeline->changed);
+  pthread_mutex_unlock(&pipeline->lock);
+}
+
+static void waitTransfer(MorsePipeline *pipeline, PipelineTransfer *transfer) {
+#ifdef MORSE_HAVE_IO_URING
+  if (pipeline->useRing) {
+    while (transfer->pending) {
+      ringReap(&pipeline->ring);
+      if (transfer->pending &&
+          syscall(__NR_io_uring_enter, pipeline->ring.fd, 0, 1,
+                  IORING_ENTER_GETEVENTS, NULL, 0) < 0 &&
+          errno != EINTR) {
+        // The ring is unusable; the transfer will never complete
+        transfer->error = errno;
+        transfer->pending = false;
+      }
+    }
+    return;
+  }
+#endif
+  if (pipeline->threadCount == 0) {
+    return; // the pipeline failed before anything was started
+  }
+  pthread_mutex_lock(&pipeline->lock);
+  while (transfer->pending) {
+    pthread_cond_wait(&pipeline->changed, &pipeline->lock);
+  }
+  pthread_mutex_unlock(&pipeline->lock);
+}
+
+/* Account for one read(2), write(2) or completion result.
+ * @return true if the transfer has to be continued */
+static bool completeTransfer(PipelineTransfer *transfer, ssize_t result) {
+  if (result < 0) {
+    if (errno == EINTR) {
+      return true;
+    }
+    transfer->error = errno;
+    return false;
+  }
+  transfer->done += (size_t)result;
+  if (!transfer->write) {
+    return false; // a short read is a complete chunk
+  }
+  if (result == 0) {
+    transfer->error = EIO; // no progress: do not spin
+    return false;
+  }
+  transfer->data += result;
+  transfer->remaining -= (size_t)result;
+  return transfer->remaining > 0;
+}
+
+static bool startThreads(MorsePipeline *pipeline) {
+  pthread_mutex_init(&pipeline->lock, NULL);
+  pthread_cond_init(&pipeline->changed, NULL);
+  PipelineTransfer *transfers[2] = {&pipeline->reading, &pipeline->writing};
+  for (int i = 0; i < 2; i++) {
+    int status = pthread_create(&pipeline->threads[i], NULL, transferMain,
+                                transfers[i]);
+    if (status != 0) {
+      errno = status;
+      break;
+    }
+    pipeline->threadCount++;
+  }
+  if (pipeline->threadCount < 2) {
+    if (pipeline->threadCount == 0) {
+      pthread_mutex_destroy(&pipeline->lock);
+      pthread_cond_destroy(&pipeline->changed);
+    }
+    return false;
+  }
+  return true;
+}
+
+/* Thread fallback: perform every transfer queued on this thread's kind */
+static void *transferMain(void *arg) {
+  PipelineTransfer *transfer = arg;
+  MorsePipeline *pipeline = transfer->owner;
+  pthread_mutex_lock(&pipeline->lock);
+  for (;;) {
+    while (!transfer->queued && !pipeline->shutdown) {
+      pthread_cond_wait(&pipeline->changed, &pipeline->lock);
+    }
+    if (!transfer->queued) {
+      break;
+    }
+    transfer->queued = false;
+    pthread_mutex_unlock(&pipeline->lock);
+
+    bool more = true;
+    while (more) {
+      size_t step = transfer->remaining < MAX_TRANSFER ? transfer->remaining
+                                                       : MAX_TRANSFER;
+      ssize_t result = transfer->write ? write(transfer->fd, transfer->data,
+                                               step)
+                                       : read(transfer->fd, transfer->data,
+                                              step);
+      more = completeTransfer(transfer, result);
+    }
+
+    pthread_mutex_lock(&pipeline->lock);
+    transfer->pending = false;
+    pthread_cond_broadcast(&pipeline->changed);
+  }
+  pthread_mutex_unlock(&pipeline->lock);
+  return NULL;
+}
+
+#ifdef MORSE_HAVE_IO_URING
+/* Map a small ring. Transfers at the current file position - the only
+ * kind that works on pipes - need IORING_FEAT_RW_CUR_POS (Linux 5.6). */
+static bool ringSetup(PipelineRing *ring) {
+  struct io_uring_params params;
+  memset(&params, 0, sizeof(params));
+  int fd = (int)syscall(__NR_io_uring_setup, 4, &params);
+  if (fd < 0) {
+    return false;
+  }
+  if (!(params.features & IORING_FEAT_SINGLE_MMAP) ||
+      !(params.features & IORING_FEAT_RW_CUR_POS)) {
+    close(fd);
+    return false;
+  }
+
+  size_t sqSize = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+  size_t cqSize =
+      params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+  ring->fd = fd;
+  ring->ringsSize = sqSize > cqSize ? sqSize : cqSize;
+  ring->rings = mmap(NULL, ring->ringsSize, PROT_READ | PROT_WRITE,
+                     MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQ_RING);
+  ring->sqesSize = params.sq_entries * sizeof(struct io_uring_sqe);
+  ring->sqes = mmap(NULL, ring->sqesSize, PROT_READ | PROT_WRITE,
+                    MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQES);
+  if (ring->rings == MAP_FAILED || ring->sqes == MAP_FAILED) {
+    if (ring->rings != MAP_FAILED) {
+      munmap(ring->rings, ring->ringsSize);
+    }
+    if (ring->sqes != MAP_FAILED) {
+      munmap(ring->sqes, ring->sqesSize);
+    }
+    close(fd);
+    return false;
+  }
+
+  char *rings = ring->rings;
+  ring->sqTail = (unsigned *)(rings + params.sq_off.tail);
+  ring->sqMask = (unsigned *)(rings + params.sq_off.ring_mask);
+  ring->sqArray = (unsigned *)(rings + params.sq_off.array);
+  ring->cqHead = (unsigned *)(rings + params.cq_off.head);
+  ring->cqTail = (unsigned *)(rings + params.cq_off.tail);
+  ring->cqMask = (unsigned *)(rings + params.cq_off.ring_mask);
+  ring->cqes = (struct io_uring_cqe *)(rings + params.cq_off.cqes);
+  return true;
+}
+
+static void ringDestroy(PipelineRing *ring) {
+  munmap(ring->sqes, ring->sqesSize);
+  munmap(ring->rings, ring->ringsSize);
+  close(ring->fd);
+}
+
+/* Queue the rest of transfer at the current file position */
+static bool ringSubmit(PipelineRing *ring, PipelineTransfer *transfer) {
+  unsigned tail = *ring->sqTail;
+  unsigned index = tail & *ring->sqMask;
+  struct io_uring_sqe *sqe = &ring->sqes[index];
+  memset(sqe, 0, sizeof(*sqe));
+  sqe->opcode = transfer->write ? IORING_OP_WRITE : IORING_OP_READ;
+  sqe->fd = transfer->fd;
+  sqe->off = (uint64_t)-1;
+  sqe->addr = (uint64_t)(uintptr_t)transfer->data;
+  sqe->len = (uint32_t)(transfer->remaining < MAX_TRANSFER
+                            ? transfer->remaining
+                            : MAX_TRANSFER);
+  sqe->user_data = (uint64_t)(uintptr_t)transfer;
+  ring->sqArray[index] = index;
+  __atomic_store_n(ring->sqTail, tail + 1, __ATOMIC_RELEASE);
+
+  for (;;) {
+    long submitted = syscall(__NR_io_uring_enter, ring->fd, 1, 0, 0, NULL, 0);
+    if (submitted >= 0) {
+      return true;
+    }
+    if (errno != EINTR) {
+      return false;
+    }
+  }
+}
+
+/* Handle every completion the kernel has posted */
+static void ringReap(PipelineRing *ring) {
+  unsigned head = *ring->cqHead;
+  unsigned tail = __atomic_load_n(ring->cqTail, __ATOMIC_ACQUIRE);
+  for (; head != tail; head++) {
+    struct io_uring_cqe *cqe = &ring->cqes[head & *ring->cqMask];
+    PipelineTransfer *transfer =
+        (PipelineTransfer *)(uintptr_t)cqe->user_data;
+    ssize_t result = cqe->res;
+    if (result < 0) {
+      errno = -cqe->res;
+      result = -1;
+    }
+    // The entry is copied out; the kernel may reuse it
+    __atomic_store_n(ring->cqHead, head + 1, __ATOMIC_RELEASE);
+
+    if (completeTransfer(transfer, result)) {
+      if (!ringSubmit(ring, transfer)) {
+        transfer->error = errno;
+        transfer->pending = false;
+      }
+    } else {
+      transfer->pending = false;
+    }
+  }
+}
+#endif
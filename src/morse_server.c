@@ -0,0 +1,502 @@
+/**
+ * @file morse_server.c
+ * @brief Conversion server on a Unix domain socket, for --serve
+ * @author Diego Rubio Carrera
+ */
+
+#define _GNU_SOURCE // accept4
+
+#include <errno.h>
+#include <morse/morse.h>
+#include <morse_cache.h>
+#include <morse_server.h>
+
+#ifndef MORSE_HAVE_EPOLL
+bool morseServe(const char *path, unsigned int threadCount,
+                size_t cacheSize, MorseStats *stats) {
+  (void)path;
+  (void)threadCount;
+  (void)cacheSize;
+  (void)stats;
+  errno = ENOSYS;
+  return false;
+}
+#else
+
+#include <pthread.h>
+#include <signal.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/epoll.h>
+#include <sys/signalfd.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <time.h>
+#include <unistd.h>
+
+/* Events taken off the epoll instance per wait */
+#define EVENT_BATCH 64
+
+/* Connections waiting in the kernel to be accepted */
+#define LISTEN_BACKLOG 128
+
+/* Bytes a connection's input buffer starts with: a header plus small
+ * requests, so short requests are read with one recv(2) */
+#define INITIAL_BUFFER_SIZE (16 * 1024)
+
+/* One client. Only the thread that took its event touches it until the
+ * descriptor is armed again, which EPOLLONESHOT guarantees. */
+typedef struct ServerConnection {
+  int fd;
+  char *input; // received bytes: requests, possibly several or a partial one
+  size_t inputCapacity;
+  size_t inputUsed;
+  char *output; // response being sent, reused for every request
+  size_t outputCapacity;
+  size_t outputLength;
+  size_t outputSent;
+  bool closing; // close once the response is out: the request was refused
+  struct ServerConnection *previous; // list of open connections
+  struct ServerConnection *next;
+} ServerConnection;
+
+/* State shared by the server threads */
+typedef struct {
+  int epollFd;
+  int listenFd;
+  int signalFd;
+  pthread_mutex_t lock; // guards connections and stats
+  ServerConnection *connections;
+  MorseStats *stats;
+  MorseMemoryCache *cache; // results of earlier requests, or NULL
+} Server;
+
+static void *serverMain(void *argument);
+static void acceptConnections(Server *server);
+static void serveConnection(Server *server, ServerConnection *connection,
+                            MorseStats *stats);
+static bool answerRequests(ServerConnection *connection,
+                           MorseMemoryCache *cache, MorseStats *stats);
+static bool convertRequest(ServerConnection *connection,
+                           MorseMemoryCache *cache,
+                           const unsigned char *header, const char *payload,
+                           size_t length);
+static bool sendOutput(ServerConnection *connection);
+static bool growBuffer(char **buffer, size_t *capacity, size_t size);
+static void closeConnection(Server *server, ServerConnection *connection);
+static bool armDescriptor(Server *server, int fd, void *data,
+                          uint32_t events, int operation);
+static double monotonicSeconds(void);
+
+bool morseServe(const char *path, unsigned int threadCount,
+                size_t cacheSize, MorseStats *stats) {
+  struct sockaddr_un address = {.sun_family = AF_UNIX};
+  if (strlen(path) >= sizeof(address.sun_path)) {
+    errno = ENAMETOOLONG;
+    return false;
+  }
+  strcpy(address.sun_path, path);
+
+  // The signals are taken from the epoll instance; every thread inherits
+  // the mask, so none of them is interrupted instead
+  sigset_t signals;
+  sigemptyset(&signals);
+  sigaddset(&signals, SIGINT);
+  sigaddset(&signals, SIGTERM);
+  sigset_t previousMask;
+  pthread_sigmask(SIG_BLOCK, &signals, &previousMask);
+
+  Server server = {-1, -1, -1, PTHREAD_MUTEX_INITIALIZER, NULL, stats, NULL};
+  if (cacheSize > 0 && !(server.cache = morseMemoryCacheCreate(cacheSize))) {
+    pthread_sigmask(SIG_SETMASK, &previousMask, NULL);
+    errno = ENOMEM;
+    return false;
+  }
+  struct stat pathStat;
+  if (lstat(path, &pathStat) == 0 && S_ISSOCK(pathStat.st_mode)) {
+    unlink(path); // left behind by a server that did not shut down
+  }
+  server.listenFd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK, 0);
+  bool listening =
+      server.listenFd >= 0 &&
+      bind(server.listenFd, (struct sockaddr *)&address, sizeof(address)) ==
+          0;
+  bool bound = listening;
+  listening = listening && listen(server.listenFd, LISTEN_BACKLOG) == 0;
+  server.signalFd = listening ? signalfd(-1, &signals, SFD_NONBLOCK) : -1;
+  server.epollFd = server.signalFd >= 0 ? epoll_create1(0) : -1;
+  // The signal stays pending and level-triggered, so every thread sees it
+  bool started =
+      server.epollFd >= 0 &&
+      armDescriptor(&server, server.listenFd, &server.listenFd,
+                    EPOLLIN | EPOLLONESHOT, EPOLL_CTL_ADD) &&
+      armDescriptor(&server, server.signalFd, &server.signalFd, EPOLLIN,
+                    EPOLL_CTL_ADD);
+
+  pthread_t *threads = NULL;
+  unsigned int threadsStarted = 0;
+  if (started && threadCount > 1) {
+    threads = malloc((threadCount - 1) * sizeof(pthread_t));
+    for (; threads && threadsStarted < threadCount - 1; threadsStarted++) {
+      if (pthread_create(&threads[threadsStarted], NULL, serverMain,
+                         &server) != 0) {
+        break; // serve with the threads we have
+      }
+    }
+  }
+  int savedErrno = errno;
+  if (started) {
+    serverMain(&server);
+  }
+  for (unsigned int i = 0; i < threadsStarted; i++) {
+    pthread_join(threads[i], NULL);
+  }
+  free(threads);
+
+  while (server.connections) {
+    closeConnection(&server, server.connections);
+  }
+  if (server.epollFd >= 0) {
+    close(server.epollFd);
+  }
+  if (server.signalFd >= 0) {
+    close(server.signalFd);
+  }
+  if (server.listenFd >= 0) {
+    close(server.listenFd);
+  }
+  if (bound) {
+    unlink(path);
+  }
+  pthread_mutex_destroy(&server.lock);
+  if (server.cache) {
+    if (stats) {
+      morseMemoryCacheReport(server.cache, stats);
+    }
+    morseMemoryCacheDestroy(server.cache);
+  }
+  // The signal that stopped us is consumed, not delivered on unblocking
+  if (started) {
+    struct timespec noWait = {0, 0};
+    while (sigtimedwait(&signals, NULL, &noWait) > 0) {
+    }
+  }
+  pthread_sigmask(SIG_SETMASK, &previousMask, NULL);
+  errno = savedErrno;
+  return started;
+}
+
+/* Wait for ready descriptors and handle them until a signal arrives */
+static void *serverMain(void *argument) {
+  Server *server = argument;
+  // Counted per thread and merged once, so requests take no lock to count
+  MorseStats threadStats;
+  morseStatsInit(&threadStats);
+  struct epoll_event events[EVENT_BATCH];
+  bool stopping = false;
+
+  while (!stopping) {
+    int count = epoll_wait(server->epollFd, events, EVENT_BATCH, -1);
+    if (count < 0 && errno == EINTR) {
+      continue;
+    }
+    if (count < 0) {
+      break;
+    }
+    for (int i = 0; i < count; i++) {
+      void *data = events[i].data.ptr;
+      if (data == &server->signalFd) {
+        stopping = true;
+      } else if (data == &server->listenFd) {
+        acceptConnections(server);
+      } else {
+        serveConnection(server, data, &threadStats);
+      }
+    }
+  }
+
+  if (server->stats) {
+    pthread_mutex_lock(&server->lock);
+    morseStatsMerge(server->stats, &threadStats);
+    pthread_mutex_unlock(&server->lock);
+  }
+  return NULL;
+}
+
+/* Take every pending connection, then listen for the next ones */
+static void acceptConnections(Server *server) {
+  for (;;) {
+    int fd = accept4(server->listenFd, NULL, NULL,
+                     SOCK_NONBLOCK | SOCK_CLOEXEC);
+    if (fd < 0 && errno == EINTR) {
+      continue;
+    }
+    if (fd < 0) {
+      break; // EAGAIN: none left; anything else: the client is gone
+    }
+    ServerConnection *connection = calloc(1, sizeof(ServerConnection));
+    if (!connection) {
+      close(fd);
+      continue;
+    }
+    connection->fd = fd;
+    pthread_mutex_lock(&server->lock);
+    connection->next = server->connections;
+    if (server->connections) {
+      server->connections->previous = connection;
+    }
+    server->connections = connection;
+    pthread_mutex_unlock(&server->lock);
+    if (!armDescriptor(server, fd, connection, EPOLLIN | EPOLLONESHOT,
+                       EPOLL_CTL_ADD)) {
+      closeConnection(server, connection);
+    }
+  }
+  armDescriptor(server, server->listenFd, &server->listenFd,
+                EPOLLIN | EPOLLONESHOT, EPOLL_CTL_MOD);
+}
+
+/* Finish sending, read what has arrived and answer every complete request,
+ * then wait for the socket to become ready again */
+static void serveConnection(Server *server, ServerConnection *connection,
+                            MorseStats *stats) {
+  // Requests that arrived behind a response still being sent come first
+  bool open = sendOutput(connection) &&
+              answerRequests(connection, server->cache, stats);
+  while (open && connection->outputSent == connection->outputLength) {
+    if (connection->closing) {
+      open = false;
+      break;
+    }
+    if (connection->inputCapacity - connection->inputUsed == 0 &&
+        !growBuffer(&connection->input, &connection->inputCapacity,
+                    connection->inputUsed + 1)) {
+      open = false;
+      break;
+    }
+    ssize_t received =
+        recv(connection->fd, connection->input + connection->inputUsed,
+             connection->inputCapacity - connection->inputUsed, 0);
+    if (received < 0 && errno == EINTR) {
+      continue;
+    }
+    if (received < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+      break;
+    }
+    if (received <= 0) {
+      open = false; // the client hung up, or the socket failed
+      break;
+    }
+    connection->inputUsed += (size_t)received;
+    open = answerRequests(connection, server->cache, stats);
+  }
+
+  if (!open) {
+    closeConnection(server, connection);
+    return;
+  }
+  uint32_t events =
+      connection->outputSent < connection->outputLength ? EPOLLOUT : EPOLLIN;
+  if (!armDescriptor(server, connection->fd, connection,
+                     events | EPOLLONESHOT, EPOLL_CTL_MOD)) {
+    closeConnection(server, connection);
+  }
+}
+
+/* Answer the complete requests at the start of the input, stopping early
+ * while a response cannot be sent in full */
+static bool answerRequests(ServerConnection *connection,
+                           MorseMemoryCache *cache, MorseStats *stats) {
+  size_t consumed = 0;
+  bool open = true;
+  while (open && connection->outputSent == connection->outputLength &&
+         !connection->closing &&
+         connection->inputUsed - consumed >= MORSE_SERVER_HEADER_SIZE) {
+    const unsigned char *header =
+        (const unsigned char *)connection->input + consumed;
+    size_t length = (size_t)header[0] << 24 | (size_t)header[1] << 16 |
+                    (size_t)header[2] << 8 | header[3];
+    if (length <= MORSE_SERVER_MAX_REQUEST &&
+        connection->inputUsed - consumed < MORSE_SERVER_HEADER_SIZE + length) {
+      // Incomplete: make room for the rest of it
+      open = growBuffer(&connection->input, &connection->inputCapacity,
+                        MORSE_SERVER_HEADER_SIZE + length);
+      break;
+    }
+
+    double start = monotonicSeconds();
+    open = convertRequest(connection, cache, header,
+                          connection->input + consumed +
+                              MORSE_SERVER_HEADER_SIZE,
+                          length) &&
+           sendOutput(connection);
+    if (!connection->closing) {
+      consumed += MORSE_SERVER_HEADER_SIZE + length;
+      stats->bytesIn += (long long)length;
+      stats->bytesOut +=
+          (long long)(connection->outputLength - MORSE_SERVER_HEADER_SIZE);
+      morseStatsCountRequest(stats, monotonicSeconds() - start);
+    }
+  }
+
+  if (consumed > 0) {
+    memmove(connection->input, connection->input + consumed,
+            connection->inputUsed - consumed);
+    connection->inputUsed -= consumed;
+  }
+  return open;
+}
+
+/* Put the response to one request into the output buffer, from the cache
+ * if it has been answered before */
+static bool convertRequest(ServerConnection *connection,
+                           MorseMemoryCache *cache,
+                           const unsigned char *header, const char *payload,
+                           size_t length) {
+  unsigned char operation = header[4];
+  unsigned int flags = header[5];
+  MorseResponseStatus status = MORSE_RESPONSE_OK;
+  if (length > MORSE_SERVER_MAX_REQUEST) {
+    status = MORSE_RESPONSE_TOO_LARGE;
+  } else if (header[6] != 0 || header[7] != 0 ||
+             (operation == MORSE_REQUEST_ENCODE &&
+              (flags & ~(MORSE_SLASH_WORDSPACER | MORSE_PACKED)) != 0) ||
+             (operation == MORSE_REQUEST_DECODE && flags != 0) ||
+             (operation != MORSE_REQUEST_ENCODE &&
+              operation != MORSE_REQUEST_DECODE)) {
+    status = MORSE_RESPONSE_BAD_REQUEST;
+  }
+
+  size_t resultLength = 0;
+  if (status == MORSE_RESPONSE_OK) {
+    uint64_t key = 0;
+    bool cached = false; // still to be looked up
+    if (cache) {
+      unsigned int mode =
+          operation == MORSE_REQUEST_DECODE
+              ? MORSE_CACHE_DECODE
+              : ((flags & MORSE_SLASH_WORDSPACER) ? MORSE_CACHE_SLASH : 0) |
+                    ((flags & MORSE_PACKED) ? MORSE_CACHE_PACKED : 0);
+      key = morseCacheKey(payload, length, mode, 0);
+      cached = true;
+    }
+    // The buffer keeps its size, so after the first requests one pass
+    // converts; a larger result is measured and converted again
+    for (;;) {
+      char *out = connection->output + MORSE_SERVER_HEADER_SIZE;
+      size_t capacity = connection->outputCapacity > MORSE_SERVER_HEADER_SIZE
+                            ? connection->outputCapacity -
+                                  MORSE_SERVER_HEADER_SIZE
+                            : 0;
+      cached = cached && morseMemoryCacheGet(cache, key, out, capacity,
+                                             &resultLength);
+      if (!cached) {
+        resultLength =
+            operation == MORSE_REQUEST_ENCODE
+                ? morseEncode(payload, length, out, capacity, flags)
+                : morseDecode(payload, length, out, capacity, 0);
+      }
+      if (resultLength <= capacity) {
+        break;
+      }
+      if (!growBuffer(&connection->output, &connection->outputCapacity,
+                      MORSE_SERVER_HEADER_SIZE + resultLength)) {
+        return false;
+      }
+    }
+    if (cache && !cached) {
+      morseMemoryCachePut(cache, key,
+                          connection->output + MORSE_SERVER_HEADER_SIZE,
+                          resultLength);
+    }
+  } else {
+    connection->closing = true;
+    if (!growBuffer(&connection->output, &connection->outputCapacity,
+                    MORSE_SERVER_HEADER_SIZE)) {
+      return false;
+    }
+  }
+
+  unsigned char *response = (unsigned char *)connection->output;
+  response[0] = (unsigned char)(resultLength >> 24);
+  response[1] = (unsigned char)(resultLength >> 16);
+  response[2] = (unsigned char)(resultLength >> 8);
+  response[3] = (unsigned char)resultLength;
+  response[4] = (unsigned char)status;
+  response[5] = response[6] = response[7] = 0;
+  connection->outputLength = MORSE_SERVER_HEADER_SIZE + resultLength;
+  connection->outputSent = 0;
+  return true;
+}
+
+/* Send as much of the response as the socket takes; false if it failed */
+static bool sendOutput(ServerConnection *connection) {
+  while (connection->outputSent < connection->outputLength) {
+    ssize_t sent = send(connection->fd,
+                        connection->output + connection->outputSent,
+                        connection->outputLength - connection->outputSent,
+                        MSG_NOSIGNAL);
+    if (sent < 0 && errno == EINTR) {
+      continue;
+    }
+    if (sent < 0) {
+      return errno == EAGAIN || errno == EWOULDBLOCK;
+    }
+    connection->outputSent += (size_t)sent;
+  }
+  return true;
+}
+
+/* Make a buffer hold at least size bytes, doubling its capacity */
+static bool growBuffer(char **buffer, size_t *capacity, size_t size) {
+  if (*capacity >= size) {
+    return true;
+  }
+  size_t grown = *capacity ? *capacity : INITIAL_BUFFER_SIZE;
+  while (grown < size) {
+    grown *= 2;
+  }
+  char *resized = realloc(*buffer, grown);
+  if (!resized) {
+    return false;
+  }
+  *buffer = resized;
+  *capacity = grown;
+  return true;
+}
+
+/* Close the client's socket and release its buffers */
+static void closeConnection(Server *server, ServerConnection *connection) {
+  pthread_mutex_lock(&server->lock);
+  if (connection->previous) {
+    connection->previous->next = connection->next;
+  } else {
+    server->connections = connection->next;
+  }
+  if (connection->next) {
+    connection->next->previous = connection->previous;
+  }
+  pthread_mutex_unlock(&server->lock);
+
+  close(connection->fd); // also removes it from the epoll instance
+  free(connection->input);
+  free(connection->output);
+  free(connection);
+}
+
+/* Add fd to the epoll instance, or re-arm it after a one-shot event */
+static bool armDescriptor(Server *server, int fd, void *data,
+                          uint32_t events, int operation) {
+  struct epoll_event event = {.events = events, .data.ptr = data};
+  return epoll_ctl(server->epollFd, operation, fd, &event) == 0;
+}
+
+static double monotonicSeconds(void) {
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return (double)now.tv_sec + (double)now.tv_nsec / 1e9;
+}
+
+#endif // MORSE_HAVE_EPOLL
@@ -0,0 +1,686 @@
+/**
+ * @file morse_simd.c
+ * @brief SIMD kernels behind the Morse encoder and decoder
+ * @author Diego Rubio Carrera
+ *
+ * Every 64-byte block is classified into one bitmask per byte class, bit i
+ * describing byte i. The decoder then walks runs of one class with
+ * count-trailing-zeros instead of branching on every byte: a run of dots
+ * and dashes is appended to the pending symbol straight from the dash mask,
+ * a run of spaces is settled with one division, and CR/LF bytes are never
+ * visited at all.
+ *
+ * The encoder fast path case-folds and validates 32 bytes at once. Runs of
+ * letters, digits and spaces are then emitted from precomputed 8-byte
+ * tokens that already carry the separator the previous byte calls for.
+ * With AVX-512 VBMI2 the tokens of 8 bytes are gathered into one vector
+ * and compressed into place; the SSE2 and AVX2 kernels classify with SIMD
+ * but emit with one unaligned scalar copy per input byte. Everything else
+ * - punctuation, unsupported bytes and CR/LF - is left to the scalar
+ * encoder, as is all of encoding on AArch64, which has no NEON encoder.
+ *
+ * Measuring the encoded size needs no per-byte state at all: code lengths
+ * are summed from a table, and separators and word gaps are counted with
+ * popcount over the space, CR/LF and symbol masks of a block.
+ */
+
+#include <morse_simd.h>
+#include <morse_tables.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <string.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#define MORSE_SIMD_X86
+#include <immintrin.h>
+#elif defined(__aarch64__) && defined(__ARM_NEON)
+#define MORSE_SIMD_NEON
+#include <arm_neon.h>
+#endif
+
+/* Byte classes of one block */
+typedef struct {
+  uint64_t dot;
+  uint64_t dash;
+  uint64_t space;
+  uint64_t slash;
+  uint64_t ignored; // CR and LF - ReqFunc28
+} BlockMasks;
+
+/* Number of consecutive set bits in mask from bit start on */
+static inline unsigned int runLength(uint64_t mask, unsigned int start) {
+  uint64_t rest = ~(mask >> start);
+  return rest ? (unsigned int)__builtin_ctzll(rest) : 64 - start;
+}
+
+/* Mask with the lowest count bits set */
+static inline uint64_t lowBits(unsigned int count) {
+  return count >= 64 ? ~(uint64_t)0 : ((uint64_t)1 << count) - 1;
+}
+
+/* Emit the pending symbol if it is a known code; a strict decoder hears
+ * about any other, which costs nothing while every symbol is known */
+static inline size_t flushSymbol(const MorseDecoder *decoder,
+                                 unsigned int code, size_t codeLength,
+                                 size_t symbolStart, char *out) {
+  // Unknown codes write nothing, so out may be sized exactly
+  char c = codeLength > MORSE_MAX_CODE_LENGTH
+               ? '\0'
+               : MORSE_DECODE_TABLE[MORSE_DECODE_INDEX(code, codeLength)];
+  if (c == '\0') {
+    if (decoder->malformed) {
+      decoder->malformed(decoder->malformedContext, symbolStart);
+    }
+    return 0;
+  }
+  *out = c;
+  return 1;
+}
+
+/* Run the decoder state machine over one classified block. Bytes that are
+ * neither space, slash nor CR/LF belong to a symbol; anything but a dot or
+ * dash makes that symbol undecodable, as in the scalar decoder. */
+static inline size_t decodeBlock(MorseDecoder *decoder,
+                                 const BlockMasks *masks, char *out) {
+  uint64_t symbols = ~(masks->space | masks->slash | masks->ignored);
+  uint64_t invalid = symbols & ~(masks->dot | masks->dash);
+  uint64_t pending = ~masks->ignored;
+  unsigned int code = decoder->code;
+  size_t codeLength = decoder->codeLength;
+  int spaceCount = decoder->spaceCount;
+  size_t symbolStart = decoder->symbolStart;
+  size_t resultIndex = 0;
+
+  while (pending) {
+    unsigned int start = (unsigned int)__builtin_ctzll(pending);
+    uint64_t bit = (uint64_t)1 << start;
+
+    if (symbols & bit) {
+      // Dots and dashes up to the next space, slash or CR/LF
+      uint64_t run = lowBits(runLength(symbols, start)) << start;
+      size_t elements = (size_t)__builtin_popcountll(run);
+      symbolStart = codeLength > 0 ? symbolStart : decoder->offset + start;
+      if ((invalid & run) || codeLength + elements > MORSE_MAX_CODE_LENGTH) {
+        codeLength = MORSE_MAX_CODE_LENGTH + 1;
+      } else {
+        code |= (unsigned int)((masks->dash & run) >> start) << codeLength;
+        codeLength += elements;
+      }
+      spaceCount = 0;
+      pending &= ~run;
+    } else if (masks->space & bit) {
+      // The first space ends the symbol, every third one emits a word gap
+      unsigned int spaces = runLength(masks->space, start);
+      if (codeLength > 0) {
+        resultIndex += flushSymbol(decoder, code, codeLength, symbolStart,
+                                   out + resultIndex);
+        code = 0;
+        codeLength = 0;
+      }
+      spaceCount += (int)spaces;
+      memset(out + resultIndex, ' ', (size_t)(spaceCount / 3));
+      resultIndex += (size_t)(spaceCount / 3);
+      spaceCount %= 3;
+      pending &= ~(lowBits(spaces) << start);
+    } else {
+      // Slash word separator
+      if (codeLength > 0) {
+        resultIndex += flushSymbol(decoder, code, codeLength, symbolStart,
+                                   out + resultIndex);
+        code = 0;
+        codeLength = 0;
+      }
+      out[resultIndex++] = ' ';
+      spaceCount = 0;
+      pending &= ~bit;
+    }
+  }
+
+  decoder->code = code;
+  decoder->codeLength = codeLength;
+  decoder->spaceCount = spaceCount;
+  decoder->symbolStart = symbolStart;
+  decoder->offset += MORSE_SIMD_BLOCK;
+  return resultIndex;
+}
+
+/* Kernels the running CPU supports, and the fastest of them, detected once:
+ * every feed call asks, so the CPU is not queried per chunk */
+static pthread_once_t kernelsOnce = PTHREAD_ONCE_INIT;
+static bool kernelSupported[MORSE_KERNEL_AVX512 + 1];
+static MorseKernel bestKernel = MORSE_KERNEL_SCALAR;
+static bool compressSupported; // AVX-512 VBMI2, for encodeAvx512()
+
+static void detectKernels(void) {
+#if defined(MORSE_SIMD_X86)
+  kernelSupported[MORSE_KERNEL_SSE2] = __builtin_cpu_supports("sse2");
+  kernelSupported[MORSE_KERNEL_AVX2] = __builtin_cpu_supports("avx2");
+  kernelSupported[MORSE_KERNEL_AVX512] = __builtin_cpu_supports("avx512bw");
+  compressSupported = kernelSupported[MORSE_KERNEL_AVX512] &&
+                      __builtin_cpu_supports("avx512vbmi2");
+#elif defined(MORSE_SIMD_NEON)
+  kernelSupported[MORSE_KERNEL_NEON] = true;
+#endif
+  static const MorseKernel fastestFirst[] = {
+      MORSE_KERNEL_AVX512, MORSE_KERNEL_AVX2, MORSE_KERNEL_NEON,
+      MORSE_KERNEL_SSE2};
+  for (size_t i = 0; i < sizeof(fastestFirst) / sizeof(fastestFirst[0]);
+       i++) {
+    if (kernelSupported[fastestFirst[i]]) {
+      bestKernel = fastestFirst[i];
+      break;
+    }
+  }
+}
+
+MorseKernel morseBestKernel(void) {
+  pthread_once(&kernelsOnce, detectKernels);
+  return bestKernel;
+}
+
+bool morseSimdSupported(MorseKernel kernel) {
+  pthread_once(&kernelsOnce, detectKernels);
+  return (unsigned int)kernel <= MORSE_KERNEL_AVX512 &&
+         kernelSupported[kernel];
+}
+
+/* Emit the count leading token indices of one block. Tokens are copied 8
+ * bytes at a time, so they are staged and only the exact output reaches
+ * out: the parallel encoder writes the neighbouring chunk right behind. */
+static inline size_t encodeBlock(MorseEncoder *encoder,
+                                 const unsigned char *indices, size_t count,
+                                 char *out) {
+  const char(*bytes)[MORSE_TOKEN_SIZE] =
+      MORSE_TOKEN_BYTES[encoder->useSlashWordspacer];
+  const unsigned char *lengths =
+      MORSE_TOKEN_LENGTHS[encoder->useSlashWordspacer];
+  char staged[MORSE_SIMD_ENCODE_BLOCK * MORSE_TOKEN_MAX_LENGTH +
+              MORSE_TOKEN_SIZE];
+  char *cursor = staged;
+
+  for (size_t i = 0; i < count; i++) {
+    memcpy(cursor, bytes[indices[i]], MORSE_TOKEN_SIZE);
+    cursor += lengths[indices[i]];
+  }
+  memcpy(out, staged, (size_t)(cursor - staged));
+  encoder->lastWasSpace =
+      (indices[count - 1] & ~MORSE_TOKEN_AFTER_SPACE) == ' ';
+  return (size_t)(cursor - staged);
+}
+
+/* Count one classified block like morseEncoderMeasureScalar(). A byte
+ * follows a symbol when the closest byte before it that is not CR/LF is a
+ * symbol; a run of CR/LF inherits that from the byte before the run, which
+ * one carry-propagating addition spreads over the whole run. */
+static inline size_t measureBlock(MorseEncoder *encoder, uint64_t space,
+                                  uint64_t lineBreak,
+                                  const unsigned char *bytes) {
+  uint64_t symbol = ~(space | lineBreak);
+  uint64_t carry = !encoder->firstChar && !encoder->lastWasSpace;
+  uint64_t runStart = lineBreak & ((symbol << 1) | carry);
+  uint64_t symbolBefore = symbol | (lineBreak & ~(lineBreak + runStart));
+  uint64_t afterSymbol = (symbolBefore << 1) | carry;
+
+  // ReqFunc26: a separator between symbols, ReqFunc27: a gap after a word
+  size_t total = (size_t)__builtin_popcountll(symbol & afterSymbol) +
+                 3 * (size_t)__builtin_popcountll(space & afterSymbol);
+  for (int i = 0; i < MORSE_SIMD_BLOCK; i++) {
+    total += MORSE_CODE_COSTS[bytes[i]];
+  }
+
+  if (~lineBreak) {
+    encoder->lastWasSpace = !(symbolBefore >> 63);
+  }
+  encoder->firstChar = encoder->firstChar && symbol == 0;
+  return total;
+}
+
+#if defined(MORSE_SIMD_X86)
+
+__attribute__((target("sse2"))) static size_t
+decodeSse2(MorseDecoder *decoder, const char *morse, size_t blocks,
+           char *out) {
+  const __m128i dot = _mm_set1_epi8('.');
+  const __m128i dash = _mm_set1_epi8('-');
+  const __m128i space = _mm_set1_epi8(' ');
+  const __m128i slash = _mm_set1_epi8('/');
+  const __m128i newline = _mm_set1_epi8('\n');
+  const __m128i carriageReturn = _mm_set1_epi8('\r');
+  size_t resultIndex = 0;
+
+  for (size_t b = 0; b < blocks; b++) {
+    BlockMasks masks = {0, 0, 0, 0, 0};
+    for (int i = 0; i < 4; i++) {
+      __m128i bytes = _mm_loadu_si128(
+          (const __m128i *)(morse + b * MORSE_SIMD_BLOCK + 16 * i));
+      int shift = 16 * i;
+#define MASK16(vector)                                                         \
+  ((uint64_t)(unsigned)_mm_movemask_epi8(vector) << shift)
+      masks.dot |= MASK16(_mm_cmpeq_epi8(bytes, dot));
+      masks.dash |= MASK16(_mm_cmpeq_epi8(bytes, dash));
+      masks.space |= MASK16(_mm_cmpeq_epi8(bytes, space));
+      masks.slash |= MASK16(_mm_cmpeq_epi8(bytes, slash));
+      masks.ignored |=
+          MASK16(_mm_or_si128(_mm_cmpeq_epi8(bytes, newline),
+                              _mm_cmpeq_epi8(bytes, carriageReturn)));
+#undef MASK16
+    }
+    resultIndex += decodeBlock(decoder, &masks, out + resultIndex);
+  }
+  return resultIndex;
+}
+
+__attribute__((target("avx2"))) static size_t
+decodeAvx2(MorseDecoder *decoder, const char *morse, size_t blocks,
+           char *out) {
+  const __m256i dot = _mm256_set1_epi8('.');
+  const __m256i dash = _mm256_set1_epi8('-');
+  const __m256i space = _mm256_set1_epi8(' ');
+  const __m256i slash = _mm256_set1_epi8('/');
+  const __m256i newline = _mm256_set1_epi8('\n');
+  const __m256i carriageReturn = _mm256_set1_epi8('\r');
+  size_t resultIndex = 0;
+
+  for (size_t b = 0; b < blocks; b++) {
+    BlockMasks masks = {0, 0, 0, 0, 0};
+    for (int i = 0; i < 2; i++) {
+      __m256i bytes = _mm256_loadu_si256(
+          (const __m256i *)(morse + b * MORSE_SIMD_BLOCK + 32 * i));
+      int shift = 32 * i;
+#define MASK32(vector)                                                         \
+  ((uint64_t)(uint32_t)_mm256_movemask_epi8(vector) << shift)
+      masks.dot |= MASK32(_mm256_cmpeq_epi8(bytes, dot));
+      masks.dash |= MASK32(_mm256_cmpeq_epi8(bytes, dash));
+      masks.space |= MASK32(_mm256_cmpeq_epi8(bytes, space));
+      masks.slash |= MASK32(_mm256_cmpeq_epi8(bytes, slash));
+      masks.ignored |=
+          MASK32(_mm256_or_si256(_mm256_cmpeq_epi8(bytes, newline),
+                                 _mm256_cmpeq_epi8(bytes, carriageReturn)));
+#undef MASK32
+    }
+    resultIndex += decodeBlock(decoder, &masks, out + resultIndex);
+  }
+  return resultIndex;
+}
+
+/* AVX-512BW compares write a bit per byte, so a block is classified
+ * without any movemask */
+__attribute__((target("avx512bw"))) static size_t
+decodeAvx512(MorseDecoder *decoder, const char *morse, size_t blocks,
+             char *out) {
+  const __m512i dot = _mm512_set1_epi8('.');
+  const __m512i dash = _mm512_set1_epi8('-');
+  const __m512i space = _mm512_set1_epi8(' ');
+  const __m512i slash = _mm512_set1_epi8('/');
+  const __m512i newline = _mm512_set1_epi8('\n');
+  const __m512i carriageReturn = _mm512_set1_epi8('\r');
+  size_t resultIndex = 0;
+
+  for (size_t b = 0; b < blocks; b++) {
+    __m512i bytes =
+        _mm512_loadu_si512((const void *)(morse + b * MORSE_SIMD_BLOCK));
+    BlockMasks masks;
+    masks.dot = _mm512_cmpeq_epi8_mask(bytes, dot);
+    masks.dash = _mm512_cmpeq_epi8_mask(bytes, dash);
+    masks.space = _mm512_cmpeq_epi8_mask(bytes, space);
+    masks.slash = _mm512_cmpeq_epi8_mask(bytes, slash);
+    masks.ignored = _mm512_cmpeq_epi8_mask(bytes, newline) |
+                    _mm512_cmpeq_epi8_mask(bytes, carriageReturn);
+    resultIndex += decodeBlock(decoder, &masks, out + resultIndex);
+  }
+  return resultIndex;
+}
+
+/* Lanes of bytes within [low, high]; bytes from 0x80 on compare as
+ * negative and fail every range */
+__attribute__((target("sse2"))) static inline __m128i
+rangeSse2(__m128i bytes, char low, char high) {
+  return _mm_and_si128(_mm_cmpgt_epi8(bytes, _mm_set1_epi8((char)(low - 1))),
+                       _mm_cmplt_epi8(bytes, _mm_set1_epi8((char)(high + 1))));
+}
+
+__attribute__((target("sse2"))) static size_t
+encodeSse2(MorseEncoder *encoder, const char *text, size_t length, char *out,
+           size_t *consumed) {
+  const __m128i caseBit = _mm_set1_epi8(0x20);
+  const __m128i afterSpace =
+      _mm_set1_epi8((char)MORSE_TOKEN_AFTER_SPACE);
+  size_t i = 0;
+  size_t written = 0;
+
+  while (length - i >= MORSE_SIMD_ENCODE_BLOCK) {
+    unsigned char indices[MORSE_SIMD_ENCODE_BLOCK];
+    uint64_t valid = 0;
+    // Lane 0 of the previous-byte space mask carries the encoder state
+    __m128i previousSpace = _mm_cvtsi32_si128(encoder->lastWasSpace ? 0xff : 0);
+    for (int half = 0; half < 2; half++) {
+      __m128i bytes = _mm_loadu_si128((const __m128i *)(text + i + 16 * half));
+      __m128i lower = rangeSse2(bytes, 'a', 'z');
+      bytes = _mm_sub_epi8(bytes, _mm_and_si128(lower, caseBit));
+      __m128i space = _mm_cmpeq_epi8(bytes, _mm_set1_epi8(' '));
+      __m128i accepted = _mm_or_si128(
+          _mm_or_si128(rangeSse2(bytes, 'A', 'Z'), rangeSse2(bytes, '0', '9')),
+          space);
+      previousSpace = _mm_or_si128(previousSpace, _mm_slli_si128(space, 1));
+      bytes = _mm_or_si128(bytes, _mm_and_si128(previousSpace, afterSpace));
+      _mm_storeu_si128((__m128i *)(indices + 16 * half), bytes);
+      valid |= (uint64_t)(unsigned)_mm_movemask_epi8(accepted) << (16 * half);
+      previousSpace = _mm_srli_si128(space, 15);
+    }
+
+    size_t count = (size_t)__builtin_ctzll(~valid);
+    if (count == 0) {
+      break;
+    }
+    written += encodeBlock(encoder, indices, count, out + written);
+    i += count;
+    if (count < MORSE_SIMD_ENCODE_BLOCK) {
+      break;
+    }
+  }
+  *consumed = i;
+  return written;
+}
+
+/* AVX2 counterpart of rangeSse2() */
+__attribute__((target("avx2"))) static inline __m256i
+rangeAvx2(__m256i bytes, char low, char high) {
+  return _mm256_and_si256(
+      _mm256_cmpgt_epi8(bytes, _mm256_set1_epi8((char)(low - 1))),
+      _mm256_cmpgt_epi8(_mm256_set1_epi8((char)(high + 1)), bytes));
+}
+
+/* Token indices of one 32-byte block into indices; returns the mask of
+ * fast-path bytes */
+__attribute__((target("avx2"))) static inline uint64_t
+classifyAvx2(const MorseEncoder *encoder, const char *block,
+             unsigned char *indices) {
+  const __m256i caseBit = _mm256_set1_epi8(0x20);
+  const __m256i afterSpace =
+      _mm256_set1_epi8((char)MORSE_TOKEN_AFTER_SPACE);
+  __m256i bytes = _mm256_loadu_si256((const __m256i *)block);
+  __m256i lower = rangeAvx2(bytes, 'a', 'z');
+  bytes = _mm256_sub_epi8(bytes, _mm256_and_si256(lower, caseBit));
+  __m256i space = _mm256_cmpeq_epi8(bytes, _mm256_set1_epi8(' '));
+  __m256i accepted = _mm256_or_si256(
+      _mm256_or_si256(rangeAvx2(bytes, 'A', 'Z'), rangeAvx2(bytes, '0', '9')),
+      space);
+  // Space mask shifted up one byte across both lanes, lane 0 carrying the
+  // encoder state
+  __m256i previousSpace = _mm256_alignr_epi8(
+      space, _mm256_permute2x128_si256(space, space, 0x08), 15);
+  int carry = encoder->lastWasSpace ? 0xff : 0;
+  previousSpace = _mm256_or_si256(
+      previousSpace, _mm256_set_epi32(0, 0, 0, 0, 0, 0, 0, carry));
+  bytes = _mm256_or_si256(bytes, _mm256_and_si256(previousSpace, afterSpace));
+  _mm256_storeu_si256((__m256i *)indices, bytes);
+  return (uint32_t)_mm256_movemask_epi8(accepted);
+}
+
+__attribute__((target("avx2"))) static size_t
+encodeAvx2(MorseEncoder *encoder, const char *text, size_t length, char *out,
+           size_t *consumed) {
+  size_t i = 0;
+  size_t written = 0;
+
+  while (length - i >= MORSE_SIMD_ENCODE_BLOCK) {
+    unsigned char indices[MORSE_SIMD_ENCODE_BLOCK];
+    uint64_t valid = classifyAvx2(encoder, text + i, indices);
+    size_t count = (size_t)__builtin_ctzll(~valid);
+    if (count == 0) {
+      break;
+    }
+    written += encodeBlock(encoder, indices, count, out + written);
+    i += count;
+    if (count < MORSE_SIMD_ENCODE_BLOCK) {
+      break;
+    }
+  }
+  *consumed = i;
+  return written;
+}
+
+/* AVX-512 VBMI2 emission: the tokens of 8 bytes are gathered into one
+ * vector, and their output bytes - the nonzero ones, tokens being
+ * zero-padded - are compressed to the front and stored with one masked
+ * store, which writes exactly the output and needs no staging */
+__attribute__((target("avx512f,avx512bw,avx512vbmi2"))) static inline size_t
+compressBlock(MorseEncoder *encoder, const unsigned char *indices,
+              size_t count, char *out) {
+  const void *tokens = MORSE_TOKEN_BYTES[encoder->useSlashWordspacer];
+  size_t written = 0;
+
+  for (size_t i = 0; i < count; i += 8) {
+    size_t group = count - i < 8 ? count - i : 8;
+    __m512i index = _mm512_cvtepu8_epi64(
+        _mm_loadl_epi64((const __m128i *)(indices + i)));
+    __m512i bytes = _mm512_mask_i64gather_epi64(
+        _mm512_setzero_si512(), (__mmask8)((1u << group) - 1), index,
+        tokens, MORSE_TOKEN_SIZE);
+    __mmask64 output = _mm512_test_epi8_mask(bytes, bytes);
+    unsigned int length = (unsigned int)__builtin_popcountll(output);
+    __mmask64 stored = length ? ~0ULL >> (64 - length) : 0;
+    _mm512_mask_storeu_epi8(out + written, stored,
+                            _mm512_maskz_compress_epi8(output, bytes));
+    written += length;
+  }
+  encoder->lastWasSpace =
+      (indices[count - 1] & ~MORSE_TOKEN_AFTER_SPACE) == ' ';
+  return written;
+}
+
+__attribute__((target("avx512f,avx512bw,avx512vbmi2"))) static size_t
+encodeAvx512(MorseEncoder *encoder, const char *text, size_t length,
+             char *out, size_t *consumed) {
+  size_t i = 0;
+  size_t written = 0;
+
+  while (length - i >= MORSE_SIMD_ENCODE_BLOCK) {
+    unsigned char indices[MORSE_SIMD_ENCODE_BLOCK];
+    uint64_t valid = classifyAvx2(encoder, text + i, indices);
+    size_t count = (size_t)__builtin_ctzll(~valid);
+    if (count == 0) {
+      break;
+    }
+    written += compressBlock(encoder, indices, count, out + written);
+    i += count;
+    if (count < MORSE_SIMD_ENCODE_BLOCK) {
+      break;
+    }
+  }
+  *consumed = i;
+  return written;
+}
+
+__attribute__((target("sse2"))) static size_t
+measureSse2(MorseEncoder *encoder, const char *text, size_t blocks) {
+  const __m128i space = _mm_set1_epi8(' ');
+  const __m128i newline = _mm_set1_epi8('\n');
+  const __m128i carriageReturn = _mm_set1_epi8('\r');
+  size_t total = 0;
+
+  for (size_t b = 0; b < blocks; b++) {
+    const char *block = text + b * MORSE_SIMD_BLOCK;
+    uint64_t spaces = 0;
+    uint64_t lineBreaks = 0;
+    for (int i = 0; i < 4; i++) {
+      __m128i bytes = _mm_loadu_si128((const __m128i *)(block + 16 * i));
+      int shift = 16 * i;
+      spaces |= (uint64_t)(unsigned)_mm_movemask_epi8(
+                    _mm_cmpeq_epi8(bytes, space))
+                << shift;
+      lineBreaks |= (uint64_t)(unsigned)_mm_movemask_epi8(
+                        _mm_or_si128(_mm_cmpeq_epi8(bytes, newline),
+                                     _mm_cmpeq_epi8(bytes, carriageReturn)))
+                    << shift;
+    }
+    total += measureBlock(encoder, spaces, lineBreaks,
+                          (const unsigned char *)block);
+  }
+  return total;
+}
+
+__attribute__((target("avx2,popcnt"))) static size_t
+measureAvx2(MorseEncoder *encoder, const char *text, size_t blocks) {
+  const __m256i space = _mm256_set1_epi8(' ');
+  const __m256i newline = _mm256_set1_epi8('\n');
+  const __m256i carriageReturn = _mm256_set1_epi8('\r');
+  size_t total = 0;
+
+  for (size_t b = 0; b < blocks; b++) {
+    const char *block = text + b * MORSE_SIMD_BLOCK;
+    uint64_t spaces = 0;
+    uint64_t lineBreaks = 0;
+    for (int i = 0; i < 2; i++) {
+      __m256i bytes = _mm256_loadu_si256((const __m256i *)(block + 32 * i));
+      int shift = 32 * i;
+      spaces |= (uint64_t)(uint32_t)_mm256_movemask_epi8(
+                    _mm256_cmpeq_epi8(bytes, space))
+                << shift;
+      lineBreaks |=
+          (uint64_t)(uint32_t)_mm256_movemask_epi8(
+              _mm256_or_si256(_mm256_cmpeq_epi8(bytes, newline),
+                              _mm256_cmpeq_epi8(bytes, carriageReturn)))
+          << shift;
+    }
+    total += measureBlock(encoder, spaces, lineBreaks,
+                          (const unsigned char *)block);
+  }
+  return total;
+}
+
+__attribute__((target("avx512bw,popcnt"))) static size_t
+measureAvx512(MorseEncoder *encoder, const char *text, size_t blocks) {
+  const __m512i space = _mm512_set1_epi8(' ');
+  const __m512i newline = _mm512_set1_epi8('\n');
+  const __m512i carriageReturn = _mm512_set1_epi8('\r');
+  size_t total = 0;
+
+  for (size_t b = 0; b < blocks; b++) {
+    const char *block = text + b * MORSE_SIMD_BLOCK;
+    __m512i bytes = _mm512_loadu_si512((const void *)block);
+    uint64_t lineBreaks = _mm512_cmpeq_epi8_mask(bytes, newline) |
+                          _mm512_cmpeq_epi8_mask(bytes, carriageReturn);
+    total += measureBlock(encoder, _mm512_cmpeq_epi8_mask(bytes, space),
+                          lineBreaks, (const unsigned char *)block);
+  }
+  return total;
+}
+
+#elif defined(MORSE_SIMD_NEON)
+
+/* movemask for NEON: one bit per byte of a comparison result */
+static inline uint64_t neonMask(uint8x16_t matches) {
+  static const uint8_t weights[16] = {1, 2, 4, 8, 16, 32, 64, 128,
+                                      1, 2, 4, 8, 16, 32, 64, 128};
+  uint8x16_t bits = vandq_u8(matches, vld1q_u8(weights));
+  return (uint64_t)vaddv_u8(vget_low_u8(bits)) |
+         (uint64_t)vaddv_u8(vget_high_u8(bits)) << 8;
+}
+
+static size_t decodeNeon(MorseDecoder *decoder, const char *morse,
+                         size_t blocks, char *out) {
+  size_t resultIndex = 0;
+
+  for (size_t b = 0; b < blocks; b++) {
+    BlockMasks masks = {0, 0, 0, 0, 0};
+    for (int i = 0; i < 4; i++) {
+      uint8x16_t bytes = vld1q_u8(
+          (const uint8_t *)(morse + b * MORSE_SIMD_BLOCK + 16 * i));
+      int shift = 16 * i;
+      masks.dot |= neonMask(vceqq_u8(bytes, vdupq_n_u8('.'))) << shift;
+      masks.dash |= neonMask(vceqq_u8(bytes, vdupq_n_u8('-'))) << shift;
+      masks.space |= neonMask(vceqq_u8(bytes, vdupq_n_u8(' '))) << shift;
+      masks.slash |= neonMask(vceqq_u8(bytes, vdupq_n_u8('/'))) << shift;
+      masks.ignored |= neonMask(vorrq_u8(vceqq_u8(bytes, vdupq_n_u8('\n')),
+                                         vceqq_u8(bytes, vdupq_n_u8('\r'))))
+                       << shift;
+    }
+    resultIndex += decodeBlock(decoder, &masks, out + resultIndex);
+  }
+  return resultIndex;
+}
+
+static size_t measureNeon(MorseEncoder *encoder, const char *text,
+                          size_t blocks) {
+  size_t total = 0;
+
+  for (size_t b = 0; b < blocks; b++) {
+    const char *block = text + b * MORSE_SIMD_BLOCK;
+    uint64_t spaces = 0;
+    uint64_t lineBreaks = 0;
+    for (int i = 0; i < 4; i++) {
+      uint8x16_t bytes = vld1q_u8((const uint8_t *)(block + 16 * i));
+      int shift = 16 * i;
+      spaces |= neonMask(vceqq_u8(bytes, vdupq_n_u8(' '))) << shift;
+      lineBreaks |= neonMask(vorrq_u8(vceqq_u8(bytes, vdupq_n_u8('\n')),
+                                      vceqq_u8(bytes, vdupq_n_u8('\r'))))
+                    << shift;
+    }
+    total += measureBlock(encoder, spaces, lineBreaks,
+                          (const unsigned char *)block);
+  }
+  return total;
+}
+
+#endif
+
+size_t morseSimdDecode(MorseDecoder *decoder, MorseKernel kernel,
+                       const char *morse, size_t blocks, char *out) {
+  switch (kernel) {
+#if defined(MORSE_SIMD_X86)
+  case MORSE_KERNEL_AVX512:
+    return decodeAvx512(decoder, morse, blocks, out);
+  case MORSE_KERNEL_AVX2:
+    return decodeAvx2(decoder, morse, blocks, out);
+  case MORSE_KERNEL_SSE2:
+    return decodeSse2(decoder, morse, blocks, out);
+#elif defined(MORSE_SIMD_NEON)
+  case MORSE_KERNEL_NEON:
+    return decodeNeon(decoder, morse, blocks, out);
+#endif
+  default:
+    return morseDecoderFeedScalar(decoder, morse, blocks * MORSE_SIMD_BLOCK,
+                                  out);
+  }
+}
+
+size_t morseSimdEncode(MorseEncoder *encoder, MorseKernel kernel,
+                       const char *text, size_t length, char *out,
+                       size_t *consumed) {
+  switch (kernel) {
+#if defined(MORSE_SIMD_X86)
+  case MORSE_KERNEL_AVX512:
+    return compressSupported
+               ? encodeAvx512(encoder, text, length, out, consumed)
+               : encodeAvx2(encoder, text, length, out, consumed);
+  case MORSE_KERNEL_AVX2:
+    return encodeAvx2(encoder, text, length, out, consumed);
+  case MORSE_KERNEL_SSE2:
+    return encodeSse2(encoder, text, length, out, consumed);
+#endif
+  default:
+    *consumed = 0;
+    return 0;
+  }
+}
+
+size_t morseSimdMeasure(MorseEncoder *encoder, MorseKernel kernel,
+                        const char *text, size_t blocks) {
+  switch (kernel) {
+#if defined(MORSE_SIMD_X86)
+  case MORSE_KERNEL_AVX512:
+    return measureAvx512(encoder, text, blocks);
+  case MORSE_KERNEL_AVX2:
+    return measureAvx2(encoder, text, blocks);
+  case MORSE_KERNEL_SSE2:
+    return measureSse2(encoder, text, blocks);
+#elif defined(MORSE_SIMD_NEON)
+  case MORSE_KERNEL_NEON:
+    return measureNeon(encoder, text, blocks);
+#endif
+  default:
+    return morseEncoderMeasureScalar(encoder, text,
+                                     blocks * MORSE_SIMD_BLOCK);
+  }
+}
@@ -0,0 +1,216 @@
+/**
+ * @file morse_stats.c
+ * @brief Counters and phase timings for --stats
+ * @author Diego Rubio Carrera
+ */
+
+#include <morse_packed.h>
+#include <morse_stats.h>
+#include <morse_tables.h>
+#include <time.h>
+
+static double clockSeconds(clockid_t clock);
+
+/* Labels of the phases, in MorseStatsPhase order */
+static const char *const PHASE_NAMES[MORSE_PHASE_COUNT] = {
+    "input", "convert", "output", "total"};
+
+void morseStatsInit(MorseStats *stats) { *stats = (MorseStats){0}; }
+
+void morseStatsBeginInput(MorseStats *stats) {
+  stats->inWord = false;
+  stats->inMorseSymbol = false;
+}
+
+MorseStatsClock morseStatsStart(void) {
+  MorseStatsClock start = {clockSeconds(CLOCK_MONOTONIC),
+                           clockSeconds(CLOCK_PROCESS_CPUTIME_ID)};
+  return start;
+}
+
+void morseStatsStop(MorseStats *stats, MorseStatsPhase phase,
+                    MorseStatsClock start) {
+  MorseStatsClock now = morseStatsStart();
+  stats->wall[phase] += now.wall - start.wall;
+  stats->cpu[phase] += now.cpu - start.cpu;
+}
+
+void morseStatsCountText(MorseStats *stats, const char *text, size_t length,
+                         bool countUnsupported) {
+  bool inWord = stats->inWord;
+  for (size_t i = 0; i < length; i++) {
+    unsigned char c = (unsigned char)text[i];
+    if (c == '\n' || c == '\r') {
+      continue;
+    }
+    if (c == ' ') {
+      inWord = false;
+      continue;
+    }
+    stats->symbols++;
+    stats->words += !inWord;
+    if (countUnsupported) {
+      stats->unsupported += MORSE_ENCODE_TABLE[c].length == 0;
+    }
+    inWord = true;
+  }
+  stats->inWord = inWord;
+}
+
+/* A symbol is a run of anything but space and slash; CR/LF inside it are
+ * skipped by the decoder and do not split it */
+void morseStatsCountMorse(MorseStats *stats, const char *morse,
+                          size_t length) {
+  bool inSymbol = stats->inMorseSymbol;
+  for (size_t i = 0; i < length; i++) {
+    char c = morse[i];
+    if (c == '\n' || c == '\r') {
+      continue;
+    }
+    bool element = c != ' ' && c != '/';
+    stats->morseSymbols += element && !inSymbol;
+    inSymbol = element;
+  }
+  stats->inMorseSymbol = inSymbol;
+}
+
+void morseStatsCountPacked(MorseStats *stats, const char *packed,
+                           size_t length) {
+  for (size_t i = 0; i < length; i++) {
+    stats->morseSymbols += packed[i] != (char)MORSE_PACKED_GAP;
+  }
+}
+
+void morseStatsCountTokens(MorseStats *stats, const char *packed,
+                           size_t length) {
+  bool inWord = stats->inWord;
+  for (size_t i = 0; i < length; i++) {
+    unsigned char token = (unsigned char)packed[i];
+    if (token == MORSE_PACKED_GAP) {
+      inWord = false;
+      continue;
+    }
+    stats->symbols++;
+    stats->words += !inWord;
+    stats->unsupported += token == MORSE_PACKED_UNSUPPORTED;
+    inWord = true;
+  }
+  stats->inWord = inWord;
+}
+
+void morseStatsCountRequest(MorseStats *stats, double seconds) {
+  long long microseconds = (long long)(seconds * 1e6);
+  int bucket = 0;
+  while (bucket + 1 < MORSE_LATENCY_BUCKETS && microseconds >= 2ll << bucket) {
+    bucket++;
+  }
+  stats->requests++;
+  stats->latency[bucket]++;
+}
+
+void morseStatsMerge(MorseStats *into, const MorseStats *from) {
+  into->bytesIn += from->bytesIn;
+  into->bytesOut += from->bytesOut;
+  into->symbols += from->symbols;
+  into->words += from->words;
+  into->unsupported += from->unsupported;
+  into->morseSymbols += from->morseSymbols;
+  into->requests += from->requests;
+  for (int bucket = 0; bucket < MORSE_LATENCY_BUCKETS; bucket++) {
+    into->latency[bucket] += from->latency[bucket];
+  }
+  for (int phase = 0; phase < MORSE_PHASE_COUNT; phase++) {
+    into->wall[phase] += from->wall[phase];
+    into->cpu[phase] += from->cpu[phase];
+  }
+}
+
+void morseStatsPrint(const MorseStats *stats, bool decode, bool transcode,
+                     bool json, FILE *file) {
+  // Symbols the decoder read but could not turn into a character
+  long long unknownCodes = decode ? stats->morseSymbols - stats->symbols : 0;
+  const char *operation = decode      ? "decode"
+                          : transcode ? "transcode"
+                                      : "encode";
+  if (stats->requests > 0) {
+    operation = "serve";
+  }
+
+  if (json) {
+    fprintf(file, "{\n");
+    fprintf(file, "  \"operation\": \"%s\",\n", operation);
+    fprintf(file, "  \"bytes_in\": %lld,\n", stats->bytesIn);
+    fprintf(file, "  \"bytes_out\": %lld,\n", stats->bytesOut);
+    fprintf(file, "  \"symbols\": %lld,\n", stats->symbols);
+    fprintf(file, "  \"words\": %lld,\n", stats->words);
+    fprintf(file, "  \"unsupported\": %lld,\n", stats->unsupported);
+    fprintf(file, "  \"unknown_codes\": %lld,\n", unknownCodes);
+    if (stats->requests > 0) {
+      // Keyed by the bucket's upper bound in microseconds
+      fprintf(file, "  \"requests\": %lld,\n", stats->requests);
+      fprintf(file, "  \"latency_us\": {");
+      const char *separator = "";
+      for (int bucket = 0; bucket < MORSE_LATENCY_BUCKETS; bucket++) {
+        if (stats->latency[bucket] > 0) {
+          fprintf(file, "%s\"%lld\": %lld", separator, 2ll << bucket,
+                  stats->latency[bucket]);
+          separator = ", ";
+        }
+      }
+      fprintf(file, "},\n");
+    }
+    if (stats->cacheLimit > 0) {
+      fprintf(file, "  \"cache_hits\": %lld,\n", stats->cacheHits);
+      fprintf(file, "  \"cache_misses\": %lld,\n", stats->cacheMisses);
+      fprintf(file, "  \"cache_evictions\": %lld,\n",
+              stats->cacheEvictions);
+      fprintf(file, "  \"cache_bytes\": %lld,\n", stats->cacheBytes);
+      fprintf(file, "  \"cache_limit\": %lld,\n", stats->cacheLimit);
+    }
+    for (int phase = 0; phase < MORSE_PHASE_COUNT; phase++) {
+      fprintf(file, "  \"%s_wall_s\": %.6f,\n", PHASE_NAMES[phase],
+              stats->wall[phase]);
+      fprintf(file, "  \"%s_cpu_s\": %.6f%s\n", PHASE_NAMES[phase],
+              stats->cpu[phase], phase + 1 < MORSE_PHASE_COUNT ? "," : "");
+    }
+    fprintf(file, "}\n");
+    return;
+  }
+
+  fprintf(file, "Statistics (%s):\n", operation);
+  fprintf(file, "  Bytes in:       %lld\n", stats->bytesIn);
+  fprintf(file, "  Bytes out:      %lld\n", stats->bytesOut);
+  fprintf(file, "  Symbols:        %lld\n", stats->symbols);
+  fprintf(file, "  Words:          %lld\n", stats->words);
+  if (decode) {
+    fprintf(file, "  Unknown codes:  %lld\n", unknownCodes);
+  } else {
+    fprintf(file, "  Unsupported:    %lld\n", stats->unsupported);
+  }
+  for (int phase = 0; phase < MORSE_PHASE_COUNT; phase++) {
+    fprintf(file, "  %-8s        wall %.6f s, cpu %.6f s\n",
+            PHASE_NAMES[phase], stats->wall[phase], stats->cpu[phase]);
+  }
+  if (stats->requests > 0) {
+    fprintf(file, "  Requests:       %lld\n", stats->requests);
+    for (int bucket = 0; bucket < MORSE_LATENCY_BUCKETS; bucket++) {
+      if (stats->latency[bucket] > 0) {
+        fprintf(file, "    < %8lld us  %lld\n", 2ll << bucket,
+                stats->latency[bucket]);
+      }
+    }
+  }
+  if (stats->cacheLimit > 0) {
+    fprintf(file, "  Cache hits:     %lld\n", stats->cacheHits);
+    fprintf(file, "  Cache misses:   %lld\n", stats->cacheMisses);
+    fprintf(file, "  Cache evicted:  %lld\n", stats->cacheEvictions);
+    fprintf(file, "  Cache size:     %lld of %lld bytes\n", stats->cacheBytes,
+            stats->cacheLimit);
+  }
+}
+
+static double clockSeconds(clockid_t clock) {
+  struct timespec now;
+  clock_gettime(clock, &now);
+  return (double)now.tv_sec + (double)now.tv_nsec / 1e9;
+}
@@ -0,0 +1,257 @@
+/**
+ * @file morse_timing.c
+ * @brief Online k-means classification of key timing
+ * @author Diego Rubio Carrera
+ */
+
+#include <morse_codec.h>
+#include <morse_tables.h>
+#include <morse_timing.h>
+
+/* Step of a centre towards a duration assigned to it, once it has
+ * learned from 1 / LEARNING_RATE of them; the first ones are averaged */
+#define LEARNING_RATE 0.125f
+#define LEARNING_COUNT 8
+
+/* Step of the other centres towards the duration's PARIS ratios */
+#define COUPLING_RATE 0.03125f
+
+/* A duration counts at most this many times its centre, so a pause or a
+ * stuck key does not throw the centre off */
+#define OUTLIER_LIMIT 2.0f
+
+/* Microseconds of one unit at 1 WPM */
+#define PARIS_UNIT 1200000.0f
+
+/* Durations in units: dot and dash; element, letter and word gap */
+static const float MARK_RATIOS[2] = {1.0f, 3.0f};
+static const float SPACE_RATIOS[3] = {1.0f, 3.0f, 7.0f};
+
+/* Keying reader states within a line */
+enum {
+  LINE_START, // blanks before the time
+  LINE_TIME,  // digits of the time
+  LINE_GAP,   // blanks before the word
+  LINE_WORD,  // letters of the word
+  LINE_END,   // blanks after the word
+  LINE_SKIP   // not a timeline line, wait for the newline
+};
+
+static unsigned int classify(const float *centres, unsigned int count,
+                             float duration);
+static void learn(float *centres, unsigned char *counts,
+                  const float *ratios, unsigned int count, unsigned int index,
+                  float duration);
+static size_t endSymbol(MorseTimingDecoder *decoder, char *out);
+static size_t endLine(MorseKeyingReader *reader, char *out);
+
+void morseTimingInit(MorseTimingDecoder *decoder, unsigned int wpm) {
+  float unit = PARIS_UNIT / (float)wpm;
+  for (unsigned int i = 0; i < 2; i++) {
+    decoder->mark[i] = unit * MARK_RATIOS[i];
+  }
+  for (unsigned int i = 0; i < 3; i++) {
+    decoder->space[i] = unit * SPACE_RATIOS[i];
+  }
+  decoder->markCount[0] = decoder->markCount[1] = 0;
+  decoder->spaceCount[0] = decoder->spaceCount[1] = decoder->spaceCount[2] = 0;
+  decoder->code = 0;
+  decoder->codeLength = 0;
+  decoder->inWord = false;
+}
+
+size_t morseTimingFeed(MorseTimingDecoder *decoder, bool keyDown,
+                       unsigned long duration, char *out) {
+  float length = (float)duration;
+  if (keyDown) {
+    unsigned int element = classify(decoder->mark, 2, length);
+    learn(decoder->mark, decoder->markCount, MARK_RATIOS, 2, element, length);
+    // The gap between elements is a dot long; the gaps not seen yet
+    // follow the dots, so the first spaces are told apart by the marks
+    for (unsigned int i = 0; i < 3; i++) {
+      if (decoder->spaceCount[i] == 0) {
+        decoder->space[i] = decoder->mark[0] * SPACE_RATIOS[i];
+      } else if (i == 0) {
+        decoder->space[0] += (decoder->mark[0] - decoder->space[0]) *
+                             COUPLING_RATE;
+      }
+    }
+    if (decoder->codeLength < MORSE_MAX_CODE_LENGTH) {
+      decoder->code |= (unsigned char)(element << decoder->codeLength);
+    }
+    if (decoder->codeLength <= MORSE_MAX_CODE_LENGTH) {
+      decoder->codeLength++;
+    }
+    return 0;
+  }
+
+  unsigned int gap = classify(decoder->space, 3, length);
+  learn(decoder->space, decoder->spaceCount, SPACE_RATIOS, 3, gap, length);
+  if (gap == 0) {
+    return 0;
+  }
+  size_t written = endSymbol(decoder, out);
+  if (gap == 2 && decoder->inWord) {
+    // ReqFunc27: a word gap decodes to a space
+    out[written++] = ' ';
+    decoder->inWord = false;
+  }
+  return written;
+}
+
+size_t morseTimingFinish(MorseTimingDecoder *decoder, char *out) {
+  size_t written = endSymbol(decoder, out);
+  decoder->inWord = false;
+  return written;
+}
+
+/* Index of the nearest centre; centres rise, so the boundaries are the
+ * midpoints between neighbours */
+static unsigned int classify(const float *centres, unsigned int count,
+                             float duration) {
+  unsigned int index = 0;
+  while (index + 1 < count &&
+         duration > (centres[index] + centres[index + 1]) * 0.5f) {
+    index++;
+  }
+  return index;
+}
+
+/* Move centre index towards duration and the others towards the unit it
+ * implies, keeping them in order. A centre without durations of its own
+ * sits exactly at the ratio of the latest one. */
+static void learn(float *centres, unsigned char *counts,
+                  const float *ratios, unsigned int count, unsigned int index,
+                  float duration) {
+  if (counts[index] > 0) {
+    float limit = centres[index] * OUTLIER_LIMIT;
+    duration = duration < limit ? duration : limit;
+  }
+  if (counts[index] < LEARNING_COUNT) {
+    counts[index]++;
+  }
+  float unit = duration / ratios[index];
+  for (unsigned int i = 0; i < count; i++) {
+    float target = i == index ? duration : unit * ratios[i];
+    float rate = i != index       ? (counts[i] > 0 ? COUPLING_RATE : 1.0f)
+                 : counts[i] < LEARNING_COUNT ? 1.0f / (float)counts[i]
+                                              : LEARNING_RATE;
+    centres[i] += (target - centres[i]) * rate;
+  }
+  for (unsigned int i = 1; i < count; i++) {
+    if (centres[i] < centres[i - 1]) {
+      centres[i] = centres[i - 1];
+    }
+  }
+}
+
+/* Write the character of the symbol keyed so far, if it has one */
+static size_t endSymbol(MorseTimingDecoder *decoder, char *out) {
+  if (decoder->codeLength == 0) {
+    return 0;
+  }
+  char c = '\0';
+  if (decoder->codeLength <= MORSE_MAX_CODE_LENGTH) {
+    c = MORSE_DECODE_TABLE[MORSE_DECODE_INDEX(decoder->code,
+                                              decoder->codeLength)];
+  }
+  decoder->code = 0;
+  decoder->codeLength = 0;
+  if (c == '\0') {
+    return 0;
+  }
+  out[0] = c;
+  decoder->inWord = true;
+  return 1;
+}
+
+void morseKeyingInit(MorseKeyingReader *reader, unsigned int wpm) {
+  morseTimingInit(&reader->timing, wpm);
+  reader->previous = 0;
+  reader->time = 0;
+  reader->wordLength = 0;
+  reader->state = LINE_START;
+  reader->keyDown = false;
+  reader->started = false;
+}
+
+size_t morseKeyingDecode(MorseKeyingReader *reader, const char *text,
+                         size_t length, char *out) {
+  size_t resultIndex = 0;
+  for (size_t i = 0; i < length; i++) {
+    char c = text[i];
+    if (c == '\n') {
+      resultIndex += endLine(reader, out + resultIndex);
+      continue;
+    }
+    bool blank = c == ' ' || c == '\t' || c == '\r';
+    switch (reader->state) {
+    case LINE_START:
+    case LINE_TIME:
+      if (c >= '0' && c <= '9') {
+        reader->time = reader->time * 10 + (unsigned long long)(c - '0');
+        reader->state = LINE_TIME;
+      } else if (!blank || reader->state == LINE_TIME) {
+        reader->state = blank ? LINE_GAP : LINE_SKIP;
+      }
+      break;
+    case LINE_GAP:
+    case LINE_WORD:
+      if (c >= 'a' && c <= 'z' && reader->wordLength < sizeof(reader->word)) {
+        reader->word[reader->wordLength++] = c;
+        reader->state = LINE_WORD;
+      } else if (!blank || reader->state == LINE_WORD) {
+        reader->state = blank ? LINE_END : LINE_SKIP;
+      }
+      break;
+    case LINE_END:
+      if (!blank) {
+        reader->state = LINE_SKIP;
+      }
+      break;
+    default:
+      break;
+    }
+  }
+  return resultIndex;
+}
+
+size_t morseKeyingFinish(MorseKeyingReader *reader, char *out) {
+  size_t written = endLine(reader, out);
+  written += morseTimingFinish(&reader->timing, out + written);
+  reader->started = false;
+  reader->keyDown = false;
+  return written;
+}
+
+/* Apply a complete line: the time since the previous transition is a mark
+ * if the key was down, else a space */
+static size_t endLine(MorseKeyingReader *reader, char *out) {
+  size_t written = 0;
+  bool complete = reader->state == LINE_WORD || reader->state == LINE_END;
+  bool down = reader->wordLength == 4 && reader->word[0] == 'd' &&
+              reader->word[1] == 'o' && reader->word[2] == 'w' &&
+              reader->word[3] == 'n';
+  bool up = reader->wordLength == 2 && reader->word[0] == 'u' &&
+            reader->word[1] == 'p';
+  if (complete && (down || up) &&
+      (!reader->started || reader->time >= reader->previous)) {
+    if (reader->started && down != reader->keyDown) {
+      unsigned long long duration = reader->time - reader->previous;
+      unsigned long clamped = duration < 0xFFFFFFFFu
+                                  ? (unsigned long)duration
+                                  : 0xFFFFFFFFu;
+      written = morseTimingFeed(&reader->timing, reader->keyDown, clamped,
+                                out);
+    }
+    if (!reader->started || down != reader->keyDown) {
+      reader->previous = reader->time;
+      reader->keyDown = down;
+      reader->started = true;
+    }
+  }
+  reader->time = 0;
+  reader->wordLength = 0;
+  reader->state = LINE_START;
+  return written;
+}
@@ -0,0 +1,444 @@
+/**
+ * @file morse_gentables.c
+ * @brief Build-time generator of the codec lookup tables
+ * @author Diego Rubio Carrera
+ *
+ * Expands the alphabet of morse_symbols.h into the constant tables
+ * declared in morse_tables.h and writes them as C source. The build fails
+ * if the alphabet is inconsistent: a malformed or duplicate code, a
+ * character listed twice, or any code whose decoding is not the exact
+ * inverse of its encoding.
+ *
+ * The code tables given after it are compiled by morseAlphabetCompile()
+ * into the constant MORSE_BUILTIN_ALPHABETS, so using one costs nothing at
+ * run time; a malformed table fails the build as well.
+ *
+ * Usage: morse_gentables OUTPUT.c [NAME=TABLE...]
+ */
+
+#include <ctype.h>
+#include <morse_alphabet.h>
+#include <morse_packed.h>
+#include <morse_symbols.h>
+#include <morse_tables.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* One entry of the alphabet */
+typedef struct {
+  char character;
+  const char *code;
+} Symbol;
+
+#define MORSE_SYMBOL_ENTRY(character, code) {(character), (code)},
+static const Symbol SYMBOLS[] = {MORSE_SYMBOLS(MORSE_SYMBOL_ENTRY)};
+#define SYMBOL_COUNT (sizeof(SYMBOLS) / sizeof(SYMBOLS[0]))
+
+/* The tables, filled in like the generated file will define them */
+static const char *encodeCodes[256];
+static unsigned char encodeLengths[256];
+static char decodeTable[MORSE_DECODE_TABLE_SIZE];
+static unsigned char codeCosts[256];
+static char tokenBytes[2][256][MORSE_TOKEN_SIZE];
+static unsigned char tokenLengths[2][256];
+static unsigned char packedTokens[256];
+static char packedDecode[256];
+static char channelDecode[256];
+
+/* Code tables of the command line */
+#define MAX_ALPHABETS 8
+static MorseAlphabet alphabets[MAX_ALPHABETS];
+static size_t alphabetLengths[MAX_ALPHABETS];
+static int alphabetCount;
+
+static bool buildCodecTables(void);
+static void buildTokens(void);
+static void buildPacked(void);
+static bool checkInverse(void);
+static bool compileAlphabet(const char *argument);
+static unsigned int decodeIndex(const char *code);
+static unsigned int channelIndex(const char *code);
+static void writeCharacter(FILE *file, int c);
+static void writeString(FILE *file, const char *data, size_t length);
+static bool writeTables(FILE *file);
+static void writeAlphabet(FILE *file, int index);
+static void writeAlphabetString(FILE *file, MorseAlphabetString string);
+
+int main(int argc, char **argv) {
+  if (argc < 2 || argc - 2 > MAX_ALPHABETS) {
+    fprintf(stderr, "Usage: %s OUTPUT.c [NAME=TABLE...]\n", argv[0]);
+    return 1;
+  }
+  if (!buildCodecTables() || !checkInverse()) {
+    return 1;
+  }
+  for (int i = 2; i < argc; i++) {
+    if (!compileAlphabet(argv[i])) {
+      return 1;
+    }
+  }
+  buildTokens();
+  buildPacked();
+
+  FILE *file = fopen(argv[1], "w");
+  if (!file) {
+    fprintf(stderr, "morse_gentables: could not create '%s'\n", argv[1]);
+    return 1;
+  }
+  bool written = writeTables(file);
+  if (fclose(file) != 0 || !written) {
+    fprintf(stderr, "morse_gentables: could not write '%s'\n", argv[1]);
+    remove(argv[1]);
+    return 1;
+  }
+  return 0;
+}
+
+/* Encode and decode tables and code costs, validating every symbol */
+static bool buildCodecTables(void) {
+  for (size_t i = 0; i < SYMBOL_COUNT; i++) {
+    unsigned char c = (unsigned char)SYMBOLS[i].character;
+    const char *code = SYMBOLS[i].code;
+    size_t length = strlen(code);
+
+    // ' ', CR and LF separate symbols and '*' replaces unsupported ones
+    if (c <= ' ' || c >= 0x7F || islower(c) || c == '*') {
+      fprintf(stderr, "morse_symbols.h: character 0x%02X cannot be a "
+                      "symbol\n", c);
+      return false;
+    }
+    if (length == 0 || length > MORSE_MAX_CODE_LENGTH ||
+        strspn(code, ".-") != length) {
+      fprintf(stderr, "morse_symbols.h: '%c': \"%s\" is not a code of 1-%d "
+                      "dots and dashes\n", c, code, MORSE_MAX_CODE_LENGTH);
+      return false;
+    }
+    if (encodeCodes[c]) {
+      fprintf(stderr, "morse_symbols.h: '%c' is listed twice\n", c);
+      return false;
+    }
+    unsigned int index = decodeIndex(code);
+    if (decodeTable[index] != '\0') {
+      fprintf(stderr, "morse_symbols.h: '%c' and '%c' share the code %s\n",
+              decodeTable[index], c, code);
+      return false;
+    }
+
+    decodeTable[index] = (char)c;
+    channelDecode[channelIndex(code)] = (char)c;
+    // ReqFunc15: lower-case letters encode like upper-case ones
+    int forms[2] = {c, tolower(c)};
+    for (int form = 0; form < 2; form++) {
+      encodeCodes[forms[form]] = code;
+      encodeLengths[forms[form]] = (unsigned char)length;
+    }
+  }
+
+  for (int c = 0; c < 256; c++) {
+    codeCosts[c] = encodeLengths[c] ? encodeLengths[c] : 1;
+  }
+  codeCosts[' '] = codeCosts['\n'] = codeCosts['\r'] = 0;
+  return true;
+}
+
+/* Encoder tokens for runs of letters, digits and spaces - ReqFunc26-27,
+ * ReqOptFunc02 */
+static void buildTokens(void) {
+  for (int slash = 0; slash < 2; slash++) {
+    // A space after a space emits nothing
+    memcpy(tokenBytes[slash][' '], slash ? " / " : "   ", 3);
+    tokenLengths[slash][' '] = 3;
+
+    for (int c = ' ' + 1; c < MORSE_TOKEN_AFTER_SPACE; c++) {
+      size_t length = encodeLengths[c];
+      if (length == 0 || length >= MORSE_TOKEN_MAX_LENGTH) {
+        continue;
+      }
+      // A space between letters, none after a word gap
+      tokenBytes[slash][c][0] = ' ';
+      memcpy(tokenBytes[slash][c] + 1, encodeCodes[c], length);
+      tokenLengths[slash][c] = (unsigned char)(length + 1);
+      memcpy(tokenBytes[slash][c | MORSE_TOKEN_AFTER_SPACE], encodeCodes[c],
+             length);
+      tokenLengths[slash][c | MORSE_TOKEN_AFTER_SPACE] = (unsigned char)length;
+    }
+  }
+}
+
+/* Packed tokens: a code's decode index, which is never below 2 - see
+ * morse_packed.h */
+static void buildPacked(void) {
+  for (int c = 0; c < 256; c++) {
+    packedTokens[c] = encodeLengths[c]
+                          ? (unsigned char)decodeIndex(encodeCodes[c])
+                          : MORSE_PACKED_UNSUPPORTED;
+  }
+  packedTokens[' '] = MORSE_PACKED_GAP;
+  packedTokens['\n'] = packedTokens['\r'] = MORSE_PACKED_SKIP;
+
+  memcpy(packedDecode, decodeTable, sizeof(decodeTable));
+  packedDecode[MORSE_PACKED_GAP] = ' ';
+}
+
+/* Every byte with a code decodes back to itself, upper-cased, and every
+ * decodable code encodes back to itself */
+static bool checkInverse(void) {
+  for (int c = 0; c < 256; c++) {
+    if (encodeLengths[c] > 0 &&
+        decodeTable[decodeIndex(encodeCodes[c])] != toupper(c)) {
+      fprintf(stderr, "morse_tables: 0x%02X does not decode back\n", c);
+      return false;
+    }
+  }
+  for (unsigned int index = 0; index < MORSE_DECODE_TABLE_SIZE; index++) {
+    unsigned char c = (unsigned char)decodeTable[index];
+    if (c != '\0' &&
+        (encodeLengths[c] == 0 || decodeIndex(encodeCodes[c]) != index)) {
+      fprintf(stderr, "morse_tables: code 0x%02X does not encode back\n",
+              index);
+      return false;
+    }
+  }
+  return true;
+}
+
+/* Read and compile the table of a NAME=TABLE argument; the text is kept
+ * for as long as the generator runs */
+static bool compileAlphabet(const char *argument) {
+  const char *equals = strchr(argument, '=');
+  if (!equals || equals == argument) {
+    fprintf(stderr, "morse_gentables: '%s' is not NAME=TABLE\n", argument);
+    return false;
+  }
+  const char *path = equals + 1;
+  FILE *file = fopen(path, "rb");
+  if (!file) {
+    fprintf(stderr, "morse_gentables: could not open '%s'\n", path);
+    return false;
+  }
+  static char texts[MAX_ALPHABETS][MORSE_ALPHABET_MAX_TABLE_SIZE + 1];
+  char *text = texts[alphabetCount];
+  size_t length = fread(text, 1, sizeof(texts[0]), file);
+  bool failed = ferror(file);
+  fclose(file);
+  if (failed) {
+    fprintf(stderr, "morse_gentables: could not read '%s'\n", path);
+    return false;
+  }
+
+  size_t nameLength = (size_t)(equals - argument);
+  char *name = malloc(nameLength + 1);
+  if (!name) {
+    fprintf(stderr, "morse_gentables: out of memory\n");
+    return false;
+  }
+  memcpy(name, argument, nameLength);
+  name[nameLength] = '\0';
+  char error[MORSE_ALPHABET_ERROR_SIZE];
+  if (!morseAlphabetCompile(&alphabets[alphabetCount], name, text, length,
+                            error)) {
+    fprintf(stderr, "%s: %s\n", path, error);
+    free(name);
+    return false;
+  }
+  alphabetLengths[alphabetCount++] = length;
+  return true;
+}
+
+/* MORSE_DECODE_INDEX of a code given as dots and dashes */
+static unsigned int decodeIndex(const char *code) {
+  unsigned int dashes = 0;
+  size_t length = strlen(code);
+  for (size_t i = 0; i < length; i++) {
+    dashes |= (unsigned int)(code[i] == '-') << i;
+  }
+  return MORSE_DECODE_INDEX(dashes, length);
+}
+
+/* MORSE_CHANNEL_DECODE index of a code given as dots and dashes */
+static unsigned int channelIndex(const char *code) {
+  unsigned int index = 1;
+  for (size_t i = 0; code[i] != '\0'; i++) {
+    index = index << 1 | (unsigned int)(code[i] == '-');
+  }
+  return index;
+}
+
+/* A character constant, escaped where C needs it */
+static void writeCharacter(FILE *file, int c) {
+  if (c == '\'' || c == '\\') {
+    fprintf(file, "'\\%c'", c);
+  } else if (isprint(c)) {
+    fprintf(file, "'%c'", c);
+  } else {
+    fprintf(file, "0x%02X", c);
+  }
+}
+
+/* A string literal of dots, dashes, spaces and slashes */
+static void writeString(FILE *file, const char *data, size_t length) {
+  fprintf(file, "\"%.*s\"", (int)length, data);
+}
+
+static bool writeTables(FILE *file) {
+  fprintf(file, "/* Generated by tools/morse_gentables.c from "
+                "include/morse_symbols.h and tables/.\n"
+                " * Do not edit; edit the alphabet instead. */\n\n"
+                "#include <morse_alphabet.h>\n"
+                "#include <morse_tables.h>\n\n");
+
+  fprintf(file, "const MorseCode MORSE_ENCODE_TABLE[256] = {\n");
+  for (int c = 0; c < 256; c++) {
+    if (encodeLengths[c] > 0) {
+      fprintf(file, "    [");
+      writeCharacter(file, c);
+      fprintf(file, "] = {");
+      writeString(file, encodeCodes[c], encodeLengths[c]);
+      fprintf(file, ", %u},\n", encodeLengths[c]);
+    }
+  }
+  fprintf(file, "};\n\n");
+
+  fprintf(file,
+          "const char MORSE_DECODE_TABLE[MORSE_DECODE_TABLE_SIZE] = {\n");
+  for (unsigned int index = 0; index < MORSE_DECODE_TABLE_SIZE; index++) {
+    unsigned char c = (unsigned char)decodeTable[index];
+    if (c != '\0') {
+      fprintf(file, "    [0x%02X] = ", index);
+      writeCharacter(file, c);
+      fprintf(file, ", /* %s */\n", encodeCodes[c]);
+    }
+  }
+  fprintf(file, "};\n\n");
+
+  fprintf(file, "const unsigned char MORSE_CODE_COSTS[256] = {");
+  for (int c = 0; c < 256; c++) {
+    fprintf(file, "%s%u,", c % 16 == 0 ? "\n    " : " ", codeCosts[c]);
+  }
+  fprintf(file, "\n};\n\n");
+
+  fprintf(file,
+          "const char MORSE_TOKEN_BYTES[2][256][MORSE_TOKEN_SIZE] = {\n");
+  for (int slash = 0; slash < 2; slash++) {
+    fprintf(file, "    [%d] = {\n", slash);
+    for (int index = 0; index < 256; index++) {
+      if (tokenLengths[slash][index] > 0) {
+        fprintf(file, "        [0x%02X] = ", index);
+        writeString(file, tokenBytes[slash][index],
+                    tokenLengths[slash][index]);
+        fprintf(file, ",\n");
+      }
+    }
+    fprintf(file, "    },\n");
+  }
+  fprintf(file, "};\n\n");
+
+  fprintf(file, "const unsigned char MORSE_TOKEN_LENGTHS[2][256] = {\n");
+  for (int slash = 0; slash < 2; slash++) {
+    fprintf(file, "    [%d] = {\n", slash);
+    for (int index = 0; index < 256; index++) {
+      if (tokenLengths[slash][index] > 0) {
+        fprintf(file, "        [0x%02X] = %u,\n", index,
+                tokenLengths[slash][index]);
+      }
+    }
+    fprintf(file, "    },\n");
+  }
+  fprintf(file, "};\n\n");
+
+  fprintf(file, "const unsigned char MORSE_PACKED_TOKENS[256] = {");
+  for (int c = 0; c < 256; c++) {
+    fprintf(file, "%s0x%02X,", c % 12 == 0 ? "\n    " : " ", packedTokens[c]);
+  }
+  fprintf(file, "\n};\n\n");
+
+  fprintf(file, "const char MORSE_PACKED_DECODE[256] = {\n");
+  for (int token = 0; token < 256; token++) {
+    if (packedDecode[token] != '\0') {
+      fprintf(file, "    [0x%02X] = ", token);
+      writeCharacter(file, (unsigned char)packedDecode[token]);
+      fprintf(file, ",\n");
+    }
+  }
+  fprintf(file, "};\n\n");
+
+  fprintf(file, "const char MORSE_CHANNEL_DECODE[256] = {\n");
+  for (int index = 0; index < 256; index++) {
+    unsigned char c = (unsigned char)channelDecode[index];
+    if (c != '\0') {
+      fprintf(file, "    [0x%02X] = ", index);
+      writeCharacter(file, c);
+      fprintf(file, ", /* %s */\n", encodeCodes[c]);
+    }
+  }
+  fprintf(file, "};\n\n");
+
+  for (int index = 0; index < alphabetCount; index++) {
+    writeAlphabet(file, index);
+  }
+  fprintf(file, "const MorseAlphabet *const MORSE_BUILTIN_ALPHABETS[] = {");
+  for (int index = 0; index < alphabetCount; index++) {
+    fprintf(file, "&ALPHABET_%d, ", index);
+  }
+  fprintf(file, "NULL};\n");
+  return !ferror(file);
+}
+
+/* A compiled table, its text as a string literal of one table line each
+ * and only the entries that are set */
+static void writeAlphabet(FILE *file, int index) {
+  const MorseAlphabet *alphabet = &alphabets[index];
+  fprintf(file, "static const MorseAlphabet ALPHABET_%d = {\n", index);
+  fprintf(file, "    .name = \"%s\",\n    .strings =", alphabet->name);
+  fprintf(file, "\n        \"");
+  for (size_t i = 0; i < alphabetLengths[index]; i++) {
+    unsigned char c = (unsigned char)alphabet->strings[i];
+    if (c == '\n') {
+      fprintf(file, "\\n\"\n        \"");
+    } else if (c == '"' || c == '\\' || c == '?') {
+      fprintf(file, "\\%c", c);
+    } else if (c >= ' ' && c < 0x7F) {
+      fputc(c, file);
+    } else {
+      fprintf(file, "\\%03o", c);
+    }
+  }
+  fprintf(file, "\",\n    .hasProsigns = %s,\n",
+          alphabet->hasProsigns ? "true" : "false");
+
+  fprintf(file, "    .encode = {\n");
+  for (unsigned int c = 0; c < MORSE_ALPHABET_CODE_POINTS; c++) {
+    if (alphabet->encode[c].length > 0) {
+      fprintf(file, "        [0x%03X] = ", c);
+      writeAlphabetString(file, alphabet->encode[c]);
+      fprintf(file, ",\n");
+    }
+  }
+  fprintf(file, "    },\n    .decode = {\n");
+  for (unsigned int i = 0; i < MORSE_ALPHABET_DECODE_SIZE; i++) {
+    if (alphabet->decode[i].length > 0) {
+      fprintf(file, "        [0x%03X] = ", i);
+      writeAlphabetString(file, alphabet->decode[i]);
+      fprintf(file, ",\n");
+    }
+  }
+  fprintf(file, "    },\n    .prosigns = {\n");
+  for (unsigned int slot = 0; slot < MORSE_ALPHABET_PROSIGN_SLOTS; slot++) {
+    const MorseProsign *prosign = &alphabet->prosigns[slot];
+    if (prosign->name.length > 0) {
+      fprintf(file, "        [%u] = {", slot);
+      writeAlphabetString(file, prosign->name);
+      fprintf(file, ", ");
+      writeAlphabetString(file, prosign->code);
+      fprintf(file, "},\n");
+    }
+  }
+  fprintf(file, "    },\n};\n\n");
+}
+
+/* Offset and length of a table string */
+static void writeAlphabetString(FILE *file, MorseAlphabetString string) {
+  fprintf(file, "{%u, %u}", string.offset, string.length);
+}